@@ -0,0 +1,470 @@
+#ifndef SUDOFUN_BATCH_SOLVER_HEADER
+#define SUDOFUN_BATCH_SOLVER_HEADER
+
+#include "kernels.hpp"
+#include "solver.hpp"
+#include <array>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Propagation over many 9x9 puzzles at once, one puzzle per lane of a vector. The puzzles are held structure
+ * of arrays: one vector per cell, whose lanes are that cell's nine bit value in each of the puzzles, so every
+ * operation on a cell works on all of the puzzles together.
+ *
+ * With GCC or clang the vectors are native vector types, built once for AVX2 and once for the baseline instruction
+ * set and chosen at startup; otherwise they fall back to plain arrays.
+ */
+namespace lanes
+{
+    // The number of puzzles propagated together, which fills a 256 bit register with nine bit values
+    constexpr uint32_t LANES = 16;
+
+#if defined(__GNUC__) || defined(__clang__)
+
+    // Comparisons give all ones in the lanes where they hold and zero in the rest, and scalars are broadcast to
+    // every lane
+    typedef uint16_t Vector __attribute__((vector_size(2 * LANES)));
+
+#define SUDOFUN_LANES_INLINE __attribute__((always_inline)) inline
+
+#else
+
+    // The same operations as the native vector types, a lane at a time
+    struct Vector
+    {
+        std::array<uint16_t, LANES> lane{};
+
+        uint16_t &operator[](uint32_t n)
+        {
+            return lane[n];
+        }
+
+        uint16_t operator[](uint32_t n) const
+        {
+            return lane[n];
+        }
+    };
+
+#define SUDOFUN_LANES_INLINE inline
+
+#define SUDOFUN_LANES_OPERATOR(op)                                        \
+    inline Vector operator op(const Vector &a, const Vector &b)           \
+    {                                                                     \
+        Vector v;                                                         \
+        for (uint32_t n = 0; n < LANES; ++n)                              \
+        {                                                                 \
+            v.lane[n] = static_cast<uint16_t>(a.lane[n] op b.lane[n]);    \
+        }                                                                 \
+        return v;                                                         \
+    }                                                                     \
+    inline Vector operator op(const Vector &a, uint16_t b)                \
+    {                                                                     \
+        Vector v;                                                         \
+        for (uint32_t n = 0; n < LANES; ++n)                              \
+        {                                                                 \
+            v.lane[n] = static_cast<uint16_t>(a.lane[n] op b);            \
+        }                                                                 \
+        return v;                                                         \
+    }                                                                     \
+    inline Vector &operator op##=(Vector &a, const Vector &b)             \
+    {                                                                     \
+        a = a op b;                                                       \
+        return a;                                                         \
+    }
+
+    SUDOFUN_LANES_OPERATOR(&)
+    SUDOFUN_LANES_OPERATOR(|)
+    SUDOFUN_LANES_OPERATOR(^)
+    SUDOFUN_LANES_OPERATOR(+)
+    SUDOFUN_LANES_OPERATOR(-)
+
+#undef SUDOFUN_LANES_OPERATOR
+
+    inline Vector operator~(const Vector &a)
+    {
+        Vector v;
+        for (uint32_t n = 0; n < LANES; ++n)
+        {
+            v.lane[n] = static_cast<uint16_t>(~a.lane[n]);
+        }
+        return v;
+    }
+
+    inline Vector operator==(const Vector &a, uint16_t b)
+    {
+        Vector v;
+        for (uint32_t n = 0; n < LANES; ++n)
+        {
+            v.lane[n] = (a.lane[n] == b) ? 0xFFFF : 0;
+        }
+        return v;
+    }
+
+#endif
+
+    /**
+     * @brief The lanes which are nonzero, as a mask with bit n standing for lane n.
+     *
+     * @param v
+     * @return uint32_t
+     */
+    SUDOFUN_LANES_INLINE uint32_t laneMask(const Vector &v)
+    {
+        uint32_t mask = 0;
+        for (uint32_t n = 0; n < LANES; ++n)
+        {
+            mask |= static_cast<uint32_t>(v[n] != 0) << n;
+        }
+        return mask;
+    }
+
+    using Topo = maps::StandardTopology;
+
+    /**
+     * @brief For every box/line intersection, the cells of its block and the cells of its line outside of it.
+     */
+    struct SectionRest
+    {
+        std::array<uint32_t, 6> blk;
+        std::array<uint32_t, 6> line;
+    };
+
+    constexpr std::array<SectionRest, Topo::INTERSECTION_COUNT> SECTION_REST = []()
+    {
+        std::array<SectionRest, Topo::INTERSECTION_COUNT> rest{};
+        for (uint32_t x = 0; x < Topo::INTERSECTION_COUNT; ++x)
+        {
+            const Topo::Intersection &section = Topo::INTERSECTIONS[x];
+            uint32_t blk_count = 0;
+            for (const uint32_t flat_index : Topo::BLK_TO_FLAT[section.blk])
+            {
+                uint32_t line = (section.line < 9) ? Topo::flatToRow(flat_index) : 9 + Topo::flatToCol(flat_index);
+                if (line != section.line)
+                {
+                    rest[x].blk[blk_count++] = flat_index;
+                }
+            }
+            uint32_t line_count = 0;
+            for (const uint32_t flat_index : Topo::UNIT_TO_FLAT[section.line])
+            {
+                if (Topo::flatToBlk(flat_index) != section.blk)
+                {
+                    rest[x].line[line_count++] = flat_index;
+                }
+            }
+        }
+        return rest;
+    }();
+
+    /**
+     * @brief How each lane came out of a pass, as masks with bit n standing for lane n.
+     */
+    struct LaneStatus
+    {
+        // Something was ruled out, so another pass may rule out more
+        uint32_t changed;
+
+        // Some element still has more than one option
+        uint32_t unsolved;
+
+        // The puzzle contradicts itself: an element has no options, a unit repeats a solved digit, or a digit has
+        // nowhere left to go in a unit
+        uint32_t broken;
+    };
+
+    /**
+     * @brief One pass of the singles over every lane, followed by the box/line reductions when asked for. These
+     * are the same eliminations as the solver's strike, unique, squeeze, and pipe techniques.
+     *
+     * @param cells The 81 cell vectors
+     * @param box_line Whether to run the box/line reductions
+     * @param status
+     */
+    SUDOFUN_LANES_INLINE void reduceBody(Vector *cells, bool box_line, LaneStatus *status)
+    {
+        const Vector one = Vector{} + 1;
+        const Vector all_bits = Vector{} + Topo::ALL_BITS;
+
+        std::array<Vector, Topo::CELLS> before;
+        for (uint32_t c = 0; c < Topo::CELLS; ++c)
+        {
+            before[c] = cells[c];
+        }
+        Vector broken{};
+
+        // Naked singles: a unit's solved digits leave the rest of its members
+        for (uint32_t u = 0; u < Topo::UNITS; ++u)
+        {
+            const std::array<uint32_t, 9> &flat = Topo::UNIT_TO_FLAT[u];
+            std::array<Vector, 9> single;
+            Vector solved{};
+            Vector repeated{};
+            for (uint32_t k = 0; k < 9; ++k)
+            {
+                Vector val = cells[flat[k]];
+                single[k] = val & (Vector)((val & (val - one)) == 0);
+                repeated |= solved & single[k];
+                solved |= single[k];
+            }
+            // A digit solved twice over leaves both of its elements empty
+            for (uint32_t k = 0; k < 9; ++k)
+            {
+                cells[flat[k]] &= ~((solved ^ single[k]) | repeated);
+            }
+        }
+
+        // Hidden singles: a digit with one place left in a unit takes it
+        for (uint32_t u = 0; u < Topo::UNITS; ++u)
+        {
+            const std::array<uint32_t, 9> &flat = Topo::UNIT_TO_FLAT[u];
+            Vector once{};
+            Vector twice{};
+            for (uint32_t k = 0; k < 9; ++k)
+            {
+                Vector val = cells[flat[k]];
+                twice |= once & val;
+                once |= val;
+            }
+            broken |= all_bits & ~once;
+
+            Vector unique = once & ~twice;
+            for (uint32_t k = 0; k < 9; ++k)
+            {
+                Vector val = cells[flat[k]];
+                Vector hit = val & unique;
+                cells[flat[k]] = hit | (val & (Vector)(hit == 0));
+            }
+        }
+
+        if (box_line)
+        {
+            // The digits each intersection may take
+            std::array<Vector, Topo::INTERSECTION_COUNT> section;
+            for (uint32_t x = 0; x < Topo::INTERSECTION_COUNT; ++x)
+            {
+                const std::array<uint32_t, 3> &x_cells = Topo::INTERSECTIONS[x].cells;
+                section[x] = cells[x_cells[0]] | cells[x_cells[1]] | cells[x_cells[2]];
+            }
+
+            // A digit confined to one section of a row/col can't go anywhere else in that section's block
+            for (uint32_t line = 0; line < 18; ++line)
+            {
+                const Vector *s = &section[3 * line];
+                Vector several = (s[0] & s[1]) | (s[0] & s[2]) | (s[1] & s[2]);
+                for (uint32_t n = 0; n < 3; ++n)
+                {
+                    Vector confined = s[n] & ~several;
+                    for (const uint32_t flat_index : SECTION_REST[3 * line + n].blk)
+                    {
+                        cells[flat_index] &= ~confined;
+                    }
+                }
+            }
+
+            // A digit confined to one row/col of a block can't go anywhere else in that row/col
+            for (uint32_t g = 0; g < 9; ++g)
+            {
+                const std::array<uint32_t, 6> &xs = Topo::BLK_INTERSECTIONS[g];
+                for (uint32_t first = 0; first < 6; first += 3)
+                {
+                    const Vector &a = section[xs[first]];
+                    const Vector &b = section[xs[first + 1]];
+                    const Vector &c = section[xs[first + 2]];
+                    Vector several = (a & b) | (a & c) | (b & c);
+                    for (uint32_t n = first; n < first + 3; ++n)
+                    {
+                        Vector confined = section[xs[n]] & ~several;
+                        for (const uint32_t flat_index : SECTION_REST[xs[n]].line)
+                        {
+                            cells[flat_index] &= ~confined;
+                        }
+                    }
+                }
+            }
+        }
+
+        Vector changed{};
+        Vector unsolved{};
+        for (uint32_t c = 0; c < Topo::CELLS; ++c)
+        {
+            Vector val = cells[c];
+            changed |= val ^ before[c];
+            unsolved |= val & (val - one);
+            broken |= (Vector)(val == 0);
+        }
+
+        status->changed = laneMask(changed);
+        status->unsolved = laneMask(unsolved);
+        status->broken = laneMask(broken);
+    }
+
+    /**
+     * @brief The pass in use, along with the name of the instruction set it was built for.
+     */
+    struct LaneKernelSet
+    {
+        const char *name;
+        void (*reduce)(Vector *cells, bool box_line, LaneStatus *status);
+    };
+
+    inline void reduceBaseline(Vector *cells, bool box_line, LaneStatus *status)
+    {
+        reduceBody(cells, box_line, status);
+    }
+
+#if defined(SUDOFUN_X86_KERNELS)
+
+    __attribute__((target("avx2"))) inline void reduceAvx2(Vector *cells, bool box_line, LaneStatus *status)
+    {
+        reduceBody(cells, box_line, status);
+    }
+
+#endif
+
+    inline LaneKernelSet detectLaneKernels()
+    {
+#if defined(SUDOFUN_X86_KERNELS)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+        {
+            return {"AVX2", reduceAvx2};
+        }
+#endif
+        return {"baseline", reduceBaseline};
+    }
+
+    /**
+     * @brief The pass for this machine, detected on first use.
+     *
+     * @return const LaneKernelSet&
+     */
+    inline const LaneKernelSet &active()
+    {
+        static const LaneKernelSet kernel_set = detectLaneKernels();
+        return kernel_set;
+    }
+
+} // lanes
+
+/**
+ * @brief Solves many 9x9 puzzles at a time. Up to LANES puzzles are propagated in lockstep, and whenever a lane's
+ * puzzle is solved, found to be broken, or stalls, the lane is retired and refilled with the next puzzle. Stalled
+ * puzzles are handed to the scalar solver, which picks up from the propagated state and searches.
+ *
+ * The lanes only run techniques the pipeline has, and run them until nothing more is ruled out. The scalar reduce
+ * loop stops as soon as a pass solves nothing, which is never further along, so a stalled puzzle starts its search
+ * from at least as far as the scalar solver alone would have got it.
+ */
+class BatchSolver
+{
+public:
+    static constexpr uint32_t LANES = lanes::LANES;
+
+private:
+    alignas(32) std::array<lanes::Vector, Puzzle::CELLS> cells;
+
+    // The puzzle each lane holds
+    std::array<size_t, LANES> lane_puzzle;
+
+    Solver::Pipeline pipeline;
+    SolverStats *stats;
+
+    void loadLane(uint32_t lane, Puzzle *puzzle)
+    {
+        for (uint32_t c = 0; c < Puzzle::CELLS; ++c)
+        {
+            this->cells[c][lane] = puzzle->getValue(c);
+        }
+    }
+
+    void storeLane(uint32_t lane, Puzzle *puzzle)
+    {
+        std::array<uint16_t, Puzzle::CELLS> values;
+        for (uint32_t c = 0; c < Puzzle::CELLS; ++c)
+        {
+            values[c] = this->cells[c][lane];
+        }
+        *puzzle = Puzzle();
+        puzzle->addCandidateValues(values.data());
+    }
+
+public:
+    BatchSolver(Solver::Pipeline pipeline = Solver::Pipeline::STANDARD)
+        : pipeline(pipeline), stats(nullptr) {}
+
+    /**
+     * @brief Attaches counters for the scalar solves of stalled puzzles to fill in.
+     *
+     * @param stats
+     */
+    void setStats(SolverStats *stats)
+    {
+        this->stats = stats;
+    }
+
+    /**
+     * @brief Solves a run of puzzles, each already holding its clues. Each is left solved, or as far along as the
+     * lanes and then the search could get it.
+     *
+     * @param puzzles
+     * @param count
+     * @param max_guesses The maximum number of guesses the search may make for each puzzle
+     * @param guesses Where to write the number of guesses each puzzle took, or nullptr
+     */
+    void solve(Puzzle *puzzles, size_t count, uint32_t max_guesses = Solver::UNLIMITED_GUESSES,
+               uint32_t *guesses = nullptr)
+    {
+        const lanes::LaneKernelSet &kernel_set = lanes::active();
+        bool box_line = (this->pipeline != Solver::Pipeline::THROUGHPUT);
+
+        size_t next = 0;
+        uint32_t active = 0;
+        while (true)
+        {
+            // Fill the idle lanes
+            for (uint32_t lane = 0; (lane < LANES) && (next < count); ++lane)
+            {
+                if ((active & (1 << lane)) == 0)
+                {
+                    this->loadLane(lane, &puzzles[next]);
+                    this->lane_puzzle[lane] = next++;
+                    active |= 1 << lane;
+                }
+            }
+            if (active == 0)
+            {
+                break;
+            }
+
+            lanes::LaneStatus status;
+            kernel_set.reduce(this->cells.data(), box_line, &status);
+
+            // Retire the lanes which are solved, broken, or stalled
+            uint32_t done = active & (status.broken | ~status.unsolved | ~status.changed);
+            for (uint32_t lanes_done = done; lanes_done != 0; lanes_done &= lanes_done - 1)
+            {
+                uint32_t lane = utils::lowestBitIndex(lanes_done);
+                size_t i = this->lane_puzzle[lane];
+                this->storeLane(lane, &puzzles[i]);
+
+                // A stalled puzzle is left to the search
+                uint32_t puzzle_guesses = 0;
+                if (((status.broken | ~status.unsolved) & (1 << lane)) == 0)
+                {
+                    Solver solver(&puzzles[i]);
+                    solver.setStats(this->stats);
+                    solver.solve(max_guesses, this->pipeline);
+                    puzzle_guesses = solver.numGuesses();
+                }
+                if (guesses != nullptr)
+                {
+                    guesses[i] = puzzle_guesses;
+                }
+            }
+            active &= ~done;
+        }
+    }
+};
+
+#endif
@@ -1,74 +1,673 @@
-
+#include "batch.hpp"
+#include "cache.hpp"
+#include "dataset.hpp"
+#include "histogram.hpp"
+#include "perf.hpp"
 #include "solver.hpp"
+#include "store.hpp"
+#include "workers.hpp"
+#include <algorithm>
 #include <chrono>
-#include <fstream>
+#include <cstdio>
 #include <exception>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+
+// Number of puzzles handed to a worker at a time
+constexpr size_t BENCHMARK_CHUNK_SIZE = 64;
+
+// Latencies are broken down by how many guesses the puzzle took: none, then one class per decade
+constexpr uint32_t GUESS_CLASS_COUNT = 5;
+const std::array<const char *, GUESS_CLASS_COUNT> GUESS_CLASS_NAMES = {"0", "1-9", "10-99", "100-999", "1000+"};
+
+uint32_t guessClass(uint32_t guesses)
+{
+    uint32_t guess_class = 0;
+    for (uint32_t bound = 1; (guesses >= bound) && (guess_class + 1 < GUESS_CLASS_COUNT); bound *= 10)
+    {
+        ++guess_class;
+    }
+    return guess_class;
+}
+
+struct BenchmarkCounters
+{
+    std::chrono::nanoseconds elapsed_time_ns{0};
+    uint64_t solve_count{0};
+    uint64_t fail_count{0};
+
+    LatencyHistogram solved_latency;
+    LatencyHistogram failed_latency;
+    std::array<LatencyHistogram, GUESS_CLASS_COUNT> guess_class_latency;
+
+    SolverStats solver_stats;
+
+    // Hardware counter totals, when they are being read, and whether any of them were scaled up from multiplexing
+    PerfCounters::Sample perf_totals{};
+    bool perf_multiplexed{false};
+
+    void merge(const BenchmarkCounters &other)
+    {
+        elapsed_time_ns += other.elapsed_time_ns;
+        solve_count += other.solve_count;
+        fail_count += other.fail_count;
+        solved_latency.merge(other.solved_latency);
+        failed_latency.merge(other.failed_latency);
+        for (uint32_t n = 0; n < GUESS_CLASS_COUNT; ++n)
+        {
+            guess_class_latency[n].merge(other.guess_class_latency[n]);
+        }
+        solver_stats.merge(other.solver_stats);
+        for (uint32_t e = 0; e < PerfCounters::EVENT_COUNT; ++e)
+        {
+            perf_totals[e] += other.perf_totals[e];
+        }
+        perf_multiplexed = perf_multiplexed || other.perf_multiplexed;
+    }
+};
+
+// How to run the benchmark, as given on the command line
+struct BenchmarkOptions
+{
+    uint32_t max_guesses{0};
+    uint32_t warmup_loops{0};
+    uint32_t loops{0};
+    uint32_t threads{1};
+    uint32_t side{9};
+    Solver::Pipeline pipeline{Solver::Pipeline::STANDARD};
+    bool lockstep{false};
+
+    // The slowest puzzles to list after the test loop, and where to write them (if anywhere)
+    size_t slowest_count{10};
+    std::string slowest_path;
+
+    // Whether to read hardware counters, and where to write each puzzle's (if anywhere)
+    bool read_perf{false};
+    std::string perf_path;
+
+    // The result cache's capacity (0 for none) and the solution store's path (empty for none). With a store, 9x9
+    // puzzles are always keyed by canonical form.
+    size_t cache_capacity{0};
+    bool canonical_keys{false};
+    std::string store_path;
+};
+
+// What was measured for each puzzle of the dataset. Every puzzle is solved by one worker per loop, so workers
+// never write the same element at once.
+struct PuzzleRecords
+{
+    // The slowest time seen for each puzzle
+    std::vector<uint64_t> latency_ns;
+
+    // The hardware counters of each puzzle's most recent solve, if they are being read
+    std::vector<PerfCounters::Sample> perf;
+};
 
-void runBenchmark(const std::string &filename, uint32_t maxGuesses, uint32_t loops, bool warmup)
+/**
+ * @brief Solves a range of the dataset, recording every solve into the counters. With a result cache, each puzzle
+ * is looked up first and only solved (and then cached) on a miss, and the time taken covers all of that, including
+ * finding the canonical form when the cache is keyed by canonical forms. A solution store is looked up after the
+ * cache and added to after solving in the same way. A puzzle that can't be read, or whose clues conflict, isn't
+ * solved at all, and counts as failed.
+ *
+ * @param dataset
+ * @param begin
+ * @param end
+ * @param maxGuesses
+ * @param pipeline
+ * @param perf Hardware counters to read around each solve, or nullptr
+ * @param cache The result cache shared by every worker, or nullptr
+ * @param store The solution store shared by every worker, or nullptr
+ * @param canonicalizer The worker's own canonicalizer, to key the cache and store by canonical forms, or nullptr
+ * @param counters
+ * @param records
+ */
+template <uint32_t BoxSize>
+void solveClues(const Dataset &dataset, size_t begin, size_t end, uint32_t maxGuesses, Solver::Pipeline pipeline,
+                const PerfCounters *perf, ResultCache<BoxSize> *cache, SolutionStore<BoxSize> *store,
+                Canonicalizer *canonicalizer, BenchmarkCounters *counters, PuzzleRecords *records)
 {
     using clock = std::chrono::steady_clock;
-    using duration = std::chrono::nanoseconds;
+    using Cache = ResultCache<BoxSize>;
 
-    if (warmup)
+    std::array<uint8_t, BasicPuzzle<BoxSize>::CELLS> values;
+    std::array<uint8_t, BasicPuzzle<BoxSize>::CELLS> solution;
+    std::array<uint8_t, BasicPuzzle<BoxSize>::CELLS> canonical_solution;
+    for (size_t i = begin; i < end; ++i)
     {
-        std::cout << "Running warmup" << std::endl;
+        BasicPuzzle<BoxSize> puzzle;
+        bool loaded = dataset.readValues<BoxSize>(i, values.data()) && puzzle.addClueValues(values.data());
+        bool keyed = loaded && ((cache != nullptr) || (store != nullptr));
+        BasicSolver<BoxSize> solver(&puzzle);
+        solver.setStats(&counters->solver_stats);
+
+        // The counters are read outside the timed region so that the reads don't show up in the latencies
+        PerfCounters::Mark perf_start{};
+        if (perf != nullptr)
+        {
+            perf->start(&perf_start);
+        }
+
+        auto start = clock::now();
+        typename Cache::Key key{};
+        Canonicalizer::Transform transform{};
+        bool hit = false;
+        bool solved = false;
+        if (keyed)
+        {
+            key = (canonicalizer != nullptr) ? Cache::makeCanonicalKey(values.data(), canonicalizer, &transform)
+                                             : Cache::makeKey(values.data());
+            hit = (cache != nullptr) && cache->find(key, nullptr, &solved);
+            if (!hit && (store != nullptr))
+            {
+                // The solution found goes into the cache just as the store holds it
+                packed::Result stored{};
+                hit = store->find(key, canonical_solution.data(), &stored);
+                solved = stored.solved;
+                if (hit && (cache != nullptr))
+                {
+                    cache->insert(key, canonical_solution.data(), solved);
+                }
+            }
+        }
+        if (!hit && loaded)
+        {
+            solver.solve(maxGuesses, pipeline);
+            solved = puzzle.validSolution();
+            if (keyed)
+            {
+                auto solved_at = clock::now();
+                puzzle.writeValues(solution.data());
+                const uint8_t *kept_solution = solution.data();
+                if constexpr (BoxSize == 3)
+                {
+                    // The cache and the store hold solutions on the canonical side
+                    if (canonicalizer != nullptr)
+                    {
+                        transform.apply(solution.data(), canonical_solution.data());
+                        kept_solution = canonical_solution.data();
+                    }
+                }
+                if (cache != nullptr)
+                {
+                    cache->insert(key, kept_solution, solved);
+                }
+                if (store != nullptr)
+                {
+                    std::chrono::nanoseconds solve_time =
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(solved_at - start);
+                    store->insert(key, kept_solution,
+                                  packed::Result{solved, solver.numGuesses(), static_cast<uint64_t>(solve_time.count())});
+                }
+            }
+        }
+        auto end = clock::now();
+
+        if (perf != nullptr)
+        {
+            PerfCounters::Sample &perf_delta = records->perf[i];
+            perf->stop(perf_start, &perf_delta);
+            for (uint32_t e = 0; e < PerfCounters::EVENT_COUNT; ++e)
+            {
+                counters->perf_totals[e] += perf_delta[e];
+            }
+        }
+
+        std::chrono::nanoseconds elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+        uint64_t elapsed_ns = static_cast<uint64_t>(elapsed.count());
+        counters->elapsed_time_ns += elapsed;
+
+        if (solved)
+        {
+            ++counters->solve_count;
+            counters->solved_latency.record(elapsed_ns);
+        }
+        else
+        {
+            ++counters->fail_count;
+            counters->failed_latency.record(elapsed_ns);
+        }
+        counters->guess_class_latency[guessClass(solver.numGuesses())].record(elapsed_ns);
+
+        records->latency_ns[i] = std::max(records->latency_ns[i], elapsed_ns);
     }
-    else
+}
+
+/**
+ * @brief Solves a range of the dataset through the batch solver, recording every solve into the counters. The
+ * puzzles of the range share their lanes, so each is charged an equal share of the range's time (and hardware
+ * counters) rather than a latency of its own.
+ *
+ * @param dataset
+ * @param begin
+ * @param end
+ * @param maxGuesses
+ * @param pipeline
+ * @param perf Hardware counters to read around the range, or nullptr
+ * @param counters
+ * @param records
+ */
+void solveCluesLockstep(const Dataset &dataset, size_t begin, size_t end, uint32_t maxGuesses,
+                        Solver::Pipeline pipeline, const PerfCounters *perf, BenchmarkCounters *counters,
+                        PuzzleRecords *records)
+{
+    using clock = std::chrono::steady_clock;
+
+    // Puzzles that can't be loaded are left out of the lanes, and count as failed
+    size_t count = end - begin;
+    std::vector<Puzzle> puzzles;
+    std::vector<size_t> loaded_indices;
+    puzzles.reserve(count);
+    loaded_indices.reserve(count);
+    for (size_t i = begin; i < end; ++i)
     {
-        std::cout << "Running test loop" << std::endl;
+        puzzles.emplace_back();
+        if (dataset.loadPuzzle<3>(i, &puzzles.back()))
+        {
+            loaded_indices.push_back(i);
+        }
+        else
+        {
+            puzzles.pop_back();
+        }
     }
+    std::vector<uint32_t> guesses(puzzles.size(), 0);
+    BatchSolver batch_solver(pipeline);
+    batch_solver.setStats(&counters->solver_stats);
 
-    std::ifstream cluefile(filename);
-    if (!cluefile.is_open())
+    PerfCounters::Mark perf_start{};
+    if (perf != nullptr)
     {
-        std::cout << "Could not open clue file" << std::endl;
-        return;
+        perf->start(&perf_start);
     }
 
-    std::string clue_string;
-    duration elapsed_time_ns = duration(duration::zero());
-    uint64_t solve_count{0};
-    uint64_t fail_count{0};
-    for (uint32_t loop_idx = 0; loop_idx < loops; ++loop_idx)
+    auto start = clock::now();
+    if (!puzzles.empty())
     {
-        cluefile.clear();
-        cluefile.seekg(0, std::ios::beg);
+        batch_solver.solve(puzzles.data(), puzzles.size(), maxGuesses, guesses.data());
+    }
+    auto stop = clock::now();
 
-        while (std::getline(cluefile, clue_string))
+    if (perf != nullptr)
+    {
+        PerfCounters::Sample perf_delta{};
+        perf->stop(perf_start, &perf_delta);
+        for (uint32_t e = 0; e < PerfCounters::EVENT_COUNT; ++e)
         {
-            if (!(clue_string.length() == 81)){
-                throw std::runtime_error("String is not proper length!!!");
+            counters->perf_totals[e] += perf_delta[e];
+            for (size_t i = begin; i < end; ++i)
+            {
+                records->perf[i][e] = perf_delta[e] / count;
             }
+        }
+    }
+
+    std::chrono::nanoseconds elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start);
+    uint64_t share_ns = static_cast<uint64_t>(elapsed.count()) / count;
+    counters->elapsed_time_ns += elapsed;
+
+    size_t next = 0;
+    for (size_t i = begin; i < end; ++i)
+    {
+        bool solved = false;
+        uint32_t puzzle_guesses = 0;
+        if ((next < loaded_indices.size()) && (loaded_indices[next] == i))
+        {
+            solved = puzzles[next].validSolution();
+            puzzle_guesses = guesses[next];
+            ++next;
+        }
+
+        if (solved)
+        {
+            ++counters->solve_count;
+            counters->solved_latency.record(share_ns);
+        }
+        else
+        {
+            ++counters->fail_count;
+            counters->failed_latency.record(share_ns);
+        }
+        counters->guess_class_latency[guessClass(puzzle_guesses)].record(share_ns);
+
+        records->latency_ns[i] = std::max(records->latency_ns[i], share_ns);
+    }
+}
+
+void printLatencyRow(const char *label, const LatencyHistogram &histogram)
+{
+    if (histogram.count() == 0)
+    {
+        return;
+    }
+
+    std::cout << std::left << std::setw(16) << label << std::right << std::setw(10) << histogram.count();
+    for (const double percentile : {50.0, 90.0, 99.0, 99.9})
+    {
+        std::cout << std::setw(12) << histogram.valueAtPercentile(percentile) / 1000.0;
+    }
+    std::cout << std::setw(12) << histogram.max() / 1000.0 << "\n";
+}
 
-            Puzzle puzzle = Puzzle();
-            puzzle.addBenchmarkString(clue_string);
-            Solver solver = Solver(&puzzle);
+void printLatencyReport(const BenchmarkCounters &totals)
+{
+    LatencyHistogram all_latency = totals.solved_latency;
+    all_latency.merge(totals.failed_latency);
 
-            auto start = clock::now();
-            solver.solve(maxGuesses);
-            auto end = clock::now();
+    std::cout << std::fixed << std::setprecision(1)
+              << "\nLatency (us)" << std::setw(14) << "count" << std::setw(12) << "p50" << std::setw(12) << "p90"
+              << std::setw(12) << "p99" << std::setw(12) << "p99.9" << std::setw(12) << "max" << "\n";
+    printLatencyRow("all", all_latency);
+    printLatencyRow("solved", totals.solved_latency);
+    printLatencyRow("failed", totals.failed_latency);
+    for (uint32_t n = 0; n < GUESS_CLASS_COUNT; ++n)
+    {
+        std::string label = std::string("guesses ") + GUESS_CLASS_NAMES[n];
+        printLatencyRow(label.c_str(), totals.guess_class_latency[n]);
+    }
+    std::cout << std::defaultfloat;
+}
 
-            elapsed_time_ns += std::chrono::duration_cast<duration>(end - start);
+/**
+ * @brief Prints what each solver technique did over the run, when the solver was built with SUDOFUN_SOLVER_STATS.
+ *
+ * @param stats
+ */
+void printTechniqueReport(const SolverStats &stats)
+{
+    if (!SolverStats::ENABLED)
+    {
+        return;
+    }
 
-            if (puzzle.numUnsolved() == 0)
+    std::cout << std::fixed << std::setprecision(1)
+              << "\nTechnique" << std::setw(17) << "calls" << std::setw(16) << "eliminated" << std::setw(12)
+              << "solved" << std::setw(12) << "ms" << std::setw(14) << "ns/call" << "\n";
+    for (uint32_t n = 0; n < SolverStats::TECHNIQUE_COUNT; ++n)
+    {
+        const TechniqueStats &technique = stats.techniques[n];
+        double ns_per_call = (technique.calls != 0) ? (double)technique.elapsed_ns / (double)technique.calls : 0.0;
+        std::cout << std::left << std::setw(16) << SolverStats::TECHNIQUE_NAMES[n] << std::right
+                  << std::setw(10) << technique.calls << std::setw(16) << technique.candidates_eliminated
+                  << std::setw(12) << technique.cells_solved << std::setw(12) << technique.elapsed_ns / 1e6
+                  << std::setw(14) << ns_per_call << "\n";
+    }
+    std::cout << "(guess covers whole searches, including the techniques run inside them)\n" << std::defaultfloat;
+}
+
+/**
+ * @brief Prints what the solution store did. Like the cache's, its counters cover the warmup and test loops.
+ *
+ * @param stats
+ * @param size The number of records in the store
+ */
+void printStoreReport(const StoreStats &stats, uint64_t size)
+{
+    uint64_t lookups = stats.hits + stats.misses;
+    double hit_rate = (lookups != 0) ? 100.0 * (double)stats.hits / (double)lookups : 0.0;
+    std::cout << std::fixed << std::setprecision(1) << "\nSolution store over all loops: " << stats.hits << " hits, "
+              << stats.misses << " misses, " << stats.inserts << " added, " << size << " in all (" << hit_rate
+              << "% hits)\n" << std::defaultfloat;
+}
+
+/**
+ * @brief Prints what the result cache did. The cache lives across the warmup and test loops, so its counters cover
+ * both.
+ *
+ * @param stats
+ */
+void printCacheReport(const CacheStats &stats)
+{
+    uint64_t lookups = stats.hits + stats.misses;
+    double hit_rate = (lookups != 0) ? 100.0 * (double)stats.hits / (double)lookups : 0.0;
+    std::cout << std::fixed << std::setprecision(1) << "\nResult cache over all loops: " << stats.hits << " hits, "
+              << stats.misses << " misses, " << stats.evictions << " evictions (" << hit_rate << "% hits)\n"
+              << std::defaultfloat;
+}
+
+/**
+ * @brief Prints the hardware counters over the run, in total and per puzzle, and optionally writes each puzzle's
+ * counters to a CSV file.
+ *
+ * @param probe Counters opened the same way as the workers', to tell which events were counted
+ * @param totals
+ * @param records
+ * @param output_path Where to write the per-puzzle counters, or empty to skip them
+ */
+void reportPerf(const PerfCounters &probe, const BenchmarkCounters &totals, const PuzzleRecords &records,
+                const std::string &output_path)
+{
+    double num_puzzles = (double)(totals.solve_count + totals.fail_count);
+
+    std::cout << "\nHardware counters from " << probe.source() << "\n"
+              << std::left << std::setw(16) << "event" << std::right << std::setw(20) << "total" << std::setw(16)
+              << "per puzzle" << "\n"
+              << std::fixed << std::setprecision(1);
+    for (uint32_t e = 0; e < PerfCounters::EVENT_COUNT; ++e)
+    {
+        if (probe.counting(static_cast<PerfCounters::Event>(e)))
+        {
+            std::cout << std::left << std::setw(16) << PerfCounters::EVENT_NAMES[e] << std::right << std::setw(20)
+                      << totals.perf_totals[e] << std::setw(16) << totals.perf_totals[e] / num_puzzles << "\n";
+        }
+    }
+    if (probe.counting(PerfCounters::INSTRUCTIONS) && (totals.perf_totals[PerfCounters::CYCLES] != 0))
+    {
+        std::cout << std::setprecision(3) << "instructions per cycle: "
+                  << (double)totals.perf_totals[PerfCounters::INSTRUCTIONS] /
+                         (double)totals.perf_totals[PerfCounters::CYCLES]
+                  << "\n";
+    }
+    if (totals.perf_multiplexed)
+    {
+        std::cout << "(the events didn't all fit on the PMU at once, so some counts are estimates scaled up by the"
+                  << " time enabled over the time counted)\n";
+    }
+    std::cout << std::defaultfloat;
+
+    if (!output_path.empty())
+    {
+        std::ofstream output(output_path);
+        if (!output.is_open())
+        {
+            throw std::runtime_error("Could not open perf counter file");
+        }
+
+        output << "line";
+        for (uint32_t e = 0; e < PerfCounters::EVENT_COUNT; ++e)
+        {
+            if (probe.counting(static_cast<PerfCounters::Event>(e)))
             {
-                ++solve_count;
+                output << "," << PerfCounters::EVENT_NAMES[e];
             }
-            else
+        }
+        output << "\n";
+
+        for (size_t i = 0; i < records.perf.size(); ++i)
+        {
+            output << i + 1;
+            for (uint32_t e = 0; e < PerfCounters::EVENT_COUNT; ++e)
             {
-                ++fail_count;
+                if (probe.counting(static_cast<PerfCounters::Event>(e)))
+                {
+                    output << "," << records.perf[i][e];
+                }
             }
+            output << "\n";
+        }
+    }
+}
+
+/**
+ * @brief Lists the slowest puzzles of the dataset by line number, and optionally writes them out as a dataset
+ * of their own. Puzzles from a packed dataset are written as text.
+ *
+ * @tparam BoxSize
+ * @param dataset
+ * @param puzzle_latency_ns The slowest time seen for each puzzle
+ * @param count How many puzzles to list
+ * @param output_path Where to write the puzzles, or empty to only list them
+ */
+template <uint32_t BoxSize>
+void reportSlowest(const Dataset &dataset, const std::vector<uint64_t> &puzzle_latency_ns, size_t count,
+                   const std::string &output_path)
+{
+    count = std::min(count, dataset.size());
+    if (count == 0)
+    {
+        return;
+    }
+
+    std::vector<size_t> order(dataset.size());
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        order[i] = i;
+    }
+    std::partial_sort(order.begin(), order.begin() + count, order.end(), [&](size_t a, size_t b)
+                      { return puzzle_latency_ns[a] > puzzle_latency_ns[b]; });
+
+    std::cout << "\nSlowest " << count << " puzzles (line: us)\n" << std::fixed << std::setprecision(1);
+    for (size_t n = 0; n < count; ++n)
+    {
+        std::cout << order[n] + 1 << ": " << puzzle_latency_ns[order[n]] / 1000.0 << "\n";
+    }
+    std::cout << std::defaultfloat;
+
+    if (!output_path.empty())
+    {
+        std::FILE *output = std::fopen(output_path.c_str(), "wb");
+        if (output == nullptr)
+        {
+            throw std::runtime_error("Could not open slowest puzzle file");
+        }
+        std::string lines;
+        for (size_t n = 0; n < count; ++n)
+        {
+            dataset.appendText<BoxSize>(order[n], &lines);
+            lines.push_back('\n');
         }
+        std::fwrite(lines.data(), 1, lines.size(), output);
+        std::fclose(output);
+    }
+}
+
+/**
+ * @brief Runs either the warmup loops or the test loops over the dataset, reporting on the test loops only.
+ *
+ * @tparam BoxSize
+ * @param dataset
+ * @param options
+ * @param warmup Whether to run the warmup loops rather than the test loops
+ * @param cache The result cache shared by every loop, or nullptr
+ * @param store The solution store shared by every loop, or nullptr
+ */
+template <uint32_t BoxSize>
+void runBenchmark(const Dataset &dataset, const BenchmarkOptions &options, bool warmup,
+                  ResultCache<BoxSize> *cache = nullptr, SolutionStore<BoxSize> *store = nullptr)
+{
+    using clock = std::chrono::steady_clock;
+
+    uint32_t loops = warmup ? options.warmup_loops : options.loops;
+    uint32_t threads = options.threads;
+    if (warmup)
+    {
+        std::cout << "Running warmup" << std::endl;
+    }
+    else
+    {
+        std::cout << "Running test loop" << std::endl;
     }
 
+    BenchmarkCounters totals;
+    PuzzleRecords records;
+    records.latency_ns.assign(dataset.size(), 0);
+    if (options.read_perf)
+    {
+        records.perf.assign(dataset.size(), PerfCounters::Sample{});
+    }
+    auto wall_start = clock::now();
+    for (uint32_t loop_idx = 0; loop_idx < loops; ++loop_idx)
+    {
+        // Each worker solves with its own puzzles and counters, and the counters are merged at the end
+        WorkStealingRanges ranges(dataset.size(), threads, BENCHMARK_CHUNK_SIZE);
+        std::vector<BenchmarkCounters> worker_counters(threads);
+        runWorkers(threads, [&](uint32_t worker)
+                   {
+                       BenchmarkCounters &counters = worker_counters[worker];
+
+                       // Counters only count the thread that opened them, so every worker opens its own
+                       std::unique_ptr<PerfCounters> perf;
+                       if (options.read_perf)
+                       {
+                           perf.reset(new PerfCounters());
+                       }
+
+                       std::unique_ptr<Canonicalizer> canonicalizer;
+                       if (options.canonical_keys)
+                       {
+                           canonicalizer.reset(new Canonicalizer());
+                       }
+
+                       size_t begin, end;
+                       while (ranges.next(worker, &begin, &end))
+                       {
+                           if constexpr (BoxSize == 3)
+                           {
+                               if (options.lockstep)
+                               {
+                                   solveCluesLockstep(dataset, begin, end, options.max_guesses, options.pipeline,
+                                                      perf.get(), &counters, &records);
+                                   continue;
+                               }
+                           }
+                           solveClues<BoxSize>(dataset, begin, end, options.max_guesses, options.pipeline, perf.get(),
+                                               cache, store, canonicalizer.get(), &counters, &records);
+                       }
+                       counters.perf_multiplexed = perf && perf->multiplexed(); });
+
+        for (const BenchmarkCounters &counters : worker_counters)
+        {
+            totals.merge(counters);
+        }
+    }
+    auto wall_end = clock::now();
+
     if (!warmup)
     {
-        long long total_time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed_time_ns).count();
-        double puzzles_per_ms = (double)(solve_count + fail_count) / ((double)total_time_ms);
-        std::cout << "Solved " << solve_count << " puzzles and failed to solve " << fail_count << " puzzles"
+        // Times are kept fractional, since a small dataset can take well under a millisecond
+        double total_time_ms = std::chrono::duration<double, std::milli>(totals.elapsed_time_ns).count();
+        double wall_time_ms = std::chrono::duration<double, std::milli>(wall_end - wall_start).count();
+        double puzzles_per_ms = (double)(totals.solve_count + totals.fail_count) / total_time_ms;
+        std::cout << "Solved " << totals.solve_count << " puzzles and failed to solve " << totals.fail_count << " puzzles"
                   << "\nTook " << total_time_ms << " ms to solve"
-                  << "\n" << puzzles_per_ms << " puzzles per millisecond"
-                  << std::endl;
+                  << "\n" << puzzles_per_ms << " puzzles per millisecond";
+        if (threads > 1)
+        {
+            double wall_puzzles_per_ms = (double)(totals.solve_count + totals.fail_count) / wall_time_ms;
+            std::cout << " per thread"
+                      << "\nTook " << wall_time_ms << " ms of wall time on " << threads << " threads"
+                      << "\n" << wall_puzzles_per_ms << " puzzles per millisecond in aggregate";
+        }
+        std::cout << "\n";
+
+        printLatencyReport(totals);
+        printTechniqueReport(totals.solver_stats);
+        if (cache != nullptr)
+        {
+            printCacheReport(cache->stats());
+        }
+        if (store != nullptr)
+        {
+            printStoreReport(store->stats(), store->size());
+        }
+        if (options.read_perf)
+        {
+            PerfCounters probe;
+            reportPerf(probe, totals, records, options.perf_path);
+        }
+        reportSlowest<BoxSize>(dataset, records.latency_ns, options.slowest_count, options.slowest_path);
+        std::cout << std::flush;
     }
 }
 
@@ -77,25 +676,176 @@ int main(int argc, char *argv[])
 
     if (argc < 5)
     {
-        std::cout << "Usage: " << argv[0] << " <filename> <max guesses> <warmup loops> <loops>" << std::endl;
+        std::cout << "Usage: " << argv[0] << " <filename> <max guesses> <warmup loops> <loops> [--threads N] [--slowest N]"
+                  << " [--slowest-out path] [--perf] [--perf-out path]"
+                  << " [--pipeline name] [--size N] [--lockstep] [--cache N] [--cache-canonical] [--store path]"
+                  << "\n  <filename> is text, one puzzle per line, or a packed puzzle file from sudofun_convert"
+                  << "\n  --threads N         Solve on N worker threads (0 for one per hardware thread)"
+                  << "\n  --slowest N         List the N slowest puzzles by line number (default 10)"
+                  << "\n  --slowest-out path  Also write the slowest puzzles to a file"
+                  << "\n  --perf              Read hardware performance counters around every solve"
+                  << "\n  --perf-out path     Also write each puzzle's counters to a CSV file (implies --perf)"
+                  << "\n  --pipeline name     The technique pipeline to solve with: standard (default), throughput, or deep"
+                  << "\n  --size N            The side of the puzzles: 4, 9 (default), 16, or 25"
+                  << "\n  --lockstep          Solve 9x9 puzzles many at a time with the batch solver; latencies become"
+                  << "\n                      each puzzle's share of its chunk"
+                  << "\n  --cache N           Look puzzles up in a result cache of N entries, shared by every thread and"
+                  << "\n                      loop, before solving them"
+                  << "\n  --cache-canonical   Key the cache by canonical form, so that every symmetry of a 9x9 puzzle"
+                  << "\n                      hits the same entry"
+                  << "\n  --store path        Look puzzles up in a solution store on disk after the cache, and add the"
+                  << "\n                      puzzles solved to it; 9x9 puzzles are keyed by canonical form"
+                  << std::endl;
         return 1;
     }
 
     std::string filename = argv[1];
-    uint32_t max_guesses = static_cast<uint32_t>(std::stol(argv[2]));
-    uint32_t warmup_loops = static_cast<uint32_t>(std::stol(argv[3]));
-    uint32_t loops = static_cast<uint32_t>(std::stol(argv[4]));
+    BenchmarkOptions options;
+    options.max_guesses = static_cast<uint32_t>(std::stol(argv[2]));
+    options.warmup_loops = static_cast<uint32_t>(std::stol(argv[3]));
+    options.loops = static_cast<uint32_t>(std::stol(argv[4]));
+
+    for (int i = 5; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "--threads" && i + 1 < argc)
+        {
+            options.threads = static_cast<uint32_t>(std::stol(argv[++i]));
+        }
+        else if (arg == "--slowest" && i + 1 < argc)
+        {
+            options.slowest_count = static_cast<size_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--slowest-out" && i + 1 < argc)
+        {
+            options.slowest_path = argv[++i];
+        }
+        else if (arg == "--pipeline" && i + 1 < argc)
+        {
+            try
+            {
+                options.pipeline = Solver::parsePipeline(argv[++i]);
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << e.what() << "\n";
+                return 1;
+            }
+        }
+        else if (arg == "--size" && i + 1 < argc)
+        {
+            options.side = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--lockstep")
+        {
+            options.lockstep = true;
+        }
+        else if (arg == "--cache" && i + 1 < argc)
+        {
+            options.cache_capacity = static_cast<size_t>(std::stoull(argv[++i]));
+        }
+        else if (arg == "--cache-canonical")
+        {
+            options.canonical_keys = true;
+        }
+        else if (arg == "--store" && i + 1 < argc)
+        {
+            options.store_path = argv[++i];
+        }
+        else if (arg == "--perf")
+        {
+            options.read_perf = true;
+        }
+        else if (arg == "--perf-out" && i + 1 < argc)
+        {
+            options.read_perf = true;
+            options.perf_path = argv[++i];
+        }
+        else
+        {
+            std::cerr << "Unknown or incomplete argument: " << arg << "\n";
+            return 1;
+        }
+    }
+
+    if (options.lockstep && (options.side != 9))
+    {
+        std::cerr << "--lockstep only applies to 9x9 puzzles\n";
+        return 1;
+    }
+
+    if (options.lockstep && ((options.cache_capacity > 0) || !options.store_path.empty()))
+    {
+        std::cerr << "--cache and --store do not apply to --lockstep\n";
+        return 1;
+    }
+
+    if (options.canonical_keys && ((options.cache_capacity == 0) || (options.side != 9)))
+    {
+        std::cerr << "--cache-canonical needs --cache, and only applies to 9x9 puzzles\n";
+        return 1;
+    }
+
+    // The store keys 9x9 puzzles by canonical form, and the cache in front of it must agree
+    if (!options.store_path.empty() && (options.side == 9))
+    {
+        options.canonical_keys = true;
+    }
+
+    if (options.threads == 0)
+    {
+        options.threads = std::max(1u, std::thread::hardware_concurrency());
+    }
 
     std::cout << "Testing using file: " << filename
-              << "\nmaxGuesses: " << max_guesses
-              << "\nwarmupLoops: " << warmup_loops
-              << "\ntestLoops: " << loops
-              << std::endl;
+              << "\nmaxGuesses: " << options.max_guesses
+              << "\nwarmupLoops: " << options.warmup_loops
+              << "\ntestLoops: " << options.loops
+              << "\nthreads: " << options.threads
+              << "\nsize: " << options.side << "x" << options.side
+              << "\npipeline: " << Solver::PIPELINE_NAMES[static_cast<uint32_t>(options.pipeline)]
+              << "\nkernels: " << kernels::active().name;
+    if (options.lockstep)
+    {
+        std::cout << "\nlockstep: " << BatchSolver::LANES << " lanes, " << lanes::active().name;
+    }
+    if (options.cache_capacity > 0)
+    {
+        std::cout << "\ncache: " << options.cache_capacity << " entries"
+                  << (options.canonical_keys ? ", canonical keys" : "");
+    }
+    if (!options.store_path.empty())
+    {
+        std::cout << "\nstore: " << options.store_path;
+    }
+    std::cout << std::endl;
 
     try
     {
-        runBenchmark(filename, max_guesses, warmup_loops, true);
-        runBenchmark(filename, max_guesses, loops, false);
+        Dataset dataset(filename);
+        withBoxSizeOf(options.side, [&](auto box)
+                      {
+                          constexpr uint32_t box_size = decltype(box)::value;
+                          dataset.requirePuzzles<box_size>();
+                          std::unique_ptr<ResultCache<box_size>> cache;
+                          if (options.cache_capacity > 0)
+                          {
+                              cache.reset(new ResultCache<box_size>(options.cache_capacity));
+                          }
+                          std::unique_ptr<SolutionStore<box_size>> store;
+                          if (!options.store_path.empty())
+                          {
+                              store.reset(new SolutionStore<box_size>(options.store_path, options.max_guesses,
+                                                                      options.pipeline));
+                              if (!store->isWritable())
+                              {
+                                  std::cout << "Solution store is open for writing elsewhere, so it is only read from"
+                                            << std::endl;
+                              }
+                          }
+                          runBenchmark<box_size>(dataset, options, true, cache.get(), store.get());
+                          runBenchmark<box_size>(dataset, options, false, cache.get(), store.get()); });
     }
     catch (const std::exception &e)
     {
@@ -109,4 +859,4 @@ int main(int argc, char *argv[])
     }
 
     return 0;
-}
\ No newline at end of file
+}
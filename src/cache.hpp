@@ -0,0 +1,310 @@
+#ifndef SUDOFUN_CACHE_HEADER
+#define SUDOFUN_CACHE_HEADER
+
+#include "canonical.hpp"
+#include "packed.hpp"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Counters of what a result cache has done.
+ */
+struct CacheStats
+{
+    uint64_t hits{0};
+    uint64_t misses{0};
+    uint64_t evictions{0};
+
+    void merge(const CacheStats &other)
+    {
+        hits += other.hits;
+        misses += other.misses;
+        evictions += other.evictions;
+    }
+};
+
+/**
+ * @brief A bounded cache of solver results, keyed by the clues of the puzzle, for feeds in which the same puzzles
+ * come round again. Each entry holds either the solution or the verdict that the puzzle could not be solved, so a
+ * cache belongs to one solver configuration (pipeline and guess limit) and to one notion of solved.
+ *
+ * The entries are split over shards by the hash of their key, and each shard has its own lock, its own share of the
+ * capacity, and its own least recently used order, so threads looking up different puzzles rarely wait on each
+ * other. A full shard evicts its least recently used entry. Keys hold the packed clues in full, so distinct puzzles
+ * never share an entry however their hashes collide.
+ *
+ * @tparam BoxSize
+ */
+template <uint32_t BoxSize>
+class ResultCache
+{
+public:
+    using Layout = packed::Layout<BoxSize>;
+
+    static constexpr uint32_t DEFAULT_SHARD_COUNT = 16;
+
+    struct Key
+    {
+        std::array<uint8_t, Layout::PUZZLE_RECORD_SIZE> clues;
+        uint64_t hash;
+
+        bool operator==(const Key &other) const
+        {
+            return std::memcmp(this->clues.data(), other.clues.data(), Layout::PUZZLE_RECORD_SIZE) == 0;
+        }
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key &key) const
+        {
+            return static_cast<size_t>(key.hash);
+        }
+    };
+
+private:
+    static constexpr uint32_t NO_SLOT = UINT32_MAX;
+    static constexpr uint64_t HASH_MULTIPLIER = 0x9e3779b97f4a7c15ull;
+
+    // An entry, linked into its shard's recency order from most to least recently used
+    struct Slot
+    {
+        Key key;
+        std::array<uint8_t, Layout::PUZZLE_RECORD_SIZE> solution;
+        bool solved;
+        uint32_t newer;
+        uint32_t older;
+    };
+
+    struct alignas(64) Shard
+    {
+        std::mutex mutex;
+        std::unordered_map<Key, uint32_t, KeyHash> index;
+        std::vector<Slot> slots;
+        uint32_t newest{NO_SLOT};
+        uint32_t oldest{NO_SLOT};
+        CacheStats stats;
+    };
+
+    std::unique_ptr<Shard[]> shards;
+    uint32_t shard_count;
+    size_t shard_capacity;
+
+    static void unlink(Shard *shard, uint32_t slot_index)
+    {
+        Slot &slot = shard->slots[slot_index];
+        (slot.newer != NO_SLOT ? shard->slots[slot.newer].older : shard->newest) = slot.older;
+        (slot.older != NO_SLOT ? shard->slots[slot.older].newer : shard->oldest) = slot.newer;
+    }
+
+    static void pushNewest(Shard *shard, uint32_t slot_index)
+    {
+        Slot &slot = shard->slots[slot_index];
+        slot.newer = NO_SLOT;
+        slot.older = shard->newest;
+        (shard->newest != NO_SLOT ? shard->slots[shard->newest].newer : shard->oldest) = slot_index;
+        shard->newest = slot_index;
+    }
+
+    Shard &shardOf(const Key &key) const
+    {
+        // The index buckets by the low bits of the hash, so the shard is picked by the high bits
+        return this->shards[(key.hash >> 32) % this->shard_count];
+    }
+
+public:
+    /**
+     * @brief Creates an empty cache.
+     *
+     * @param capacity The most entries to hold, spread evenly over the shards
+     * @param shard_count
+     */
+    explicit ResultCache(size_t capacity, uint32_t shard_count = DEFAULT_SHARD_COUNT)
+        : shard_count(static_cast<uint32_t>(std::max<size_t>(1, std::min<size_t>(shard_count, capacity))))
+    {
+        this->shards.reset(new Shard[this->shard_count]);
+        this->shard_capacity = std::max<size_t>(1, (capacity + this->shard_count - 1) / this->shard_count);
+        for (uint32_t s = 0; s < this->shard_count; ++s)
+        {
+            this->shards[s].index.reserve(this->shard_capacity);
+        }
+    }
+
+    ResultCache(const ResultCache &) = delete;
+    ResultCache &operator=(const ResultCache &) = delete;
+
+    /**
+     * @brief Makes the key of a puzzle from its clues, packing them and hashing them a word at a time.
+     *
+     * @param clue_values The CELLS values of the clues, 0 for a blank
+     * @return Key
+     */
+    static Key makeKey(const uint8_t *clue_values)
+    {
+        Key key;
+        Layout::packValues(clue_values, key.clues.data());
+
+        uint64_t hash = Layout::PUZZLE_RECORD_SIZE * HASH_MULTIPLIER;
+        size_t pos = 0;
+        for (; pos + 8 <= Layout::PUZZLE_RECORD_SIZE; pos += 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, key.clues.data() + pos, 8);
+            hash = (hash ^ word) * HASH_MULTIPLIER;
+            hash ^= hash >> 29;
+        }
+        uint64_t tail = 0;
+        std::memcpy(&tail, key.clues.data() + pos, Layout::PUZZLE_RECORD_SIZE - pos);
+        hash = (hash ^ tail) * HASH_MULTIPLIER;
+        key.hash = hash ^ (hash >> 32);
+        return key;
+    }
+
+    /**
+     * @brief Makes the key of a 9x9 puzzle from its canonical form, so that every symmetry of the puzzle shares one
+     * entry. The solution cached under such a key has to be on the canonical side: map a solution through the
+     * transform before inserting it, and back through its inverse after finding it.
+     *
+     * @param clue_values The CELLS values of the clues, 0 for a blank
+     * @param canonicalizer Scratch space, one per thread
+     * @param transform Set to the symmetry taking the puzzle to its canonical form
+     * @return Key
+     */
+    static Key makeCanonicalKey(const uint8_t *clue_values, Canonicalizer *canonicalizer,
+                                Canonicalizer::Transform *transform)
+    {
+        if constexpr (BoxSize != 3)
+        {
+            throw std::runtime_error("Only 9x9 puzzles have canonical forms");
+        }
+        else
+        {
+            std::array<uint8_t, Layout::CELLS> canonical;
+            canonicalizer->canonicalize(clue_values, canonical.data(), transform);
+            return makeKey(canonical.data());
+        }
+    }
+
+    /**
+     * @brief Looks a puzzle up, making it the most recently used entry of its shard if it is there.
+     *
+     * @param key
+     * @param solution Where to write the CELLS values of the solution, if it was solved; may be nullptr
+     * @param solved Set to whether the puzzle was solved
+     * @return true on a hit
+     */
+    bool find(const Key &key, uint8_t *solution, bool *solved)
+    {
+        Shard &shard = this->shardOf(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        auto found = shard.index.find(key);
+        if (found == shard.index.end())
+        {
+            ++shard.stats.misses;
+            return false;
+        }
+        ++shard.stats.hits;
+
+        uint32_t slot_index = found->second;
+        if (slot_index != shard.newest)
+        {
+            unlink(&shard, slot_index);
+            pushNewest(&shard, slot_index);
+        }
+
+        const Slot &slot = shard.slots[slot_index];
+        *solved = slot.solved;
+        if (slot.solved && (solution != nullptr))
+        {
+            Layout::unpackValues(slot.solution.data(), solution);
+        }
+        return true;
+    }
+
+    /**
+     * @brief Records the result of a puzzle, evicting the least recently used entry of its shard if the shard is
+     * full. A puzzle already in the cache just has its entry refreshed.
+     *
+     * @param key
+     * @param solution The CELLS values of the solution; only read if solved, and may be nullptr otherwise
+     * @param solved
+     */
+    void insert(const Key &key, const uint8_t *solution, bool solved)
+    {
+        Shard &shard = this->shardOf(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        uint32_t slot_index;
+        auto found = shard.index.find(key);
+        if (found != shard.index.end())
+        {
+            slot_index = found->second;
+            unlink(&shard, slot_index);
+        }
+        else if (shard.slots.size() < this->shard_capacity)
+        {
+            slot_index = static_cast<uint32_t>(shard.slots.size());
+            shard.slots.emplace_back();
+            shard.index.emplace(key, slot_index);
+        }
+        else
+        {
+            slot_index = shard.oldest;
+            unlink(&shard, slot_index);
+            shard.index.erase(shard.slots[slot_index].key);
+            shard.index.emplace(key, slot_index);
+            ++shard.stats.evictions;
+        }
+
+        Slot &slot = shard.slots[slot_index];
+        slot.key = key;
+        slot.solved = solved;
+        if (solved)
+        {
+            Layout::packValues(solution, slot.solution.data());
+        }
+        pushNewest(&shard, slot_index);
+    }
+
+    /**
+     * @brief Adds up the counters of every shard.
+     *
+     * @return CacheStats
+     */
+    CacheStats stats() const
+    {
+        CacheStats total;
+        for (uint32_t s = 0; s < this->shard_count; ++s)
+        {
+            std::lock_guard<std::mutex> lock(this->shards[s].mutex);
+            total.merge(this->shards[s].stats);
+        }
+        return total;
+    }
+
+    /**
+     * @brief The number of entries held.
+     *
+     * @return size_t
+     */
+    size_t size() const
+    {
+        size_t total = 0;
+        for (uint32_t s = 0; s < this->shard_count; ++s)
+        {
+            std::lock_guard<std::mutex> lock(this->shards[s].mutex);
+            total += this->shards[s].slots.size();
+        }
+        return total;
+    }
+};
+
+#endif
@@ -0,0 +1,1005 @@
+#ifndef SUDOFUN_CANONICAL_HEADER
+#define SUDOFUN_CANONICAL_HEADER
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * @brief Maps 9x9 puzzles to a canonical form under the symmetries of the grid: relabeling the digits, permuting the
+ * rows within a band and the bands themselves, likewise the columns within a stack and the stacks, and transposing.
+ * Two puzzles have the same canonical form exactly when one is a symmetry of the other, so the form can be used to
+ * find repeats in a dataset, or as a cache key shared by every puzzle of an orbit.
+ *
+ * The canonical form is settled in two steps. The clue pattern comes first: the image whose blocks, read band by
+ * band and each as a 9 bit mask of where its clues are, come out smallest. That is found one band at a time from
+ * precomputed tables of every block mask under every row and every column permutation. Each source band and ordering
+ * of its rows is tried in turn (for the first band, only the orderings that bring one of its blocks to the smallest
+ * block of the puzzle), and the stacks sort themselves by their smallest masks, so the stacks and the column
+ * orderings still tied are carried along as sets instead of being enumerated. The digits come second: of the few
+ * symmetries that give the smallest pattern, the one whose clues, read row by row and relabeled 1, 2, ... in order of
+ * first appearance, come out smallest.
+ *
+ * A pattern with more than MAX_PATTERN_SYMMETRIES symmetries of its own (a nearly blank puzzle, say) instead takes
+ * the smallest image of the whole puzzle read row by row, with 0 for a blank, from a row by row search. How many
+ * symmetries a pattern has is the same for every puzzle of an orbit, so every puzzle of an orbit takes the same way.
+ *
+ * The result is only guaranteed to be canonical for puzzles whose clues don't conflict, but for any puzzle it is the
+ * puzzle's image under the transform returned, so equal forms always mean equivalent puzzles.
+ */
+class Canonicalizer
+{
+public:
+    static constexpr uint32_t SIDE = 9;
+    static constexpr uint32_t CELLS = 81;
+
+    // Patterns with more symmetries of their own than this go to the row by row search rather than having the
+    // digits of every symmetry compared
+    static constexpr uint32_t MAX_PATTERN_SYMMETRIES = 64;
+
+    /**
+     * @brief A symmetry of the grid, taking a puzzle to its canonical form: element (r, c) of the canonical form is
+     * element (rows[r], cols[c]) of the source (transposed first, if set) with its digit relabeled through digits.
+     */
+    struct Transform
+    {
+        bool transposed;
+        std::array<uint8_t, SIDE> rows;
+        std::array<uint8_t, SIDE> cols;
+
+        // The canonical digit of each source digit, with 0 (a blank) mapped to itself
+        std::array<uint8_t, SIDE + 1> digits;
+
+        uint32_t sourceIndex(uint32_t row_index, uint32_t col_index) const
+        {
+            return this->transposed ? SIDE * this->cols[col_index] + this->rows[row_index]
+                                    : SIDE * this->rows[row_index] + this->cols[col_index];
+        }
+
+        /**
+         * @brief Maps a grid (a puzzle or a solution) forwards, from the source to the canonical side.
+         *
+         * @param values The CELLS values of the source
+         * @param out The CELLS values of the image
+         */
+        void apply(const uint8_t *values, uint8_t *out) const
+        {
+            // Local copies, since the writes to out could otherwise alias the transform and force it to be reread
+            const std::array<uint8_t, SIDE + 1> digits = this->digits;
+            uint32_t row_step = this->transposed ? 1 : SIDE;
+            uint32_t col_step = this->transposed ? SIDE : 1;
+            std::array<uint8_t, SIDE> col_offsets;
+            for (uint32_t c = 0; c < SIDE; ++c)
+            {
+                col_offsets[c] = static_cast<uint8_t>(col_step * this->cols[c]);
+            }
+            for (uint32_t r = 0; r < SIDE; ++r)
+            {
+                const uint8_t *row = values + row_step * this->rows[r];
+                for (uint32_t c = 0; c < SIDE; ++c)
+                {
+                    out[SIDE * r + c] = digits[row[col_offsets[c]]];
+                }
+            }
+        }
+
+        /**
+         * @brief Maps a grid backwards, from the canonical side to the source, e.g. to take the solution of the
+         * canonical form to the solution of the source puzzle.
+         *
+         * @param values The CELLS values on the canonical side
+         * @param out The CELLS values of the source
+         */
+        void invert(const uint8_t *values, uint8_t *out) const
+        {
+            std::array<uint8_t, SIDE + 1> source_digits;
+            for (uint32_t d = 0; d <= SIDE; ++d)
+            {
+                source_digits[this->digits[d]] = static_cast<uint8_t>(d);
+            }
+            for (uint32_t r = 0; r < SIDE; ++r)
+            {
+                for (uint32_t c = 0; c < SIDE; ++c)
+                {
+                    out[this->sourceIndex(r, c)] = source_digits[values[SIDE * r + c]];
+                }
+            }
+        }
+    };
+
+private:
+    static constexpr uint32_t BOX_MASKS = 1 << SIDE;
+    static constexpr uint8_t ALL_PERMS = 63;
+
+    // For finding the elements of a row that hold clues eight at a time
+    static constexpr uint64_t BYTE_LOW_BITS = 0x7f7f7f7f7f7f7f7full;
+    static constexpr uint64_t BYTE_ONES = 0x0101010101010101ull;
+    static constexpr uint64_t GATHER_REVERSED = 0x8040201008040201ull;
+
+    // The orderings of three rows (or columns): place n of ordering p takes source place PERMS[p][n]
+    static constexpr std::array<std::array<uint8_t, 3>, 6> PERMS = {
+        {{0, 1, 2}, {0, 2, 1}, {1, 0, 2}, {1, 2, 0}, {2, 0, 1}, {2, 1, 0}}};
+
+    // An arrangement of the source whose blocks so far come out equal to the smallest pattern found. The rows of the
+    // bands laid out are fixed. The stacks are in output order, but the stacks within one group may still go in any
+    // order, and each stack may still take any of a set of column orderings.
+    struct Arrangement
+    {
+        bool transposed;
+        uint8_t used_bands;
+
+        // Bit s is set if output stack s starts a group of stacks
+        uint8_t group_starts;
+
+        std::array<uint8_t, 3> bands;
+        std::array<uint8_t, 3> row_perms;
+        std::array<uint8_t, 3> stacks;
+
+        // The column orderings each stack may still take, bit p for PERMS[p]
+        std::array<uint8_t, 3> col_perms;
+    };
+
+    // Block masks have bit 8 - (3 * row + col) set for each clue, so a mask read as a number grows with its first
+    // clue's place. These map a mask to its image under each row ordering, each column ordering, and transposition;
+    // a set of column orderings (bit p for PERMS[p]) and a mask to the smallest image those orderings give, shifted
+    // up by 6 over the orderings that give it; and a mask to its smallest image under any row and column ordering,
+    // shifted up by 6 over the row orderings that can give it. The set table is 64 KB, so it is kept off the stack.
+    std::array<std::array<uint16_t, BOX_MASKS>, 6> row_images;
+    std::array<std::array<uint16_t, BOX_MASKS>, 6> col_images;
+    std::array<uint16_t, BOX_MASKS> transposed_images;
+    std::vector<std::array<uint16_t, BOX_MASKS>> least_images;
+    std::array<uint16_t, BOX_MASKS> least_block_images;
+
+    // The mask of each block of the puzzle, by orientation, band, and stack
+    std::array<std::array<std::array<uint16_t, 3>, 3>, 2> box_masks;
+
+    std::vector<Arrangement> arrangements;
+    std::vector<Arrangement> next_arrangements;
+
+    // The smallest blocks found for each band, three masks to a band, and the blocks every arrangement tried gives
+    // for the current band
+    std::array<uint32_t, 3> pattern_keys;
+    std::vector<uint32_t> band_keys;
+
+    // The output elements holding clues, in order, and the digits the best symmetry so far gives them
+    std::array<uint8_t, CELLS> clue_cells;
+    uint32_t num_clues;
+    std::array<uint8_t, CELLS> best_digits;
+
+    // An arrangement of the source whose rows so far come out equal to the smallest found
+    struct State
+    {
+        bool transposed;
+        uint8_t next_label;
+        uint16_t used_rows;
+
+        std::array<uint8_t, SIDE> rows;
+
+        // The source columns in output order. Columns within one cell may still be put in any order, as may the
+        // stacks within one group.
+        std::array<uint8_t, SIDE> cols;
+
+        // Bit p is set if output column p starts a cell; the three stacks always start cells
+        uint16_t cell_starts;
+
+        // Bit s is set if output stack s starts a group of stacks
+        uint8_t group_starts;
+
+        std::array<uint8_t, SIDE + 1> labels;
+    };
+
+    // A state being extended by one more row. How its row so far compares with the best row is kept up to date as
+    // it grows, for as long as the best row stays the same.
+    struct Partial
+    {
+        State state;
+        std::array<uint8_t, SIDE> out;
+        uint32_t best_version;
+        bool less;
+    };
+
+    std::array<std::array<uint8_t, CELLS>, 2> grids;
+
+    // For each set of columns holding clues (bit c for column c), the clues of the smallest first row such a row can
+    // give, read from bit 8 down to bit 0 for output columns 0 to 8: its stacks in order of fewest clues, and the
+    // blanks first within each
+    std::array<uint16_t, 1 << SIDE> first_row_clues;
+    std::vector<State> states;
+    std::vector<State> next_states;
+
+    // The smallest row found so far at the current level, counting each change, and the source row being tried
+    std::array<uint8_t, SIDE> best;
+    bool best_valid;
+    uint32_t best_version;
+    const uint8_t *row_values;
+
+    /**
+     * @brief Writes one output element of the row being tried, assigning the next label to a digit not seen before.
+     *
+     * @param p
+     * @param pos
+     * @return false if the row so far already comes out larger than the best row
+     */
+    bool emit(Partial *p, uint32_t pos)
+    {
+        uint8_t digit = this->row_values[p->state.cols[pos]];
+        uint8_t value = 0;
+        if (digit != 0)
+        {
+            if (p->state.labels[digit] == 0)
+            {
+                p->state.labels[digit] = p->state.next_label++;
+            }
+            value = p->state.labels[digit];
+        }
+        p->out[pos] = value;
+
+        if (!this->best_valid)
+        {
+            return true;
+        }
+        if (p->best_version != this->best_version)
+        {
+            // The best row has changed since this row was compared with it
+            int order = std::memcmp(p->out.data(), this->best.data(), pos);
+            p->best_version = this->best_version;
+            p->less = (order < 0);
+            if (order > 0)
+            {
+                return false;
+            }
+        }
+        if (!p->less)
+        {
+            if (value > this->best[pos])
+            {
+                return false;
+            }
+            p->less = (value < this->best[pos]);
+        }
+        return true;
+    }
+
+    bool blankColumn(const Partial &p, uint32_t pos) const
+    {
+        return this->row_values[p.state.cols[pos]] == 0;
+    }
+
+    bool blankStack(const Partial &p, uint32_t slot) const
+    {
+        return this->blankColumn(p, 3 * slot) && this->blankColumn(p, 3 * slot + 1) &&
+               this->blankColumn(p, 3 * slot + 2);
+    }
+
+    void swapStacks(Partial *p, uint32_t a, uint32_t b)
+    {
+        for (uint32_t n = 0; n < 3; ++n)
+        {
+            std::swap(p->state.cols[3 * a + n], p->state.cols[3 * b + n]);
+        }
+    }
+
+    void finish(const Partial &p)
+    {
+        if (!this->best_valid || p.less)
+        {
+            this->best = p.out;
+            this->best_valid = true;
+            ++this->best_version;
+            this->next_states.clear();
+        }
+        this->next_states.push_back(p.state);
+    }
+
+    /**
+     * @brief Lays out the rest of the row being tried from an output column on, trying every ordering of the
+     * columns and stacks still tied that could give the smallest row. Blank columns (and blank stacks) are all alike
+     * as far as this row goes, so they go first and stay tied, and only the others are tried in turn.
+     *
+     * @param p
+     * @param pos The output column to lay out next, at the start of a cell
+     */
+    void layOut(Partial p, uint32_t pos)
+    {
+        while (pos < SIDE)
+        {
+            uint32_t slot = pos / 3;
+            if (pos % 3 == 0)
+            {
+                uint32_t group_end = slot + 1;
+                while ((group_end < 3) && ((p.state.group_starts & (1 << group_end)) == 0))
+                {
+                    ++group_end;
+                }
+
+                if (group_end - slot > 1)
+                {
+                    // Blank stacks go first, in their current order, and stay tied to each other
+                    uint32_t blank_end = slot;
+                    for (uint32_t s = slot; s < group_end; ++s)
+                    {
+                        if (this->blankStack(p, s))
+                        {
+                            this->swapStacks(&p, s, blank_end++);
+                        }
+                    }
+                    if (blank_end > slot)
+                    {
+                        if (blank_end < 3)
+                        {
+                            p.state.group_starts |= static_cast<uint8_t>(1 << blank_end);
+                        }
+                        for (; pos < 3 * blank_end; ++pos)
+                        {
+                            if (!this->emit(&p, pos))
+                            {
+                                return;
+                            }
+                        }
+                        continue;
+                    }
+
+                    // Every stack of the group has a clue in this row: each takes the first place in turn
+                    p.state.group_starts |= static_cast<uint8_t>(1 << (slot + 1));
+                    for (uint32_t s = slot; s < group_end; ++s)
+                    {
+                        Partial q = p;
+                        this->swapStacks(&q, slot, s);
+                        this->layOut(q, pos);
+                    }
+                    return;
+                }
+            }
+
+            uint32_t cell_end = pos + 1;
+            while ((cell_end % 3 != 0) && ((p.state.cell_starts & (1 << cell_end)) == 0))
+            {
+                ++cell_end;
+            }
+
+            if (cell_end - pos > 1)
+            {
+                // Blank columns go first, in their current order, and stay tied to each other
+                uint32_t blank_end = pos;
+                for (uint32_t n = pos; n < cell_end; ++n)
+                {
+                    if (this->blankColumn(p, n))
+                    {
+                        std::swap(p.state.cols[n], p.state.cols[blank_end++]);
+                    }
+                }
+                if (blank_end > pos)
+                {
+                    p.state.cell_starts |= static_cast<uint16_t>(1 << blank_end);
+                    for (; pos < blank_end; ++pos)
+                    {
+                        if (!this->emit(&p, pos))
+                        {
+                            return;
+                        }
+                    }
+                    continue;
+                }
+
+                // Every column of the cell has a clue in this row: each takes the first place in turn
+                p.state.cell_starts |= static_cast<uint16_t>(1 << (pos + 1));
+                for (uint32_t n = pos; n < cell_end; ++n)
+                {
+                    Partial q = p;
+                    std::swap(q.state.cols[pos], q.state.cols[n]);
+                    if (this->emit(&q, pos))
+                    {
+                        this->layOut(q, pos + 1);
+                    }
+                }
+                return;
+            }
+
+            if (!this->emit(&p, pos))
+            {
+                return;
+            }
+            ++pos;
+        }
+
+        this->finish(p);
+    }
+
+    /**
+     * @brief Finds the smallest image of a puzzle read row by row, and the symmetry that takes the puzzle to it.
+     *
+     * @param values
+     * @param canonical
+     * @param transform
+     */
+    void searchRows(const uint8_t *values, uint8_t *canonical, Transform *transform)
+    {
+        for (uint32_t r = 0; r < SIDE; ++r)
+        {
+            for (uint32_t c = 0; c < SIDE; ++c)
+            {
+                this->grids[0][SIDE * r + c] = values[SIDE * r + c];
+                this->grids[1][SIDE * r + c] = values[SIDE * c + r];
+            }
+        }
+
+        // The first row takes fresh labels, so how small it can come out depends only on where its clues are: only
+        // the source rows whose clues give the smallest first row are tried
+        std::array<uint16_t, 2 * SIDE> row_clues;
+        uint16_t least_clues = UINT16_MAX;
+        for (uint32_t row = 0; row < 2 * SIDE; ++row)
+        {
+            const uint8_t *row_values = &this->grids[row / SIDE][SIDE * (row % SIDE)];
+            uint32_t mask = 0;
+            for (uint32_t c = 0; c < SIDE; ++c)
+            {
+                mask |= static_cast<uint32_t>(row_values[c] != 0) << c;
+            }
+            row_clues[row] = this->first_row_clues[mask];
+            least_clues = std::min(least_clues, row_clues[row]);
+        }
+
+        this->states.clear();
+        for (const bool transposed : {false, true})
+        {
+            State start{};
+            start.transposed = transposed;
+            start.next_label = 1;
+            for (uint32_t c = 0; c < SIDE; ++c)
+            {
+                start.cols[c] = static_cast<uint8_t>(c);
+            }
+            start.cell_starts = (1 << 0) | (1 << 3) | (1 << 6);
+            start.group_starts = 1 << 0;
+            this->states.push_back(start);
+        }
+
+        for (uint32_t level = 0; level < SIDE; ++level)
+        {
+            this->best_valid = false;
+            ++this->best_version;
+            this->next_states.clear();
+
+            for (const State &state : this->states)
+            {
+                // A new band may start from any row of a band not used yet; otherwise the row stays in its band
+                uint32_t band_begin = 0;
+                uint32_t band_end = SIDE;
+                if (level % 3 != 0)
+                {
+                    band_begin = 3 * (state.rows[level - 1] / 3);
+                    band_end = band_begin + 3;
+                }
+
+                for (uint32_t source_row = band_begin; source_row < band_end; ++source_row)
+                {
+                    uint32_t band_rows = 7u << (3 * (source_row / 3));
+                    if (((state.used_rows & (1 << source_row)) != 0) ||
+                        ((level % 3 == 0) && ((state.used_rows & band_rows) != 0)) ||
+                        ((level == 0) && (row_clues[SIDE * state.transposed + source_row] != least_clues)))
+                    {
+                        continue;
+                    }
+
+                    Partial p;
+                    p.state = state;
+                    p.best_version = this->best_version;
+                    p.less = false;
+                    p.state.rows[level] = static_cast<uint8_t>(source_row);
+                    p.state.used_rows |= static_cast<uint16_t>(1 << source_row);
+                    this->row_values = &this->grids[state.transposed][SIDE * source_row];
+                    this->layOut(p, 0);
+                }
+            }
+
+            std::memcpy(canonical + SIDE * level, this->best.data(), SIDE);
+            this->states.swap(this->next_states);
+        }
+
+        // Any arrangement left is as good as any other. Digits missing from the puzzle take the labels left over.
+        const State &chosen = this->states.front();
+        transform->transposed = chosen.transposed;
+        transform->rows = chosen.rows;
+        transform->cols = chosen.cols;
+        transform->digits = chosen.labels;
+        uint8_t next_label = chosen.next_label;
+        for (uint32_t d = 1; d <= SIDE; ++d)
+        {
+            if (transform->digits[d] == 0)
+            {
+                transform->digits[d] = next_label++;
+            }
+        }
+    }
+
+    /**
+     * @brief The smallest image of a block mask under some of the column orderings.
+     *
+     * @param mask
+     * @param perms The orderings to try, bit p for PERMS[p]
+     * @return uint16_t The image shifted up by 6, with the orderings that give it in the low 6 bits
+     */
+    uint16_t leastImage(uint32_t mask, uint32_t perms) const
+    {
+        uint32_t least = BOX_MASKS;
+        uint32_t found = 0;
+        for (uint32_t p = 0; p < 6; ++p)
+        {
+            if ((perms & (1 << p)) == 0)
+            {
+                continue;
+            }
+            uint32_t image = this->col_images[p][mask];
+            if (image < least)
+            {
+                least = image;
+                found = 0;
+            }
+            if (image == least)
+            {
+                found |= 1 << p;
+            }
+        }
+        return static_cast<uint16_t>((least << 6) | found);
+    }
+
+    /**
+     * @brief Sorts the stacks of an arrangement by their blocks in the next band, laid out from a source band with its
+     * rows in a given order. Each stack takes the column orderings giving its smallest block, and the stacks of each
+     * group go in order of those blocks.
+     *
+     * @param from
+     * @param band The source band
+     * @param row_perm The ordering of its rows
+     * @param words Set to each stack's smallest block, the column orderings giving it, and the stack's place in from,
+     * packed in that order so that sorting the words sorts the stacks by their blocks
+     * @return uint32_t The band's three blocks as one key, the first in the top bits
+     */
+    uint32_t sortStacks(const Arrangement &from, uint32_t band, uint32_t row_perm, std::array<uint32_t, 3> *words) const
+    {
+        for (uint32_t slot = 0; slot < 3; ++slot)
+        {
+            uint32_t mask = this->row_images[row_perm][this->box_masks[from.transposed][band][from.stacks[slot]]];
+            (*words)[slot] = (static_cast<uint32_t>(this->least_images[from.col_perms[slot]][mask]) << 2) | slot;
+        }
+
+        // A sorting network, leaving out the exchanges that would move a stack out of its group. Which way each
+        // exchange goes depends on the puzzle, so it is done with masks rather than branches.
+        auto exchange = [&](uint32_t a, uint32_t b)
+        {
+            uint32_t swap = static_cast<uint32_t>((*words)[b] < (*words)[a]) & ~(from.group_starts >> b) & 1;
+            uint32_t diff = ((*words)[a] ^ (*words)[b]) & (0 - swap);
+            (*words)[a] ^= diff;
+            (*words)[b] ^= diff;
+        };
+        exchange(0, 1);
+        exchange(1, 2);
+        exchange(0, 1);
+
+        return (((*words)[0] >> 8) << 18) | (((*words)[1] >> 8) << 9) | ((*words)[2] >> 8);
+    }
+
+    /**
+     * @brief Lays out the next band of an arrangement from a source band with its rows in a given order, keeping the
+     * stacks sorted and the column orderings that give the smallest blocks.
+     *
+     * @param from
+     * @param level The output band to lay out
+     * @param band The source band
+     * @param row_perm The ordering of its rows
+     */
+    void layOutBand(const Arrangement &from, uint32_t level, uint32_t band, uint32_t row_perm)
+    {
+        std::array<uint32_t, 3> words;
+        this->sortStacks(from, band, row_perm, &words);
+
+        Arrangement next = from;
+        next.used_bands = static_cast<uint8_t>(next.used_bands | (1 << band));
+        next.bands[level] = static_cast<uint8_t>(band);
+        next.row_perms[level] = static_cast<uint8_t>(row_perm);
+        for (uint32_t slot = 0; slot < 3; ++slot)
+        {
+            next.stacks[slot] = from.stacks[words[slot] & 3];
+            next.col_perms[slot] = static_cast<uint8_t>((words[slot] >> 2) & ALL_PERMS);
+            if ((slot > 0) && ((words[slot] >> 8) != (words[slot - 1] >> 8)))
+            {
+                next.group_starts = static_cast<uint8_t>(next.group_starts | (1 << slot));
+            }
+        }
+        this->next_arrangements.push_back(next);
+    }
+
+    /**
+     * @brief How many symmetries an arrangement stands for: every order of the stacks within each group, with every
+     * column ordering each stack may take.
+     *
+     * @param arrangement
+     * @return uint32_t
+     */
+    static uint32_t countSymmetries(const Arrangement &arrangement)
+    {
+        uint32_t count = 1;
+        uint32_t group_size = 0;
+        for (uint32_t slot = 0; slot < 3; ++slot)
+        {
+            group_size = ((arrangement.group_starts & (1 << slot)) != 0) ? 1 : group_size + 1;
+            count *= group_size * static_cast<uint32_t>(__builtin_popcount(arrangement.col_perms[slot]));
+        }
+        return count;
+    }
+
+    /**
+     * @brief Relabels the clues of the symmetry a transform describes in order of first appearance, and takes the
+     * transform as the best if they come out smaller than the best so far.
+     *
+     * @param values
+     * @param candidate
+     * @param best
+     * @param best_valid
+     */
+    void tryDigits(const uint8_t *values, Transform *candidate, Transform *best, bool *best_valid)
+    {
+        // Worked out in local arrays, which the writes can't be taken to alias
+        std::array<uint8_t, SIDE + 1> digits{};
+        std::array<uint8_t, CELLS> labels;
+        uint32_t row_step = candidate->transposed ? 1 : SIDE;
+        uint32_t col_step = candidate->transposed ? SIDE : 1;
+        uint32_t next_label = 1;
+        uint32_t num_clues = this->num_clues;
+        for (uint32_t n = 0; n < num_clues; ++n)
+        {
+            uint32_t cell = this->clue_cells[n];
+            uint8_t digit = values[row_step * candidate->rows[cell / SIDE] + col_step * candidate->cols[cell % SIDE]];
+
+            // Whether a digit is new depends on the puzzle, so the label is chosen without a branch
+            uint32_t label = digits[digit];
+            uint32_t fresh = (label == 0);
+            label = fresh ? next_label : label;
+            next_label += fresh;
+            digits[digit] = static_cast<uint8_t>(label);
+            labels[n] = static_cast<uint8_t>(label);
+        }
+
+        if (*best_valid && (std::memcmp(labels.data(), this->best_digits.data(), num_clues) >= 0))
+        {
+            return;
+        }
+        std::memcpy(this->best_digits.data(), labels.data(), num_clues);
+        candidate->digits = digits;
+        *best = *candidate;
+        *best_valid = true;
+    }
+
+    /**
+     * @brief Tries the digits of every symmetry an arrangement stands for.
+     *
+     * @param values
+     * @param arrangement
+     * @param best
+     * @param best_valid
+     */
+    void tryArrangement(const uint8_t *values, const Arrangement &arrangement, Transform *best, bool *best_valid)
+    {
+        Transform candidate;
+        candidate.transposed = arrangement.transposed;
+        for (uint32_t b = 0; b < 3; ++b)
+        {
+            for (uint32_t n = 0; n < 3; ++n)
+            {
+                candidate.rows[3 * b + n] =
+                    static_cast<uint8_t>(3 * arrangement.bands[b] + PERMS[arrangement.row_perms[b]][n]);
+            }
+        }
+
+        // The group of each stack, as the number of groups starting at or before it
+        auto group = [&](uint32_t slot)
+        { return __builtin_popcount(arrangement.group_starts & ((2u << slot) - 1)); };
+
+        for (const std::array<uint8_t, 3> &order : PERMS)
+        {
+            if ((group(order[0]) != 1) || (group(order[1]) != group(1)) || (group(order[2]) != group(2)))
+            {
+                continue;
+            }
+
+            // Each stack takes each of the column orderings it may still take in turn
+            std::array<uint8_t, 3> perms;
+            for (perms[0] = 0; perms[0] < 6; ++perms[0])
+            {
+                if ((arrangement.col_perms[order[0]] & (1 << perms[0])) == 0)
+                {
+                    continue;
+                }
+                for (perms[1] = 0; perms[1] < 6; ++perms[1])
+                {
+                    if ((arrangement.col_perms[order[1]] & (1 << perms[1])) == 0)
+                    {
+                        continue;
+                    }
+                    for (perms[2] = 0; perms[2] < 6; ++perms[2])
+                    {
+                        if ((arrangement.col_perms[order[2]] & (1 << perms[2])) == 0)
+                        {
+                            continue;
+                        }
+                        for (uint32_t s = 0; s < 3; ++s)
+                        {
+                            for (uint32_t n = 0; n < 3; ++n)
+                            {
+                                candidate.cols[3 * s + n] =
+                                    static_cast<uint8_t>(3 * arrangement.stacks[order[s]] + PERMS[perms[s]][n]);
+                            }
+                        }
+                        this->tryDigits(values, &candidate, best, best_valid);
+                    }
+                }
+            }
+        }
+    }
+
+public:
+    Canonicalizer() : num_clues(0), best_valid(false), best_version(0), row_values(nullptr)
+    {
+        for (uint32_t mask = 0; mask < BOX_MASKS; ++mask)
+        {
+            auto clue = [&](uint32_t row, uint32_t col)
+            { return (mask >> (8 - (3 * row + col))) & 1; };
+
+            for (uint32_t p = 0; p < 6; ++p)
+            {
+                uint16_t by_rows = 0;
+                uint16_t by_cols = 0;
+                for (uint32_t row = 0; row < 3; ++row)
+                {
+                    for (uint32_t col = 0; col < 3; ++col)
+                    {
+                        uint32_t bit = 8 - (3 * row + col);
+                        by_rows = static_cast<uint16_t>(by_rows | (clue(PERMS[p][row], col) << bit));
+                        by_cols = static_cast<uint16_t>(by_cols | (clue(row, PERMS[p][col]) << bit));
+                    }
+                }
+                this->row_images[p][mask] = by_rows;
+                this->col_images[p][mask] = by_cols;
+            }
+
+            uint16_t transposed = 0;
+            for (uint32_t row = 0; row < 3; ++row)
+            {
+                for (uint32_t col = 0; col < 3; ++col)
+                {
+                    transposed = static_cast<uint16_t>(transposed | (clue(col, row) << (8 - (3 * row + col))));
+                }
+            }
+            this->transposed_images[mask] = transposed;
+        }
+
+        this->least_images.resize(ALL_PERMS + 1);
+        for (uint32_t perms = 1; perms <= ALL_PERMS; ++perms)
+        {
+            for (uint32_t mask = 0; mask < BOX_MASKS; ++mask)
+            {
+                this->least_images[perms][mask] = this->leastImage(mask, perms);
+            }
+        }
+        for (uint32_t mask = 0; mask < BOX_MASKS; ++mask)
+        {
+            uint32_t least = BOX_MASKS;
+            uint32_t found = 0;
+            for (uint32_t p = 0; p < 6; ++p)
+            {
+                uint32_t image = this->least_images[ALL_PERMS][this->row_images[p][mask]] >> 6;
+                if (image < least)
+                {
+                    least = image;
+                    found = 0;
+                }
+                if (image == least)
+                {
+                    found |= 1 << p;
+                }
+            }
+            this->least_block_images[mask] = static_cast<uint16_t>((least << 6) | found);
+        }
+
+        for (uint32_t mask = 0; mask < (1u << SIDE); ++mask)
+        {
+            std::array<uint32_t, 3> counts;
+            for (uint32_t slot = 0; slot < 3; ++slot)
+            {
+                counts[slot] = __builtin_popcount((mask >> (3 * slot)) & 7);
+            }
+            std::sort(counts.begin(), counts.end());
+
+            uint16_t clues = 0;
+            for (uint32_t slot = 0; slot < 3; ++slot)
+            {
+                clues = static_cast<uint16_t>((clues << 3) | ((1 << counts[slot]) - 1));
+            }
+            this->first_row_clues[mask] = clues;
+        }
+
+        this->states.reserve(256);
+        this->next_states.reserve(256);
+        this->arrangements.reserve(256);
+        this->next_arrangements.reserve(256);
+        this->band_keys.reserve(256);
+    }
+
+
+    /**
+     * @brief Finds the canonical form of a puzzle, and the symmetry that takes the puzzle to it.
+     *
+     * @param values The 81 values of the puzzle, 0 for a blank
+     * @param canonical Where to write the 81 values of the canonical form
+     * @param transform Set to the symmetry taking the puzzle to its canonical form
+     */
+    void canonicalize(const uint8_t *values, uint8_t *canonical, Transform *transform)
+    {
+        // Each row's clues as a mask with bit 8 - c for column c, so that the three bits of a stack come out in the
+        // order of a block row. The first eight elements are taken together: the top bit of each byte is set where it
+        // is not 0, and the multiply gathers those bits with byte c landing on bit 7 - c.
+        std::array<uint32_t, SIDE> row_masks;
+        for (uint32_t r = 0; r < SIDE; ++r)
+        {
+            uint64_t word;
+            std::memcpy(&word, values + SIDE * r, sizeof(word));
+            uint64_t clues = ((((word & BYTE_LOW_BITS) + BYTE_LOW_BITS) | word) >> 7) & BYTE_ONES;
+            row_masks[r] = (static_cast<uint32_t>((clues * GATHER_REVERSED) >> 56) << 1) |
+                           static_cast<uint32_t>(values[SIDE * r + 8] != 0);
+        }
+        for (uint32_t band = 0; band < 3; ++band)
+        {
+            for (uint32_t stack = 0; stack < 3; ++stack)
+            {
+                uint32_t shift = 6 - 3 * stack;
+                uint32_t mask = (((row_masks[3 * band] >> shift) & 7) << 6) |
+                                (((row_masks[3 * band + 1] >> shift) & 7) << 3) |
+                                ((row_masks[3 * band + 2] >> shift) & 7);
+                this->box_masks[0][band][stack] = static_cast<uint16_t>(mask);
+                this->box_masks[1][stack][band] = this->transposed_images[mask];
+            }
+        }
+
+        this->arrangements.clear();
+        for (const bool transposed : {false, true})
+        {
+            Arrangement start{};
+            start.transposed = transposed;
+            start.group_starts = 1;
+            start.stacks = {0, 1, 2};
+            start.col_perms = {ALL_PERMS, ALL_PERMS, ALL_PERMS};
+            this->arrangements.push_back(start);
+        }
+
+        // The first band starts with the smallest block of the puzzle, so only the row orderings that bring one of a
+        // band's blocks to it need trying there
+        uint32_t least_block = UINT32_MAX;
+        for (const auto &bands : this->box_masks)
+        {
+            for (const auto &masks : bands)
+            {
+                for (const uint16_t mask : masks)
+                {
+                    least_block = std::min<uint32_t>(least_block, this->least_block_images[mask] >> 6);
+                }
+            }
+        }
+        std::array<std::array<uint8_t, 3>, 2> first_row_perms{};
+        for (uint32_t transposed = 0; transposed < 2; ++transposed)
+        {
+            for (uint32_t band = 0; band < 3; ++band)
+            {
+                for (const uint16_t mask : this->box_masks[transposed][band])
+                {
+                    uint32_t image = this->least_block_images[mask];
+                    uint32_t reaches = 0 - static_cast<uint32_t>((image >> 6) == least_block);
+                    first_row_perms[transposed][band] |= static_cast<uint8_t>(image & ALL_PERMS & reaches);
+                }
+            }
+        }
+
+        // Each band is settled in two passes: every arrangement's blocks first, so that the smallest is found without
+        // waiting on a comparison for each, then only the arrangements giving the smallest are laid out
+        for (uint32_t level = 0; level < 3; ++level)
+        {
+            auto rowPerms = [&](const Arrangement &arrangement, uint32_t band)
+            {
+                if ((arrangement.used_bands & (1 << band)) != 0)
+                {
+                    return static_cast<uint8_t>(0);
+                }
+                return (level == 0) ? first_row_perms[arrangement.transposed][band] : ALL_PERMS;
+            };
+
+            std::array<uint32_t, 3> words;
+            this->band_keys.clear();
+            for (const Arrangement &arrangement : this->arrangements)
+            {
+                for (uint32_t band = 0; band < 3; ++band)
+                {
+                    uint32_t row_perms = rowPerms(arrangement, band);
+                    for (uint32_t row_perm = 0; row_perm < 6; ++row_perm)
+                    {
+                        if ((row_perms & (1 << row_perm)) != 0)
+                        {
+                            this->band_keys.push_back(this->sortStacks(arrangement, band, row_perm, &words));
+                        }
+                    }
+                }
+            }
+            uint32_t least = *std::min_element(this->band_keys.begin(), this->band_keys.end());
+            this->pattern_keys[level] = least;
+
+            this->next_arrangements.clear();
+            size_t index = 0;
+            for (const Arrangement &arrangement : this->arrangements)
+            {
+                for (uint32_t band = 0; band < 3; ++band)
+                {
+                    uint32_t row_perms = rowPerms(arrangement, band);
+                    for (uint32_t row_perm = 0; row_perm < 6; ++row_perm)
+                    {
+                        if (((row_perms & (1 << row_perm)) != 0) && (this->band_keys[index++] == least))
+                        {
+                            this->layOutBand(arrangement, level, band, row_perm);
+                        }
+                    }
+                }
+            }
+            this->arrangements.swap(this->next_arrangements);
+        }
+
+        uint32_t symmetries = 0;
+        for (const Arrangement &arrangement : this->arrangements)
+        {
+            symmetries += countSymmetries(arrangement);
+        }
+        if (symmetries > MAX_PATTERN_SYMMETRIES)
+        {
+            this->searchRows(values, canonical, transform);
+            return;
+        }
+
+        // Every symmetry left gives the same pattern, so the clues fall in the same places for all of them
+        uint32_t num_clues = 0;
+        for (uint32_t row = 0; row < SIDE; ++row)
+        {
+            // The row's clues as a mask with bit 8 - c for column c, taken from its three blocks
+            uint32_t key = this->pattern_keys[row / 3];
+            uint32_t shift = 6 - 3 * (row % 3);
+            uint32_t mask = (((key >> (18 + shift)) & 7) << 6) | (((key >> (9 + shift)) & 7) << 3) |
+                            ((key >> shift) & 7);
+            for (uint32_t col = 0; col < SIDE; ++col)
+            {
+                this->clue_cells[num_clues] = static_cast<uint8_t>(SIDE * row + col);
+                num_clues += (mask >> (8 - col)) & 1;
+            }
+        }
+        this->num_clues = num_clues;
+
+        bool found = false;
+        for (const Arrangement &arrangement : this->arrangements)
+        {
+            this->tryArrangement(values, arrangement, transform, &found);
+        }
+
+        // Digits missing from the puzzle take the labels left over
+        uint8_t next_label = 1;
+        for (uint32_t d = 1; d <= SIDE; ++d)
+        {
+            next_label = std::max<uint8_t>(next_label, static_cast<uint8_t>(transform->digits[d] + 1));
+        }
+        for (uint32_t d = 1; d <= SIDE; ++d)
+        {
+            if (transform->digits[d] == 0)
+            {
+                transform->digits[d] = next_label++;
+            }
+        }
+        transform->apply(values, canonical);
+    }
+};
+
+#endif
@@ -6,7 +6,7 @@
 #include <iterator>
 #include <stdexcept>
 #include <memory>
-#include <set>
+#include <string_view>
 #include <vector>
 
 class StringClue
@@ -15,15 +15,18 @@ class StringClue
 public:
     std::string clue_string;
 
-    StringClue(const std::string &clueString) : clue_string(validateString(clueString)) {}
+    StringClue(std::string_view clueString) : clue_string(validateString(clueString)) {}
 
-    std::string validateString(std::string clueString)
+    /**
+     * @brief Checks that a clue string is a run of colon separated triplets of digits 1-9, and returns the digits
+     * with the colons dropped.
+     *
+     * @param clueString
+     * @return std::string
+     */
+    static std::string validateString(std::string_view clueString)
     {
-
-        std::string return_string;
-        int str_len = clueString.length();
-
-        std::set<char> charSet = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+        size_t str_len = clueString.length();
 
         // The first validity check is just that we have the correct length
         if ((str_len + 1) % 4 != 0)
@@ -31,11 +34,13 @@ public:
             throw std::invalid_argument("Clue string is improperly formatted: wrong length");
         }
 
-        for (int i = 0; i < str_len; ++i)
+        std::string return_string;
+        return_string.reserve(3 * (str_len + 1) / 4);
+        for (size_t i = 0; i < str_len; ++i)
         {
             char c = clueString[i];
 
-            // Index values that are multiples of three should be colon separators
+            // Every fourth character should be a colon separator
             if ((i + 1) % 4 == 0)
             {
                 if (c != ':')
@@ -43,9 +48,9 @@ public:
                     throw std::invalid_argument("Clue string is improperly formatted: no colon delimiters");
                 }
             }
-            else if (charSet.find(c) != charSet.end())
+            else if ((c >= '1') && (c <= '9'))
             {
-                return_string.append(1, c);
+                return_string.push_back(c);
             }
             else
             {
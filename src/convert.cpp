@@ -0,0 +1,339 @@
+#include "canonical.hpp"
+#include "dataset.hpp"
+#include "packed.hpp"
+#include "solver.hpp"
+#include <cstdio>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <unordered_set>
+
+// Text output is collected in a buffer of this size and written out whenever it fills up
+constexpr size_t CONVERT_OUTPUT_BUFFER_SIZE = 1 << 20;
+
+/**
+ * @brief Writes some text out once it has grown past the output buffer size, or whenever flush is set.
+ *
+ * @param text
+ * @param output
+ * @param flush
+ */
+void writeText(std::string *text, std::FILE *output, bool flush = false)
+{
+    if (flush || (text->size() >= CONVERT_OUTPUT_BUFFER_SIZE))
+    {
+        if (std::fwrite(text->data(), 1, text->size(), output) != text->size())
+        {
+            throw std::runtime_error("Could not write text output");
+        }
+        text->clear();
+    }
+}
+
+/**
+ * @brief What happens to each puzzle on its way through: it can be replaced by its canonical form, and dropped if it
+ * is a symmetry of a puzzle that came before it. Both only apply to 9x9 puzzles.
+ *
+ * @tparam BoxSize
+ */
+template <uint32_t BoxSize>
+class PuzzleFilter
+{
+private:
+    bool canonical;
+    bool dedupe;
+    Canonicalizer canonicalizer;
+
+    // The packed canonical form of every puzzle kept so far
+    std::unordered_set<std::string> seen;
+    uint64_t dropped;
+
+public:
+    PuzzleFilter(bool canonical, bool dedupe) : canonical(canonical), dedupe(dedupe), dropped(0)
+    {
+        if ((canonical || dedupe) && (BoxSize != 3))
+        {
+            throw std::runtime_error("Only 9x9 puzzles have canonical forms");
+        }
+    }
+
+    /**
+     * @brief Passes a puzzle through.
+     *
+     * @param values The CELLS values of the puzzle, replaced by its canonical form if asked
+     * @return false if the puzzle is to be dropped
+     */
+    bool pass(uint8_t *values)
+    {
+        using Layout = packed::Layout<BoxSize>;
+
+        if constexpr (BoxSize == 3)
+        {
+            if (!this->canonical && !this->dedupe)
+            {
+                return true;
+            }
+
+            std::array<uint8_t, Layout::CELLS> canonical_values;
+            Canonicalizer::Transform transform;
+            this->canonicalizer.canonicalize(values, canonical_values.data(), &transform);
+            if (this->dedupe)
+            {
+                std::string record(Layout::PUZZLE_RECORD_SIZE, '\0');
+                Layout::packValues(canonical_values.data(), reinterpret_cast<uint8_t *>(&record[0]));
+                if (!this->seen.insert(std::move(record)).second)
+                {
+                    ++this->dropped;
+                    return false;
+                }
+            }
+            if (this->canonical)
+            {
+                std::copy(canonical_values.begin(), canonical_values.end(), values);
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Reports on standard error how many puzzles were dropped, if any could have been.
+     */
+    void report() const
+    {
+        if (this->dedupe)
+        {
+            std::cerr << "Dropped " << this->dropped << " puzzles equivalent to earlier ones" << std::endl;
+        }
+    }
+};
+
+/**
+ * @brief Packs every line of a text dataset into a packed puzzle file, throwing at the first line that is not a
+ * puzzle of the given size.
+ *
+ * @tparam BoxSize
+ * @param dataset
+ * @param output_path
+ * @param filter
+ */
+template <uint32_t BoxSize>
+void packPuzzles(const Dataset &dataset, const std::string &output_path, PuzzleFilter<BoxSize> *filter)
+{
+    using Layout = packed::Layout<BoxSize>;
+
+    std::array<uint8_t, Layout::CELLS> values;
+    std::array<uint8_t, Layout::PUZZLE_RECORD_SIZE> record;
+    packed::Writer writer(output_path, packed::PUZZLE_MAGIC, Layout::SIDE, Layout::PUZZLE_RECORD_SIZE);
+    for (size_t i = 0; i < dataset.size(); ++i)
+    {
+        if (!dataset.readValues<BoxSize>(i, values.data()))
+        {
+            throw std::runtime_error("Line " + std::to_string(i + 1) + " is not a puzzle of this size");
+        }
+        if (!filter->pass(values.data()))
+        {
+            continue;
+        }
+        Layout::packValues(values.data(), record.data());
+        writer.append(record.data());
+    }
+    writer.finish();
+}
+
+/**
+ * @brief Writes every puzzle of a packed dataset as a line of text, in the one character per element form.
+ *
+ * @tparam BoxSize
+ * @param dataset
+ * @param output
+ * @param filter
+ */
+template <uint32_t BoxSize>
+void unpackPuzzles(const Dataset &dataset, std::FILE *output, PuzzleFilter<BoxSize> *filter)
+{
+    dataset.requirePuzzles<BoxSize>();
+
+    std::array<uint8_t, packed::Layout<BoxSize>::CELLS> values;
+    std::string text;
+    for (size_t i = 0; i < dataset.size(); ++i)
+    {
+        dataset.readValues<BoxSize>(i, values.data());
+        if (!filter->pass(values.data()))
+        {
+            continue;
+        }
+        for (const uint8_t value : values)
+        {
+            text.push_back(utils::valueToChar(value));
+        }
+        text.push_back('\n');
+        writeText(&text, output);
+    }
+    writeText(&text, output, true);
+}
+
+/**
+ * @brief Writes every record of a packed results file as a line of text: the solution, or FAIL as the batch
+ * solver writes it, optionally followed by the number of guesses and the time taken in nanoseconds.
+ *
+ * @tparam BoxSize
+ * @param file
+ * @param header
+ * @param details
+ * @param output
+ */
+template <uint32_t BoxSize>
+void unpackResults(const MappedFile &file, const packed::Header &header, bool details, std::FILE *output)
+{
+    using Layout = packed::Layout<BoxSize>;
+
+    if (header.record_size != Layout::RESULT_RECORD_SIZE)
+    {
+        throw std::runtime_error("Packed results have records of the wrong size for their side");
+    }
+
+    const uint8_t *records = reinterpret_cast<const uint8_t *>(file.data()) + packed::HEADER_SIZE;
+    std::array<uint8_t, Layout::CELLS> solution;
+    std::string text;
+    for (uint64_t i = 0; i < header.count; ++i)
+    {
+        packed::Result result = Layout::unpackResult(records + i * Layout::RESULT_RECORD_SIZE, solution.data());
+        if (result.solved)
+        {
+            for (const uint8_t value : solution)
+            {
+                text.push_back(utils::valueToChar(value));
+            }
+        }
+        else
+        {
+            text.append("FAIL");
+        }
+        if (details)
+        {
+            text.append(" " + std::to_string(result.guesses) + " " + std::to_string(result.time_ns));
+        }
+        text.push_back('\n');
+        writeText(&text, output);
+    }
+    writeText(&text, output, true);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        std::cout << "Usage: " << argv[0] << " <input> <output> [--size N] [--details] [--canonical] [--dedupe]"
+                  << "\n  Converts text puzzles, one per line, to a packed puzzle file, and packed puzzle or result"
+                  << "\n  files back to text. The kind of input is told from its contents. Text output goes to"
+                  << "\n  standard output when <output> is -."
+                  << "\n  --size N     The side of text puzzles: 4, 9 (default), 16, or 25"
+                  << "\n  --details    Follow each result with its number of guesses and time taken in nanoseconds"
+                  << "\n  --canonical  Write each 9x9 puzzle in its canonical form under the symmetries of the grid"
+                  << "\n  --dedupe     Drop each 9x9 puzzle that is a symmetry of (or the same as) an earlier one"
+                  << std::endl;
+        return 1;
+    }
+
+    std::string input_path = argv[1];
+    std::string output_path = argv[2];
+    uint32_t side = 9;
+    bool details = false;
+    bool canonical = false;
+    bool dedupe = false;
+
+    for (int i = 3; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "--size" && i + 1 < argc)
+        {
+            side = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--details")
+        {
+            details = true;
+        }
+        else if (arg == "--canonical")
+        {
+            canonical = true;
+        }
+        else if (arg == "--dedupe")
+        {
+            dedupe = true;
+        }
+        else
+        {
+            std::cerr << "Unknown or incomplete argument: " << arg << "\n";
+            return 1;
+        }
+    }
+
+    try
+    {
+        auto openText = [&]()
+        {
+            std::FILE *output = (output_path == "-") ? stdout : std::fopen(output_path.c_str(), "wb");
+            if (output == nullptr)
+            {
+                throw std::runtime_error("Could not open output file");
+            }
+            return output;
+        };
+        auto closeText = [&](std::FILE *output)
+        {
+            if (output != stdout)
+            {
+                std::fclose(output);
+            }
+            else
+            {
+                std::fflush(stdout);
+            }
+        };
+
+        {
+            MappedFile file(input_path);
+            packed::Header header;
+            if (packed::readHeader(file.data(), file.size(), packed::RESULT_MAGIC, &header))
+            {
+                if (canonical || dedupe)
+                {
+                    throw std::runtime_error("--canonical and --dedupe only apply to puzzles");
+                }
+                std::FILE *output = openText();
+                withBoxSizeOf(header.side, [&](auto box)
+                              { unpackResults<decltype(box)::value>(file, header, details, output); });
+                closeText(output);
+                return 0;
+            }
+        }
+
+        Dataset dataset(input_path);
+        if (dataset.isPacked())
+        {
+            std::FILE *output = openText();
+            withBoxSizeOf(dataset.side(), [&](auto box)
+                          {
+                              PuzzleFilter<decltype(box)::value> filter(canonical, dedupe);
+                              unpackPuzzles<decltype(box)::value>(dataset, output, &filter);
+                              filter.report(); });
+            closeText(output);
+        }
+        else
+        {
+            withBoxSizeOf(side, [&](auto box)
+                          {
+                              PuzzleFilter<decltype(box)::value> filter(canonical, dedupe);
+                              packPuzzles<decltype(box)::value>(dataset, output_path, &filter);
+                              filter.report(); });
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Exception caught: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,301 @@
+#ifndef SUDOFUN_DATASET_HEADER
+#define SUDOFUN_DATASET_HEADER
+
+#include "packed.hpp"
+#include "parser.hpp"
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define SUDOFUN_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief A read-only file mapped into memory. Since the mapping is shared through the page cache, every loop and
+ * worker thread reading the same file reads the same pages. Platforms without mmap fall back to reading the file
+ * into one buffer.
+ */
+class MappedFile
+{
+private:
+    const char *contents;
+    size_t contents_size;
+
+#if defined(SUDOFUN_HAVE_MMAP)
+    void *mapping;
+#else
+    std::string buffer;
+#endif
+
+public:
+    /**
+     * @brief Maps a file.
+     *
+     * @param filename
+     */
+    explicit MappedFile(const std::string &filename) : contents(nullptr), contents_size(0)
+    {
+#if defined(SUDOFUN_HAVE_MMAP)
+        this->mapping = nullptr;
+
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            throw std::runtime_error("Could not open clue file");
+        }
+
+        struct stat file_stat;
+        if (::fstat(fd, &file_stat) != 0)
+        {
+            ::close(fd);
+            throw std::runtime_error("Could not stat clue file");
+        }
+        this->contents_size = static_cast<size_t>(file_stat.st_size);
+
+        // Zero length mappings are not allowed, but an empty file is just an empty dataset
+        if (this->contents_size > 0)
+        {
+            this->mapping = ::mmap(nullptr, this->contents_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (this->mapping == MAP_FAILED)
+            {
+                ::close(fd);
+                throw std::runtime_error("Could not map clue file");
+            }
+            ::madvise(this->mapping, this->contents_size, MADV_WILLNEED);
+        }
+        ::close(fd);
+
+        this->contents = static_cast<const char *>(this->mapping);
+#else
+        std::ifstream file(filename, std::ios::binary);
+        if (!file.is_open())
+        {
+            throw std::runtime_error("Could not open clue file");
+        }
+        this->buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        this->contents = this->buffer.data();
+        this->contents_size = this->buffer.size();
+#endif
+    }
+
+    ~MappedFile()
+    {
+#if defined(SUDOFUN_HAVE_MMAP)
+        if (this->mapping != nullptr)
+        {
+            ::munmap(this->mapping, this->contents_size);
+        }
+#endif
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const char *data() const
+    {
+        return this->contents;
+    }
+
+    size_t size() const
+    {
+        return this->contents_size;
+    }
+};
+
+/**
+ * @brief A puzzle file, either text or packed (see packed.hpp), mapped into memory. Text is split into lines that
+ * point straight into the mapping, so no line is ever copied. The records of a packed file are all the same width,
+ * so they need no index at all: puzzle i is read straight from its offset.
+ */
+class Dataset
+{
+private:
+    MappedFile file;
+    std::vector<std::string_view> lines;
+
+    // Set for a packed file, whose records start after the header
+    bool is_packed;
+    packed::Header header;
+    const uint8_t *records;
+
+    void indexLines()
+    {
+        const char *pos = this->file.data();
+        const char *end = pos + this->file.size();
+        while (pos < end)
+        {
+            const char *newline = static_cast<const char *>(std::memchr(pos, '\n', end - pos));
+            const char *line_end = (newline != nullptr) ? newline : end;
+
+            // Tolerate Windows line endings
+            size_t length = line_end - pos;
+            if ((length > 0) && (pos[length - 1] == '\r'))
+            {
+                --length;
+            }
+            this->lines.emplace_back(pos, length);
+
+            pos = line_end + 1;
+        }
+    }
+
+public:
+    /**
+     * @brief Maps a puzzle file, and either checks its header (for a packed file) or indexes its lines.
+     *
+     * @param filename
+     */
+    explicit Dataset(const std::string &filename) : file(filename), is_packed(false), header{}, records(nullptr)
+    {
+        if (packed::readHeader(this->file.data(), this->file.size(), packed::RESULT_MAGIC, &this->header))
+        {
+            throw std::runtime_error("File holds results rather than puzzles");
+        }
+
+        this->is_packed = packed::readHeader(this->file.data(), this->file.size(), packed::PUZZLE_MAGIC,
+                                             &this->header);
+        if (this->is_packed)
+        {
+            this->records = reinterpret_cast<const uint8_t *>(this->file.data()) + packed::HEADER_SIZE;
+        }
+        else
+        {
+            this->indexLines();
+        }
+    }
+
+    /**
+     * @brief Checks that every puzzle can be read as a puzzle of a given size, throwing otherwise. Every record of a
+     * packed file is unpacked, since a value past the side only shows up there.
+     *
+     * @tparam BoxSize
+     */
+    template <uint32_t BoxSize>
+    void requirePuzzles() const
+    {
+        this->requireSide<BoxSize>();
+
+        std::array<uint8_t, BasicPuzzle<BoxSize>::CELLS> values;
+        for (size_t i = 0; i < this->size(); ++i)
+        {
+            if (!this->readValues<BoxSize>(i, values.data()))
+            {
+                throw std::runtime_error((this->is_packed ? "Record " : "Line ") + std::to_string(i + 1) +
+                                         " is not a puzzle of this size");
+            }
+        }
+    }
+
+    /**
+     * @brief Checks that a packed file holds puzzles of a given size, throwing otherwise. Any text file passes,
+     * since a line of the wrong size just fails to read.
+     *
+     * @tparam BoxSize
+     */
+    template <uint32_t BoxSize>
+    void requireSide() const
+    {
+        using Layout = packed::Layout<BoxSize>;
+
+        if (this->is_packed &&
+            ((this->header.side != Layout::SIDE) || (this->header.record_size != Layout::PUZZLE_RECORD_SIZE)))
+        {
+            throw std::runtime_error("Packed file holds puzzles of side " + std::to_string(this->header.side));
+        }
+    }
+
+    /**
+     * @brief Reads a puzzle as one value per element (0 for a blank). The size must already have been checked with
+     * requireSide() or requirePuzzles().
+     *
+     * @tparam BoxSize
+     * @param index
+     * @param values Space for the CELLS values
+     * @return true if the puzzle could be read
+     */
+    template <uint32_t BoxSize>
+    bool readValues(size_t index, uint8_t *values) const
+    {
+        using Layout = packed::Layout<BoxSize>;
+
+        if (this->is_packed)
+        {
+            return Layout::unpackValues(this->records + index * Layout::PUZZLE_RECORD_SIZE, values);
+        }
+        return parser::readValues<BoxSize>(this->lines[index], values);
+    }
+
+    /**
+     * @brief Reads a puzzle into a freshly constructed puzzle.
+     *
+     * @tparam BoxSize
+     * @param index
+     * @param puzzle
+     * @return true if the puzzle could be read and none of its clues conflict
+     */
+    template <uint32_t BoxSize>
+    bool loadPuzzle(size_t index, BasicPuzzle<BoxSize> *puzzle) const
+    {
+        std::array<uint8_t, BasicPuzzle<BoxSize>::CELLS> values;
+        return this->readValues<BoxSize>(index, values.data()) && puzzle->addClueValues(values.data());
+    }
+
+    /**
+     * @brief Appends a puzzle to some text: the line itself from a text file, or the one character per element form
+     * from a packed file. A packed value past the side comes out as '?', so the text doesn't read as a puzzle either.
+     *
+     * @tparam BoxSize
+     * @param index
+     * @param out
+     * @return true if the puzzle could be read
+     */
+    template <uint32_t BoxSize>
+    bool appendText(size_t index, std::string *out) const
+    {
+        if (!this->is_packed)
+        {
+            out->append(this->lines[index]);
+            return true;
+        }
+
+        std::array<uint8_t, BasicPuzzle<BoxSize>::CELLS> values;
+        bool read = this->readValues<BoxSize>(index, values.data());
+        for (const uint8_t value : values)
+        {
+            out->push_back((value <= BasicPuzzle<BoxSize>::SIDE) ? utils::valueToChar(value) : '?');
+        }
+        return read;
+    }
+
+    bool isPacked() const
+    {
+        return this->is_packed;
+    }
+
+    /**
+     * @brief The side of the puzzles of a packed file, as given by its header. A text file doesn't say.
+     *
+     * @return uint32_t
+     */
+    uint32_t side() const
+    {
+        return this->header.side;
+    }
+
+    size_t size() const
+    {
+        return this->is_packed ? static_cast<size_t>(this->header.count) : this->lines.size();
+    }
+};
+
+#endif
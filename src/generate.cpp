@@ -0,0 +1,197 @@
+#include "generator.hpp"
+#include "workers.hpp"
+#include <cstdio>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Number of puzzles generated between writes, which bounds the memory held for output
+constexpr size_t GENERATE_BLOCK_SIZE = 4096;
+
+// Number of puzzles handed to a worker at a time
+constexpr size_t GENERATE_CHUNK_SIZE = 8;
+
+/**
+ * @brief Maps a technique name as given on the command line to its Solver::Technique value.
+ *
+ * @param name
+ * @return uint32_t
+ */
+uint32_t parseTechnique(const std::string &name)
+{
+    if (name == "strike")
+    {
+        return Solver::STRIKE;
+    }
+    if (name == "unique")
+    {
+        return Solver::UNIQUE;
+    }
+    if (name == "squeeze")
+    {
+        return Solver::SQUEEZE;
+    }
+    if (name == "pipe")
+    {
+        return Solver::PIPE;
+    }
+    if (name == "subset")
+    {
+        return Solver::SUBSET;
+    }
+    if (name == "fish")
+    {
+        return Solver::FISH;
+    }
+    if (name == "guess")
+    {
+        return Solver::GUESS;
+    }
+    throw std::invalid_argument("Unknown technique: " + name);
+}
+
+/**
+ * @brief Parses a difficulty band of the form <technique> or <easiest>:<hardest>.
+ *
+ * @param band_string
+ * @return Generator::DifficultyBand
+ */
+Generator::DifficultyBand parseDifficultyBand(const std::string &band_string)
+{
+    size_t colon = band_string.find(':');
+    Generator::DifficultyBand band;
+    if (colon == std::string::npos)
+    {
+        band.easiest = band.hardest = parseTechnique(band_string);
+    }
+    else
+    {
+        band.easiest = parseTechnique(band_string.substr(0, colon));
+        band.hardest = parseTechnique(band_string.substr(colon + 1));
+    }
+
+    if (band.easiest > band.hardest)
+    {
+        throw std::invalid_argument("Difficulty band is backwards: " + band_string);
+    }
+    return band;
+}
+
+void runGenerate(uint64_t count, uint64_t seed, const Generator::DifficultyBand &band, uint32_t threads,
+                 std::FILE *output)
+{
+    // One line per puzzle, including the newline
+    std::vector<char> buffer(GENERATE_BLOCK_SIZE * 82);
+
+    for (uint64_t block_begin = 0; block_begin < count; block_begin += GENERATE_BLOCK_SIZE)
+    {
+        size_t block_size = static_cast<size_t>(std::min<uint64_t>(GENERATE_BLOCK_SIZE, count - block_begin));
+
+        WorkStealingRanges ranges(block_size, threads, GENERATE_CHUNK_SIZE);
+        runWorkers(threads, [&](uint32_t worker)
+                   {
+                       Generator generator;
+                       size_t begin, end;
+                       while (ranges.next(worker, &begin, &end))
+                       {
+                           for (size_t i = begin; i < end; ++i)
+                           {
+                               char *line = &buffer[i * 82];
+                               generator.seed(Generator::puzzleSeed(seed, block_begin + i));
+                               generator.generate(line, band);
+                               line[81] = '\n';
+                           }
+                       } });
+
+        if (std::fwrite(buffer.data(), 82, block_size, output) != block_size)
+        {
+            throw std::runtime_error("Could not write generated puzzles");
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        std::cout << "Usage: " << argv[0] << " <count> [--seed S] [--threads N] [--difficulty BAND] [--output path]"
+                  << "\n  --seed S          Seed for the run; the same seed always gives the same puzzles (default 0)"
+                  << "\n  --threads N       Generate on N worker threads (0 for one per hardware thread)"
+                  << "\n  --difficulty BAND The hardest technique the puzzles may need, as one of"
+                  << "\n                    strike, unique, squeeze, pipe, subset, fish, or guess, or a range"
+                  << "\n                    such as unique:pipe; a band that splits subset, fish, and guess"
+                  << "\n                    is rated with the deep pipeline"
+                  << "\n  --output path     Write the puzzles to a file rather than standard output" << std::endl;
+        return 1;
+    }
+
+    try
+    {
+        uint64_t count = std::stoull(argv[1]);
+        uint64_t seed = 0;
+        uint32_t threads = 1;
+        Generator::DifficultyBand band = Generator::ANY_DIFFICULTY;
+        std::string output_path;
+
+        for (int i = 2; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+
+            if (arg == "--seed" && i + 1 < argc)
+            {
+                seed = std::stoull(argv[++i]);
+            }
+            else if (arg == "--threads" && i + 1 < argc)
+            {
+                threads = static_cast<uint32_t>(std::stoul(argv[++i]));
+            }
+            else if (arg == "--difficulty" && i + 1 < argc)
+            {
+                band = parseDifficultyBand(argv[++i]);
+            }
+            else if (arg == "--output" && i + 1 < argc)
+            {
+                output_path = argv[++i];
+            }
+            else
+            {
+                std::cerr << "Unknown or incomplete argument: " << arg << "\n";
+                return 1;
+            }
+        }
+
+        if (threads == 0)
+        {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        std::FILE *output = stdout;
+        if (!output_path.empty())
+        {
+            output = std::fopen(output_path.c_str(), "wb");
+            if (output == nullptr)
+            {
+                throw std::runtime_error("Could not open output file");
+            }
+        }
+
+        runGenerate(count, seed, band, threads, output);
+
+        if (output != stdout)
+        {
+            std::fclose(output);
+        }
+        else
+        {
+            std::fflush(stdout);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Exception caught: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,219 @@
+#ifndef SUDOFUN_GENERATOR_HEADER
+#define SUDOFUN_GENERATOR_HEADER
+
+#include "solver.hpp"
+#include <array>
+#include <random>
+#include <stdint.h>
+
+/**
+ * @brief Generates puzzles with a unique solution. A random full grid is built first, then clues are removed from
+ * it in a random order, keeping each removal only if the puzzle still has a unique solution and is no harder than
+ * the requested band. Difficulty is the hardest Solver technique needed to solve the puzzle.
+ *
+ * Every puzzle is generated from its own seed, so a given seed always yields the same puzzle no matter which
+ * thread generates it.
+ */
+class Generator
+{
+public:
+    // The range of hardest techniques a generated puzzle may need, as Solver::Technique values
+    struct DifficultyBand
+    {
+        uint32_t easiest;
+        uint32_t hardest;
+    };
+
+    static constexpr DifficultyBand ANY_DIFFICULTY{Solver::STRIKE, Solver::GUESS};
+
+private:
+    std::mt19937_64 rng;
+
+    uint32_t randomBelow(uint32_t n)
+    {
+        return static_cast<uint32_t>(this->rng() % n);
+    }
+
+    // Fisher-Yates, spelled out rather than std::shuffle so the output is the same under every standard library
+    template <typename T, size_t N>
+    void shuffle(std::array<T, N> *values)
+    {
+        for (uint32_t i = N - 1; i > 0; --i)
+        {
+            std::swap((*values)[i], (*values)[this->randomBelow(i + 1)]);
+        }
+    }
+
+public:
+    explicit Generator(uint64_t seed = 0) : rng(seed) {}
+
+    /**
+     * @brief Derives the seed of one puzzle of a run from the run's seed, so that puzzles can be generated in any
+     * order (or on any thread) and still come out the same. This is the splitmix64 finalizer.
+     *
+     * @param run_seed
+     * @param puzzle_index
+     * @return uint64_t
+     */
+    static uint64_t puzzleSeed(uint64_t run_seed, uint64_t puzzle_index)
+    {
+        uint64_t z = run_seed + (puzzle_index + 1) * 0x9E3779B97F4A7C15ULL;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    void seed(uint64_t seed)
+    {
+        this->rng.seed(seed);
+    }
+
+    /**
+     * @brief The hardest technique in a mask of techniques used. A puzzle that needed nothing at all (i.e. a full
+     * grid) counts as needing strike.
+     *
+     * @param techniques_used A mask of Solver::Technique values
+     * @return uint32_t
+     */
+    static uint32_t hardestTechnique(uint32_t techniques_used)
+    {
+        uint32_t hardest = Solver::STRIKE;
+        while ((techniques_used >> 1) != 0)
+        {
+            techniques_used >>= 1;
+            hardest <<= 1;
+        }
+        return hardest;
+    }
+
+    /**
+     * @brief The pipeline to rate puzzles with for a band. Subsets and fish only run in the deep pipeline, and the
+     * standard one rates a puzzle that needs them as needing a guess. That only makes no difference to a band that
+     * takes in all of subset, fish, and guess, or none of them, and those bands keep the cheaper standard pipeline.
+     *
+     * @param band
+     * @return Solver::Pipeline
+     */
+    static Solver::Pipeline ratingPipeline(const DifficultyBand &band)
+    {
+        bool takes_all = (band.easiest <= Solver::SUBSET) && (band.hardest >= Solver::GUESS);
+        bool takes_none = (band.hardest < Solver::SUBSET);
+        return (takes_all || takes_none) ? Solver::Pipeline::STANDARD : Solver::Pipeline::DEEP;
+    }
+
+    /**
+     * @brief Checks whether a puzzle in benchmark format has exactly one solution, and if so rates it.
+     *
+     * @param grid 81 characters, '.' for blanks
+     * @param hardest Set to the hardest technique needed if the solution is unique
+     * @param pipeline The pipeline to rate with; see ratingPipeline()
+     * @return true if the solution is unique
+     */
+    static bool rateUnique(const char *grid, uint32_t *hardest, Solver::Pipeline pipeline = Solver::Pipeline::STANDARD)
+    {
+        Puzzle puzzle = Puzzle();
+        puzzle.addBenchmarkString(std::string_view(grid, 81));
+        Solver solver = Solver(&puzzle);
+
+        if (solver.countSolutions(2, pipeline) != 1)
+        {
+            return false;
+        }
+
+        *hardest = hardestTechnique(solver.techniquesUsed());
+        return true;
+    }
+
+    /**
+     * @brief Fills a random full grid. The three diagonal blocks share no row or column, so any arrangement of
+     * digits within each of them extends to a full grid, and the solver fills in the rest.
+     *
+     * @param grid Filled with 81 digit characters
+     */
+    void fullGrid(char *grid)
+    {
+        std::array<char, 9> digits = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+        std::fill(grid, grid + 81, '.');
+        for (uint32_t g = 0; g < 9; g += 4)
+        {
+            this->shuffle(&digits);
+            for (uint32_t n = 0; n < 9; ++n)
+            {
+                grid[maps::BLK_TO_FLAT[g][n]] = digits[n];
+            }
+        }
+
+        Puzzle puzzle = Puzzle();
+        puzzle.addBenchmarkString(std::string_view(grid, 81));
+        Solver solver = Solver(&puzzle);
+        solver.solve();
+        puzzle.writeBenchmarkString(grid);
+    }
+
+    /**
+     * @brief Removes clues from a grid in a random order, keeping every removal after which the puzzle still has
+     * a unique solution and needs nothing harder than a given technique.
+     *
+     * @param grid A puzzle in benchmark format with a unique solution, '.' for blanks
+     * @param hardest_allowed The hardest Solver::Technique the puzzle may need
+     * @param pipeline The pipeline to rate with
+     * @return uint32_t The hardest technique the final puzzle needs
+     */
+    uint32_t removeClues(char *grid, uint32_t hardest_allowed,
+                         Solver::Pipeline pipeline = Solver::Pipeline::STANDARD)
+    {
+        std::array<uint8_t, 81> order;
+        for (uint32_t i = 0; i < 81; ++i)
+        {
+            order[i] = static_cast<uint8_t>(i);
+        }
+        this->shuffle(&order);
+
+        uint32_t hardest = Solver::STRIKE;
+        for (const uint8_t flat_index : order)
+        {
+            char clue = grid[flat_index];
+            if (clue == '.')
+            {
+                continue;
+            }
+
+            grid[flat_index] = '.';
+            uint32_t candidate_hardest;
+            if (rateUnique(grid, &candidate_hardest, pipeline) && (candidate_hardest <= hardest_allowed))
+            {
+                hardest = candidate_hardest;
+            }
+            else
+            {
+                grid[flat_index] = clue;
+            }
+        }
+
+        return hardest;
+    }
+
+    /**
+     * @brief Generates a puzzle within a difficulty band, starting over from a new full grid until one lands in it.
+     *
+     * @param grid Filled with the 81 character puzzle, '.' for blanks
+     * @param band
+     * @return uint32_t The number of full grids it took
+     */
+    uint32_t generate(char *grid, const DifficultyBand &band)
+    {
+        Solver::Pipeline pipeline = ratingPipeline(band);
+        uint32_t attempts = 0;
+        while (true)
+        {
+            ++attempts;
+            this->fullGrid(grid);
+            if (this->removeClues(grid, band.hardest, pipeline) >= band.easiest)
+            {
+                return attempts;
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef SUDOFUN_HISTOGRAM_HEADER
+#define SUDOFUN_HISTOGRAM_HEADER
+
+#include <array>
+#include <stdint.h>
+
+/**
+ * @brief A log-linear histogram of latencies in nanoseconds, in the style of HdrHistogram. Every power of two
+ * range is split into 64 equal buckets, so any recorded value is known to within 1/64 (about 1.6%) of itself
+ * however large it is, at a fixed size and with a constant-time record.
+ */
+class LatencyHistogram
+{
+private:
+    // Values below 2^SUB_BUCKET_BITS get a bucket each; above that each power of two gets half that many buckets
+    static constexpr uint32_t SUB_BUCKET_BITS = 7;
+    static constexpr uint32_t SUB_BUCKET_HALF = 1 << (SUB_BUCKET_BITS - 1);
+    static constexpr uint32_t BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 2) * SUB_BUCKET_HALF;
+
+    std::array<uint64_t, BUCKET_COUNT> counts;
+    uint64_t total_count;
+    uint64_t max_value;
+
+    static uint32_t highestBitIndex(uint64_t value)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return 63 - __builtin_clzll(value);
+#else
+        uint32_t index = 0;
+        while ((value >>= 1) != 0)
+        {
+            ++index;
+        }
+        return index;
+#endif
+    }
+
+    static uint32_t bucketIndex(uint64_t value)
+    {
+        if (value < (2 * SUB_BUCKET_HALF))
+        {
+            return static_cast<uint32_t>(value);
+        }
+
+        // Shift the value down into [SUB_BUCKET_HALF, 2 * SUB_BUCKET_HALF), which is its position in its range
+        uint32_t shift = highestBitIndex(value) - (SUB_BUCKET_BITS - 1);
+        return shift * SUB_BUCKET_HALF + static_cast<uint32_t>(value >> shift);
+    }
+
+    // The largest value which lands in a bucket
+    static uint64_t bucketHighestValue(uint32_t index)
+    {
+        if (index < (2 * SUB_BUCKET_HALF))
+        {
+            return index;
+        }
+
+        uint32_t shift = index / SUB_BUCKET_HALF - 1;
+        uint64_t sub_bucket = index - shift * SUB_BUCKET_HALF;
+        return ((sub_bucket + 1) << shift) - 1;
+    }
+
+public:
+    LatencyHistogram() : counts{}, total_count(0), max_value(0) {}
+
+    void record(uint64_t value_ns)
+    {
+        ++this->counts[bucketIndex(value_ns)];
+        ++this->total_count;
+        this->max_value = (value_ns > this->max_value) ? value_ns : this->max_value;
+    }
+
+    void merge(const LatencyHistogram &other)
+    {
+        for (uint32_t i = 0; i < BUCKET_COUNT; ++i)
+        {
+            this->counts[i] += other.counts[i];
+        }
+        this->total_count += other.total_count;
+        this->max_value = (other.max_value > this->max_value) ? other.max_value : this->max_value;
+    }
+
+    uint64_t count() const
+    {
+        return this->total_count;
+    }
+
+    uint64_t max() const
+    {
+        return this->max_value;
+    }
+
+    /**
+     * @brief The value at a percentile: the smallest value that at least that percent of the recorded values
+     * are no greater than, to within the resolution of the histogram.
+     *
+     * @param percentile From 0 to 100
+     * @return uint64_t Zero if nothing has been recorded
+     */
+    uint64_t valueAtPercentile(double percentile) const
+    {
+        if (this->total_count == 0)
+        {
+            return 0;
+        }
+
+        // The rank of the value we're after, counting from 1
+        uint64_t rank = static_cast<uint64_t>(percentile / 100.0 * static_cast<double>(this->total_count) + 0.5);
+        rank = (rank == 0) ? 1 : rank;
+
+        uint64_t seen = 0;
+        for (uint32_t i = 0; i < BUCKET_COUNT; ++i)
+        {
+            seen += this->counts[i];
+            if (seen >= rank)
+            {
+                uint64_t value = bucketHighestValue(i);
+                return (value < this->max_value) ? value : this->max_value;
+            }
+        }
+        return this->max_value;
+    }
+};
+
+#endif
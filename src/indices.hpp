@@ -0,0 +1,356 @@
+#ifndef SUDOFUN_INDICES_HEADER
+#define SUDOFUN_INDICES_HEADER
+
+#include "utils.hpp"
+#include <array>
+#include <stdint.h>
+#include <type_traits>
+
+/**
+ * @brief A set of flat puzzle indices (0 to Size - 1) stored as a bit mask over as many 64 bit words as it takes.
+ * Iterating the set yields its members in ascending order, and works on a snapshot of the set so members may be
+ * erased mid-iteration.
+ *
+ * @tparam Size The number of possible members, e.g. 81 for the cells of a 9x9 puzzle
+ */
+template <uint32_t Size>
+class BasicIndexSet
+{
+public:
+    static constexpr uint32_t WORDS = (Size + 63) / 64;
+
+private:
+    // Bits 0-63 of the set live in the first word, bits 64-127 in the second, and so on
+    std::array<uint64_t, WORDS> words;
+
+public:
+    class Iterator
+    {
+    private:
+        // What remains of the set; the lowest remaining member is always in the first nonzero word
+        std::array<uint64_t, WORDS> words;
+
+    public:
+        Iterator(const std::array<uint64_t, WORDS> &words) : words(words) {}
+
+        uint32_t operator*() const
+        {
+            for (uint32_t w = 0; w + 1 < WORDS; ++w)
+            {
+                if (words[w] != 0)
+                {
+                    return 64 * w + utils::lowestBitIndex(words[w]);
+                }
+            }
+            return 64 * (WORDS - 1) + utils::lowestBitIndex(words[WORDS - 1]);
+        }
+
+        Iterator &operator++()
+        {
+            // Clear the lowest active bit
+            for (uint32_t w = 0; w + 1 < WORDS; ++w)
+            {
+                if (words[w] != 0)
+                {
+                    words[w] &= words[w] - 1;
+                    return *this;
+                }
+            }
+            words[WORDS - 1] &= words[WORDS - 1] - 1;
+            return *this;
+        }
+
+        bool operator!=(const Iterator &other) const
+        {
+            uint64_t differ = 0;
+            for (uint32_t w = 0; w < WORDS; ++w)
+            {
+                differ |= words[w] ^ other.words[w];
+            }
+            return differ != 0;
+        }
+    };
+
+    constexpr BasicIndexSet() : words{} {}
+
+    /**
+     * @brief Builds a two word set from its words, e.g. as produced by one of the kernels.
+     *
+     * @param lo Membership of indices 0-63
+     * @param hi Membership of indices 64 and up
+     */
+    constexpr BasicIndexSet(uint64_t lo, uint64_t hi) : words{lo, hi}
+    {
+        static_assert(WORDS == 2, "Only two word sets are built from a pair of words");
+    }
+
+    /**
+     * @brief Returns a set holding every possible member.
+     *
+     * @return BasicIndexSet
+     */
+    static constexpr BasicIndexSet full()
+    {
+        BasicIndexSet set;
+        for (uint32_t w = 0; w < WORDS; ++w)
+        {
+            uint32_t bits = (Size - 64 * w < 64) ? Size - 64 * w : 64;
+            set.words[w] = (bits == 64) ? ~static_cast<uint64_t>(0) : (static_cast<uint64_t>(1) << bits) - 1;
+        }
+        return set;
+    }
+
+    /**
+     * @brief Builds a set of flat indices from one mask per row, where bit n of a row's mask selects its nth column.
+     *
+     * @param row_masks
+     * @return BasicIndexSet
+     */
+    template <typename Mask, size_t Side>
+    static BasicIndexSet fromRowMasks(const std::array<Mask, Side> &row_masks)
+    {
+        static_assert(Side * Side == Size, "Row masks must cover the whole puzzle");
+
+        BasicIndexSet set;
+        for (uint32_t r = 0; r < Side; ++r)
+        {
+            uint64_t mask = row_masks[r];
+            uint32_t shift = static_cast<uint32_t>(Side) * r;
+            uint32_t w = shift / 64;
+            uint32_t offset = shift % 64;
+            set.words[w] |= mask << offset;
+
+            // Some rows straddle two words
+            if (offset + Side > 64)
+            {
+                set.words[w + 1] |= mask >> (64 - offset);
+            }
+        }
+        return set;
+    }
+
+    constexpr void insert(uint32_t flat_index)
+    {
+        words[flat_index >> 6] |= static_cast<uint64_t>(1) << (flat_index & 63);
+    }
+
+    constexpr void erase(uint32_t flat_index)
+    {
+        words[flat_index >> 6] &= ~(static_cast<uint64_t>(1) << (flat_index & 63));
+    }
+
+    /**
+     * @brief Removes every member of another set from this one.
+     *
+     * @param other
+     */
+    constexpr void erase(const BasicIndexSet &other)
+    {
+        for (uint32_t w = 0; w < WORDS; ++w)
+        {
+            words[w] &= ~other.words[w];
+        }
+    }
+
+    constexpr BasicIndexSet operator&(const BasicIndexSet &other) const
+    {
+        BasicIndexSet set;
+        for (uint32_t w = 0; w < WORDS; ++w)
+        {
+            set.words[w] = words[w] & other.words[w];
+        }
+        return set;
+    }
+
+    constexpr BasicIndexSet operator|(const BasicIndexSet &other) const
+    {
+        BasicIndexSet set;
+        for (uint32_t w = 0; w < WORDS; ++w)
+        {
+            set.words[w] = words[w] | other.words[w];
+        }
+        return set;
+    }
+
+    constexpr BasicIndexSet &operator|=(const BasicIndexSet &other)
+    {
+        for (uint32_t w = 0; w < WORDS; ++w)
+        {
+            words[w] |= other.words[w];
+        }
+        return *this;
+    }
+
+    /**
+     * @brief The members of this set which are not in another.
+     *
+     * @param other
+     * @return BasicIndexSet
+     */
+    constexpr BasicIndexSet without(const BasicIndexSet &other) const
+    {
+        BasicIndexSet set;
+        for (uint32_t w = 0; w < WORDS; ++w)
+        {
+            set.words[w] = words[w] & ~other.words[w];
+        }
+        return set;
+    }
+
+    /**
+     * @brief Whether every member of this set is also in another.
+     *
+     * @param other
+     * @return bool
+     */
+    constexpr bool subsetOf(const BasicIndexSet &other) const
+    {
+        return this->without(other).empty();
+    }
+
+    constexpr bool contains(uint32_t flat_index) const
+    {
+        return (words[flat_index >> 6] >> (flat_index & 63)) & 1;
+    }
+
+    uint32_t size() const
+    {
+        uint32_t count = 0;
+        for (uint32_t w = 0; w < WORDS; ++w)
+        {
+            count += utils::countBits64(words[w]);
+        }
+        return count;
+    }
+
+    constexpr bool empty() const
+    {
+        uint64_t any = 0;
+        for (uint32_t w = 0; w < WORDS; ++w)
+        {
+            any |= words[w];
+        }
+        return any == 0;
+    }
+
+    Iterator begin() const
+    {
+        return Iterator(words);
+    }
+
+    Iterator end() const
+    {
+        return Iterator(std::array<uint64_t, WORDS>{});
+    }
+};
+
+// The cells of a 9x9 puzzle
+using IndexSet = BasicIndexSet<81>;
+
+/**
+ * @brief A fixed capacity list of flat puzzle indices. Each index can appear at most once between calls
+ * to clear(), so the capacity is never exceeded.
+ *
+ * @tparam Capacity The number of cells in the puzzle
+ */
+template <uint32_t Capacity>
+class BasicIndexStack
+{
+private:
+    // The smallest type that holds every index
+    using Index = std::conditional_t<(Capacity <= 256), uint8_t, uint16_t>;
+
+    std::array<Index, Capacity> indices;
+    uint32_t count;
+
+public:
+    BasicIndexStack() : count(0) {}
+
+    void push_back(uint32_t flat_index)
+    {
+        indices[count++] = static_cast<Index>(flat_index);
+    }
+
+    void clear()
+    {
+        count = 0;
+    }
+
+    uint32_t size() const
+    {
+        return count;
+    }
+
+    bool empty() const
+    {
+        return count == 0;
+    }
+
+    const Index *begin() const
+    {
+        return indices.data();
+    }
+
+    const Index *end() const
+    {
+        return indices.data() + count;
+    }
+};
+
+// The cells of a 9x9 puzzle
+using IndexStack = BasicIndexStack<81>;
+
+/**
+ * @brief A view over the members of a row, column, or block selected by a mask, where bit n of the mask selects
+ * the nth member of the group. Iteration yields flat puzzle indices.
+ */
+class UnitIndices
+{
+private:
+    uint32_t mask;
+    const uint32_t *flat;
+
+public:
+    class Iterator
+    {
+    private:
+        uint32_t mask;
+        const uint32_t *flat;
+
+    public:
+        Iterator(uint32_t mask, const uint32_t *flat) : mask(mask), flat(flat) {}
+
+        uint32_t operator*() const
+        {
+            return flat[utils::lowestBitIndex(mask)];
+        }
+
+        Iterator &operator++()
+        {
+            mask &= mask - 1;
+            return *this;
+        }
+
+        bool operator!=(const Iterator &other) const
+        {
+            return mask != other.mask;
+        }
+    };
+
+    template <size_t Side>
+    UnitIndices(uint32_t mask, const std::array<uint32_t, Side> &flat) : mask(mask), flat(flat.data())
+    {
+    }
+
+    Iterator begin() const
+    {
+        return Iterator(mask, flat);
+    }
+
+    Iterator end() const
+    {
+        return Iterator(0, flat);
+    }
+};
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef SUDOFUN_JOURNAL_HEADER
+#define SUDOFUN_JOURNAL_HEADER
+
+#include <array>
+#include <stdexcept>
+#include <stdint.h>
+#include <type_traits>
+
+/**
+ * @brief An undo trail of writes to the puzzle data. While a puzzle has a journal attached, every write that
+ * changes a cell records the cell's previous value, so the puzzle can be rewound to an earlier position instead
+ * of being copied before each trial.
+ *
+ * Every solver write only ever removes bits from a cell, so a cell can be journaled at most once per digit between
+ * the outermost checkpoint and its rewind; the capacity below is therefore never exceeded.
+ *
+ * @tparam Cells The number of cells in the puzzle
+ * @tparam Digits The number of digits, i.e. the side of the puzzle
+ * @tparam Word The type holding a cell's candidates
+ */
+template <uint32_t Cells, uint32_t Digits, typename Word>
+class BasicJournal
+{
+private:
+    struct Entry
+    {
+        std::conditional_t<(Cells <= 256), uint8_t, uint16_t> flat_index;
+        Word value;
+    };
+
+    static constexpr uint32_t capacity = Cells * Digits;
+    std::array<Entry, capacity> entries;
+    uint32_t count;
+
+public:
+    BasicJournal() : count(0) {}
+
+    /**
+     * @brief Records the value a cell held before it is overwritten.
+     *
+     * @param flat_index
+     * @param old_value
+     */
+    void record(uint32_t flat_index, Word old_value)
+    {
+        if (count == capacity)
+        {
+            throw std::runtime_error("Journal overflow: puzzle writes must only remove bits");
+        }
+        entries[count++] = {static_cast<decltype(Entry::flat_index)>(flat_index), old_value};
+    }
+
+    /**
+     * @brief The current end of the journal, to be passed to rewind() later.
+     *
+     * @return uint32_t
+     */
+    uint32_t position() const
+    {
+        return count;
+    }
+
+    /**
+     * @brief Undo every write recorded after a given position, most recent first.
+     *
+     * @param position A value previously returned by position()
+     * @param data The puzzle data the journal was recording
+     */
+    void rewind(uint32_t position, Word *data)
+    {
+        while (count > position)
+        {
+            --count;
+            data[entries[count].flat_index] = entries[count].value;
+        }
+    }
+
+    void clear()
+    {
+        count = 0;
+    }
+};
+
+// The journal of a 9x9 puzzle
+using Journal = BasicJournal<81, 9, uint16_t>;
+
+#endif
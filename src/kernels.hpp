@@ -0,0 +1,451 @@
+#ifndef SUDOFUN_KERNELS_HEADER
+#define SUDOFUN_KERNELS_HEADER
+
+#include "maps.hpp"
+#include <algorithm>
+#include <array>
+#include <stdint.h>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define SUDOFUN_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+/**
+ * @brief Whole-puzzle reductions over the 81 nine bit values, with SSE4.2, AVX2, and AVX-512 versions chosen at
+ * startup according to what the CPU supports, and a scalar fallback.
+ *
+ * Every kernel reads a puzzle data array of PADDED_CELLS values whose entries past the 81st are zero, so that
+ * vector loads never run off the end of the puzzle. The exception is reading a puzzle's text, which touches exactly
+ * 81 characters and 81 values, overlapping its last load with the one before instead.
+ */
+namespace kernels
+{
+    constexpr uint32_t PADDED_CELLS = 96;
+
+    /**
+     * @brief Bits seen at least once and at least twice within each unit. Units 0-8 are the rows, 9-17 the
+     * columns, and 18-26 the blocks.
+     */
+    struct UnitMasks
+    {
+        std::array<uint16_t, 27> once;
+        std::array<uint16_t, 27> twice;
+    };
+
+    /**
+     * @brief The flat index of member k of unit u, laid out member-major with the units padded to 32 so a vector
+     * of units can be loaded per member. Padding units point at cell 81, which is always zero.
+     */
+    constexpr std::array<std::array<uint16_t, 32>, 9> makeUnitMembers()
+    {
+        std::array<std::array<uint16_t, 32>, 9> members{};
+        for (uint32_t k = 0; k < 9; ++k)
+        {
+            for (uint32_t u = 0; u < 32; ++u)
+            {
+                uint32_t flat = (u < 27) ? maps::UNIT_TO_FLAT[u][k] : 81;
+                members[k][u] = static_cast<uint16_t>(flat);
+            }
+        }
+        return members;
+    }
+
+    alignas(64) constexpr std::array<std::array<uint16_t, 32>, 9> UNIT_MEMBERS = makeUnitMembers();
+
+    /**
+     * @brief The set of kernels in use, along with the name of the instruction set they were built for.
+     */
+    struct KernelSet
+    {
+        const char *name;
+
+        // Accumulate the seen once/seen twice masks of all 27 units
+        void (*unitMasks)(const uint16_t *cells, UnitMasks *masks);
+
+        // Whether any of the 81 cells has no bits left
+        bool (*anyEmpty)(const uint16_t *cells);
+
+        // The cells holding exactly one bit, as an 81 bit set split over two words
+        void (*singletons)(const uint16_t *cells, uint64_t *words);
+
+        // Check that 81 characters are all digits or dots, and convert them to values 0-9 (0 for . and 0)
+        bool (*readCells)(const char *text, uint8_t *values);
+    };
+
+    //--------------------------------------------------------------------------------------------//
+    //--- Scalar fallback ------------------------------------------------------------------------//
+    //--------------------------------------------------------------------------------------------//
+
+    inline void unitMasksScalar(const uint16_t *cells, UnitMasks *masks)
+    {
+        for (uint32_t u = 0; u < 27; ++u)
+        {
+            uint16_t once = 0;
+            uint16_t twice = 0;
+            for (uint32_t k = 0; k < 9; ++k)
+            {
+                uint16_t val = cells[UNIT_MEMBERS[k][u]];
+                twice |= once & val;
+                once |= val;
+            }
+            masks->once[u] = once;
+            masks->twice[u] = twice;
+        }
+    }
+
+    inline bool anyEmptyScalar(const uint16_t *cells)
+    {
+        bool empty = false;
+        for (uint32_t i = 0; i < 81; ++i)
+        {
+            empty |= (cells[i] == 0);
+        }
+        return empty;
+    }
+
+    inline void singletonsScalar(const uint16_t *cells, uint64_t *words)
+    {
+        words[0] = 0;
+        words[1] = 0;
+        for (uint32_t i = 0; i < 81; ++i)
+        {
+            uint16_t val = cells[i];
+            uint64_t single = (val != 0) && ((val & (val - 1)) == 0);
+            words[i >> 6] |= single << (i & 63);
+        }
+    }
+
+    inline bool readCellsScalar(const char *text, uint8_t *values)
+    {
+        bool valid = true;
+        for (uint32_t i = 0; i < 81; ++i)
+        {
+            uint8_t digit = static_cast<uint8_t>(text[i] - '0');
+            bool is_digit = (digit <= 9);
+            valid &= is_digit || (text[i] == '.');
+            values[i] = is_digit ? digit : 0;
+        }
+        return valid;
+    }
+
+#if defined(SUDOFUN_X86_KERNELS)
+
+    //--------------------------------------------------------------------------------------------//
+    //--- SSE4.2 ---------------------------------------------------------------------------------//
+    //--------------------------------------------------------------------------------------------//
+
+    __attribute__((target("sse4.2"))) inline void unitMasksSse42(const uint16_t *cells, UnitMasks *masks)
+    {
+        alignas(16) std::array<uint16_t, 32> once;
+        alignas(16) std::array<uint16_t, 32> twice;
+
+        // SSE has no gather, so each vector of eight units is assembled lane by lane
+        for (uint32_t u = 0; u < 32; u += 8)
+        {
+            __m128i once_v = _mm_setzero_si128();
+            __m128i twice_v = _mm_setzero_si128();
+            for (uint32_t k = 0; k < 9; ++k)
+            {
+                const uint16_t *idx = &UNIT_MEMBERS[k][u];
+                __m128i val = _mm_setr_epi16(cells[idx[0]], cells[idx[1]], cells[idx[2]], cells[idx[3]],
+                                             cells[idx[4]], cells[idx[5]], cells[idx[6]], cells[idx[7]]);
+                twice_v = _mm_or_si128(twice_v, _mm_and_si128(once_v, val));
+                once_v = _mm_or_si128(once_v, val);
+            }
+            _mm_store_si128(reinterpret_cast<__m128i *>(&once[u]), once_v);
+            _mm_store_si128(reinterpret_cast<__m128i *>(&twice[u]), twice_v);
+        }
+
+        std::copy(once.begin(), once.begin() + 27, masks->once.begin());
+        std::copy(twice.begin(), twice.begin() + 27, masks->twice.begin());
+    }
+
+    __attribute__((target("sse4.2"))) inline bool anyEmptySse42(const uint16_t *cells)
+    {
+        // Cells 0-79 fill ten vectors exactly; the last cell is checked on its own
+        __m128i zero = _mm_setzero_si128();
+        __m128i empty = zero;
+        for (uint32_t i = 0; i < 80; i += 8)
+        {
+            __m128i val = _mm_loadu_si128(reinterpret_cast<const __m128i *>(cells + i));
+            empty = _mm_or_si128(empty, _mm_cmpeq_epi16(val, zero));
+        }
+        return !_mm_testz_si128(empty, empty) || (cells[80] == 0);
+    }
+
+    __attribute__((target("sse4.2"))) inline void singletonsSse42(const uint16_t *cells, uint64_t *words)
+    {
+        __m128i zero = _mm_setzero_si128();
+        __m128i one = _mm_set1_epi16(1);
+        uint64_t bits[2] = {0, 0};
+
+        // Sixteen cells per step: narrow two vectors of lane masks to bytes to get one bit per cell
+        for (uint32_t i = 0; i < PADDED_CELLS; i += 16)
+        {
+            __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(cells + i));
+            __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(cells + i + 8));
+            __m128i lo_single = _mm_andnot_si128(_mm_cmpeq_epi16(lo, zero),
+                                                 _mm_cmpeq_epi16(_mm_and_si128(lo, _mm_sub_epi16(lo, one)), zero));
+            __m128i hi_single = _mm_andnot_si128(_mm_cmpeq_epi16(hi, zero),
+                                                 _mm_cmpeq_epi16(_mm_and_si128(hi, _mm_sub_epi16(hi, one)), zero));
+            uint64_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_packs_epi16(lo_single, hi_single)));
+            bits[i >> 6] |= mask << (i & 63);
+        }
+
+        words[0] = bits[0];
+        words[1] = bits[1];
+    }
+
+    __attribute__((target("sse4.2"))) inline bool readCellsSse42(const char *text, uint8_t *values)
+    {
+        __m128i zero_char = _mm_set1_epi8('0');
+        __m128i nine = _mm_set1_epi8(9);
+        __m128i dot = _mm_set1_epi8('.');
+        uint32_t invalid = 0;
+
+        // Six vectors cover the 81 characters, the last overlapping the one before it
+        for (uint32_t i : {0, 16, 32, 48, 64, 65})
+        {
+            __m128i text_v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + i));
+            __m128i digit = _mm_sub_epi8(text_v, zero_char);
+            __m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(digit, nine), digit);
+            __m128i is_dot = _mm_cmpeq_epi8(text_v, dot);
+            invalid |= ~_mm_movemask_epi8(_mm_or_si128(is_digit, is_dot)) & 0xFFFF;
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(values + i), _mm_and_si128(digit, is_digit));
+        }
+        return invalid == 0;
+    }
+
+    //--------------------------------------------------------------------------------------------//
+    //--- AVX2 -----------------------------------------------------------------------------------//
+    //--------------------------------------------------------------------------------------------//
+
+    __attribute__((target("avx2"))) inline void unitMasksAvx2(const uint16_t *cells, UnitMasks *masks)
+    {
+        alignas(32) std::array<uint32_t, 32> once;
+        alignas(32) std::array<uint32_t, 32> twice;
+
+        // Gather 32 bit words at two byte strides; the low half of each is the cell we want, and the padding
+        // guarantees the high half never reads past the puzzle
+        const int *base = reinterpret_cast<const int *>(cells);
+        __m256i low_half = _mm256_set1_epi32(0xFFFF);
+        for (uint32_t u = 0; u < 32; u += 8)
+        {
+            __m256i once_v = _mm256_setzero_si256();
+            __m256i twice_v = _mm256_setzero_si256();
+            for (uint32_t k = 0; k < 9; ++k)
+            {
+                __m256i idx = _mm256_cvtepu16_epi32(
+                    _mm_load_si128(reinterpret_cast<const __m128i *>(&UNIT_MEMBERS[k][u])));
+                __m256i val = _mm256_and_si256(_mm256_i32gather_epi32(base, idx, 2), low_half);
+                twice_v = _mm256_or_si256(twice_v, _mm256_and_si256(once_v, val));
+                once_v = _mm256_or_si256(once_v, val);
+            }
+            _mm256_store_si256(reinterpret_cast<__m256i *>(&once[u]), once_v);
+            _mm256_store_si256(reinterpret_cast<__m256i *>(&twice[u]), twice_v);
+        }
+
+        for (uint32_t u = 0; u < 27; ++u)
+        {
+            masks->once[u] = static_cast<uint16_t>(once[u]);
+            masks->twice[u] = static_cast<uint16_t>(twice[u]);
+        }
+    }
+
+    __attribute__((target("avx2"))) inline bool anyEmptyAvx2(const uint16_t *cells)
+    {
+        // Cells 0-79 fill five vectors exactly; the last cell is checked on its own
+        __m256i zero = _mm256_setzero_si256();
+        __m256i empty = zero;
+        for (uint32_t i = 0; i < 80; i += 16)
+        {
+            __m256i val = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(cells + i));
+            empty = _mm256_or_si256(empty, _mm256_cmpeq_epi16(val, zero));
+        }
+        return !_mm256_testz_si256(empty, empty) || (cells[80] == 0);
+    }
+
+    __attribute__((target("avx2"))) inline void singletonsAvx2(const uint16_t *cells, uint64_t *words)
+    {
+        __m256i zero = _mm256_setzero_si256();
+        __m256i one = _mm256_set1_epi16(1);
+        uint64_t bits[2] = {0, 0};
+
+        // Thirty-two cells per step; packing interleaves the 128 bit lanes, so put them back in order before
+        // taking one bit per cell
+        for (uint32_t i = 0; i < PADDED_CELLS; i += 32)
+        {
+            __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(cells + i));
+            __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(cells + i + 16));
+            __m256i lo_single = _mm256_andnot_si256(
+                _mm256_cmpeq_epi16(lo, zero), _mm256_cmpeq_epi16(_mm256_and_si256(lo, _mm256_sub_epi16(lo, one)), zero));
+            __m256i hi_single = _mm256_andnot_si256(
+                _mm256_cmpeq_epi16(hi, zero), _mm256_cmpeq_epi16(_mm256_and_si256(hi, _mm256_sub_epi16(hi, one)), zero));
+            __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(lo_single, hi_single), 0xD8);
+            uint64_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(packed));
+            bits[i >> 6] |= mask << (i & 63);
+        }
+
+        words[0] = bits[0];
+        words[1] = bits[1];
+    }
+
+    __attribute__((target("avx2"))) inline bool readCellsAvx2(const char *text, uint8_t *values)
+    {
+        __m256i zero_char = _mm256_set1_epi8('0');
+        __m256i nine = _mm256_set1_epi8(9);
+        __m256i dot = _mm256_set1_epi8('.');
+        uint32_t invalid = 0;
+
+        // Three vectors cover the 81 characters, the last overlapping the one before it
+        for (uint32_t i : {0, 32, 49})
+        {
+            __m256i text_v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text + i));
+            __m256i digit = _mm256_sub_epi8(text_v, zero_char);
+            __m256i is_digit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, nine), digit);
+            __m256i is_dot = _mm256_cmpeq_epi8(text_v, dot);
+            invalid |= ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(is_digit, is_dot)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(values + i), _mm256_and_si256(digit, is_digit));
+        }
+        return invalid == 0;
+    }
+
+    //--------------------------------------------------------------------------------------------//
+    //--- AVX-512 --------------------------------------------------------------------------------//
+    //--------------------------------------------------------------------------------------------//
+
+    /**
+     * @brief For each member k, the units whose kth member lies in cells 64-95 rather than 0-63.
+     */
+    constexpr std::array<uint32_t, 9> makeHighMemberMasks()
+    {
+        std::array<uint32_t, 9> high{};
+        for (uint32_t k = 0; k < 9; ++k)
+        {
+            for (uint32_t u = 0; u < 32; ++u)
+            {
+                high[k] |= static_cast<uint32_t>(UNIT_MEMBERS[k][u] >= 64) << u;
+            }
+        }
+        return high;
+    }
+
+    constexpr std::array<uint32_t, 9> HIGH_MEMBER_MASKS = makeHighMemberMasks();
+
+    __attribute__((target("avx512f,avx512bw"))) inline void unitMasksAvx512(const uint16_t *cells, UnitMasks *masks)
+    {
+        alignas(64) std::array<uint16_t, 32> once;
+        alignas(64) std::array<uint16_t, 32> twice;
+
+        // The whole padded puzzle fits in three registers, and all 27 units fit in one
+        __m512i cells_0 = _mm512_loadu_si512(cells);
+        __m512i cells_1 = _mm512_loadu_si512(cells + 32);
+        __m512i cells_2 = _mm512_loadu_si512(cells + 64);
+
+        __m512i once_v = _mm512_setzero_si512();
+        __m512i twice_v = _mm512_setzero_si512();
+        for (uint32_t k = 0; k < 9; ++k)
+        {
+            // Permute members out of cells 0-63 and cells 64-95, then pick per unit whichever holds the member
+            __m512i idx = _mm512_load_si512(&UNIT_MEMBERS[k]);
+            __m512i low = _mm512_permutex2var_epi16(cells_0, idx, cells_1);
+            __m512i high = _mm512_permutexvar_epi16(idx, cells_2);
+            __m512i val = _mm512_mask_blend_epi16(HIGH_MEMBER_MASKS[k], low, high);
+            twice_v = _mm512_or_si512(twice_v, _mm512_and_si512(once_v, val));
+            once_v = _mm512_or_si512(once_v, val);
+        }
+        _mm512_store_si512(once.data(), once_v);
+        _mm512_store_si512(twice.data(), twice_v);
+
+        std::copy(once.begin(), once.begin() + 27, masks->once.begin());
+        std::copy(twice.begin(), twice.begin() + 27, masks->twice.begin());
+    }
+
+    __attribute__((target("avx512f,avx512bw"))) inline bool anyEmptyAvx512(const uint16_t *cells)
+    {
+        __m512i zero = _mm512_setzero_si512();
+        uint32_t empty_0 = _mm512_cmpeq_epi16_mask(_mm512_loadu_si512(cells), zero);
+        uint32_t empty_1 = _mm512_cmpeq_epi16_mask(_mm512_loadu_si512(cells + 32), zero);
+        uint32_t empty_2 = _mm512_cmpeq_epi16_mask(_mm512_loadu_si512(cells + 64), zero);
+
+        // Only cells 64-80 of the last register are part of the puzzle
+        return (empty_0 | empty_1 | (empty_2 & 0x1FFFF)) != 0;
+    }
+
+    __attribute__((target("avx512f,avx512bw"))) inline void singletonsAvx512(const uint16_t *cells, uint64_t *words)
+    {
+        __m512i zero = _mm512_setzero_si512();
+        __m512i one = _mm512_set1_epi16(1);
+        uint64_t masks[3];
+        for (uint32_t n = 0; n < 3; ++n)
+        {
+            __m512i val = _mm512_loadu_si512(cells + 32 * n);
+            masks[n] = _mm512_cmpneq_epi16_mask(val, zero) &
+                       _mm512_cmpeq_epi16_mask(_mm512_and_si512(val, _mm512_sub_epi16(val, one)), zero);
+        }
+
+        words[0] = masks[0] | (masks[1] << 32);
+        words[1] = masks[2];
+    }
+
+    __attribute__((target("avx512f,avx512bw"))) inline bool readCellsAvx512(const char *text, uint8_t *values)
+    {
+        __m512i zero_char = _mm512_set1_epi8('0');
+        __m512i nine = _mm512_set1_epi8(9);
+        __m512i dot = _mm512_set1_epi8('.');
+        uint64_t invalid = 0;
+
+        // Two vectors cover the 81 characters, the second overlapping the first
+        for (uint32_t i : {0, 17})
+        {
+            __m512i text_v = _mm512_loadu_si512(text + i);
+            __m512i digit = _mm512_sub_epi8(text_v, zero_char);
+            uint64_t is_digit = _mm512_cmple_epu8_mask(digit, nine);
+            uint64_t is_dot = _mm512_cmpeq_epi8_mask(text_v, dot);
+            invalid |= ~(is_digit | is_dot);
+            _mm512_storeu_si512(values + i, _mm512_maskz_mov_epi8(is_digit, digit));
+        }
+        return invalid == 0;
+    }
+
+#endif
+
+    //--------------------------------------------------------------------------------------------//
+    //--- Dispatch -------------------------------------------------------------------------------//
+    //--------------------------------------------------------------------------------------------//
+
+    inline KernelSet detectKernels()
+    {
+#if defined(SUDOFUN_X86_KERNELS)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512bw"))
+        {
+            return {"AVX-512", unitMasksAvx512, anyEmptyAvx512, singletonsAvx512, readCellsAvx512};
+        }
+        if (__builtin_cpu_supports("avx2"))
+        {
+            return {"AVX2", unitMasksAvx2, anyEmptyAvx2, singletonsAvx2, readCellsAvx2};
+        }
+        if (__builtin_cpu_supports("sse4.2"))
+        {
+            return {"SSE4.2", unitMasksSse42, anyEmptySse42, singletonsSse42, readCellsSse42};
+        }
+#endif
+        return {"scalar", unitMasksScalar, anyEmptyScalar, singletonsScalar, readCellsScalar};
+    }
+
+    /**
+     * @brief The kernels for this machine, detected on first use.
+     *
+     * @return const KernelSet&
+     */
+    inline const KernelSet &active()
+    {
+        static const KernelSet kernel_set = detectKernels();
+        return kernel_set;
+    }
+
+} // kernels
+
+#endif
@@ -6,8 +6,16 @@ int main(int argc, char *argv[])
 {
 
     bool runConsole{false};
-    int maxGuesses{1};
+    uint32_t maxGuesses{Solver::UNLIMITED_GUESSES};
     bool nineBit{false};
+    bool runBatch{false};
+    std::string inputPath;
+    std::string resultsPath;
+    size_t cacheCapacity{0};
+    bool canonicalKeys{false};
+    std::string storePath;
+    Solver::Pipeline pipeline{Solver::Pipeline::STANDARD};
+    uint32_t side{9};
 
     for (int i = 1; i < argc; ++i)
     {
@@ -19,12 +27,52 @@ int main(int argc, char *argv[])
         }
         else if (arg == "--max-guesses" && i + 1 < argc)
         {
-            maxGuesses = std::stoi(argv[++i]); // parse next argument as int
+            maxGuesses = static_cast<uint32_t>(std::stoul(argv[++i])); // parse next argument as unsigned int
         }
         else if (arg == "--nine-bit")
         {
             nineBit = true;
         }
+        else if (arg == "--batch")
+        {
+            runBatch = true;
+        }
+        else if (arg == "--input" && i + 1 < argc)
+        {
+            inputPath = argv[++i];
+        }
+        else if (arg == "--results" && i + 1 < argc)
+        {
+            resultsPath = argv[++i];
+        }
+        else if (arg == "--cache" && i + 1 < argc)
+        {
+            cacheCapacity = static_cast<size_t>(std::stoull(argv[++i]));
+        }
+        else if (arg == "--cache-canonical")
+        {
+            canonicalKeys = true;
+        }
+        else if (arg == "--store" && i + 1 < argc)
+        {
+            storePath = argv[++i];
+        }
+        else if (arg == "--size" && i + 1 < argc)
+        {
+            side = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--pipeline" && i + 1 < argc)
+        {
+            try
+            {
+                pipeline = Solver::parsePipeline(argv[++i]);
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << e.what() << "\n";
+                return 1;
+            }
+        }
         else
         {
             std::cerr << "Unknown or incomplete argument: " << arg << "\n";
@@ -34,15 +82,44 @@ int main(int argc, char *argv[])
 
     // Parse input
 
+    if (canonicalKeys && ((cacheCapacity == 0) || (side != 9)))
+    {
+        std::cerr << "--cache-canonical needs --cache, and only applies to 9x9 puzzles\n";
+        return 1;
+    }
+
+    if (runBatch)
+    {
+        try
+        {
+            return withBoxSizeOf(side, [&](auto box)
+                                 { return runBatchSolve<decltype(box)::value>(maxGuesses, inputPath, pipeline,
+                                                                                     resultsPath, cacheCapacity,
+                                                                                     canonicalKeys, storePath); });
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Exception caught: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    // Only batch solving handles puzzles other than 9x9
+    if (side != 9)
+    {
+        std::cerr << "--size only applies to --batch\n";
+        return 1;
+    }
+
 #ifndef BUILT_WITH_QT5
 
-    runConsoleSolve(maxGuesses, nineBit);
+    runConsoleSolve(maxGuesses, nineBit, pipeline);
 
 #else
 
     if (runConsole)
     {
-        runConsoleSolve(maxGuesses, nineBit);
+        runConsoleSolve(maxGuesses, nineBit, pipeline);
     }
 
     else
@@ -1,116 +1,352 @@
-
 #ifndef SUDOFUN_MAPPINGS_HEADER
 #define SUDOFUN_MAPPINGS_HEADER
 
+#include "indices.hpp"
 #include <array>
 #include <stdint.h>
-#include <vector>
+#include <type_traits>
 
 namespace maps
 {
-
-    const std::array<std::vector<uint32_t>, 9> INIT_ROW_GROUPS = {{
-        {0, 1, 2, 3, 4, 5, 6, 7, 8},
-        {9, 10, 11, 12, 13, 14, 15, 16, 17},
-        {18, 19, 20, 21, 22, 23, 24, 25, 26},
-        {27, 28, 29, 30, 31, 32, 33, 34, 35},
-        {36, 37, 38, 39, 40, 41, 42, 43, 44},
-        {45, 46, 47, 48, 49, 50, 51, 52, 53},
-        {54, 55, 56, 57, 58, 59, 60, 61, 62},
-        {63, 64, 65, 66, 67, 68, 69, 70, 71},
-        {72, 73, 74, 75, 76, 77, 78, 79, 80},
-    }};
-    const std::array<std::vector<uint32_t>, 9> INIT_COL_GROUPS = {{
-        {0, 9, 18, 27, 36, 45, 54, 63, 72},
-        {1, 10, 19, 28, 37, 46, 55, 64, 73},
-        {2, 11, 20, 29, 38, 47, 56, 65, 74},
-        {3, 12, 21, 30, 39, 48, 57, 66, 75},
-        {4, 13, 22, 31, 40, 49, 58, 67, 76},
-        {5, 14, 23, 32, 41, 50, 59, 68, 77},
-        {6, 15, 24, 33, 42, 51, 60, 69, 78},
-        {7, 16, 25, 34, 43, 52, 61, 70, 79},
-        {8, 17, 26, 35, 44, 53, 62, 71, 80},
-    }};
-    const std::array<std::vector<uint32_t>, 9> INIT_BLK_GROUPS = {{
-        {0, 1, 2, 9, 10, 11, 18, 19, 20},
-        {3, 4, 5, 12, 13, 14, 21, 22, 23},
-        {6, 7, 8, 15, 16, 17, 24, 25, 26},
-        {27, 28, 29, 36, 37, 38, 45, 46, 47},
-        {30, 31, 32, 39, 40, 41, 48, 49, 50},
-        {33, 34, 35, 42, 43, 44, 51, 52, 53},
-        {54, 55, 56, 63, 64, 65, 72, 73, 74},
-        {57, 58, 59, 66, 67, 68, 75, 76, 77},
-        {60, 61, 62, 69, 70, 71, 78, 79, 80},
-    }};
-    const std::vector<uint32_t> INIT_UNSOLVED_INDICES = {
-        0, 1, 2, 3, 4, 5, 6, 7, 8,
-        9, 10, 11, 12, 13, 14, 15, 16, 17,
-        18, 19, 20, 21, 22, 23, 24, 25, 26,
-        27, 28, 29, 30, 31, 32, 33, 34, 35,
-        36, 37, 38, 39, 40, 41, 42, 43, 44,
-        45, 46, 47, 48, 49, 50, 51, 52, 53,
-        54, 55, 56, 57, 58, 59, 60, 61, 62,
-        63, 64, 65, 66, 67, 68, 69, 70, 71,
-        72, 73, 74, 75, 76, 77, 78, 79, 80};
-
+    /**
+     * @brief Convert flat indices to row, col, and blk indices, and to the position within the blk, for a puzzle
+     * made of BoxSize x BoxSize blocks. Blocks are numbered left to right and then top to bottom, as are the
+     * members of each block, such that BLK_TO_FLAT[flatToBlk(k)][flatToBlkPos(k)] == k.
+     */
+    template <uint32_t BoxSize>
+    constexpr uint32_t flatToRowOf(uint32_t flat_index)
+    {
+        return flat_index / (BoxSize * BoxSize);
+    }
+    template <uint32_t BoxSize>
+    constexpr uint32_t flatToColOf(uint32_t flat_index)
+    {
+        return flat_index % (BoxSize * BoxSize);
+    }
+    template <uint32_t BoxSize>
+    constexpr uint32_t flatToBlkOf(uint32_t flat_index)
+    {
+        return BoxSize * (flatToRowOf<BoxSize>(flat_index) / BoxSize) + flatToColOf<BoxSize>(flat_index) / BoxSize;
+    }
+    template <uint32_t BoxSize>
+    constexpr uint32_t flatToBlkPosOf(uint32_t flat_index)
+    {
+        return BoxSize * (flatToRowOf<BoxSize>(flat_index) % BoxSize) + flatToColOf<BoxSize>(flat_index) % BoxSize;
+    }
 
     /**
-     * @brief Conver flat indices to blk indices
+     * @brief Where a row or column passes through a block: the cells they share, and the rest of each of the two
+     * units.
      */
-    constexpr std::array<uint32_t, 81> FLAT_TO_BLK = {
-        0, 0, 0, 1, 1, 1, 2, 2, 2, \
-        0, 0, 0, 1, 1, 1, 2, 2, 2, \
-        0, 0, 0, 1, 1, 1, 2, 2, 2, \
-        3, 3, 3, 4, 4, 4, 5, 5, 5, \
-        3, 3, 3, 4, 4, 4, 5, 5, 5, \
-        3, 3, 3, 4, 4, 4, 5, 5, 5, \
-        6, 6, 6, 7, 7, 7, 8, 8, 8, \
-        6, 6, 6, 7, 7, 7, 8, 8, 8, \
-        6, 6, 6, 7, 7, 7, 8, 8, 8, \
+    template <uint32_t BoxSize>
+    struct BasicIntersection
+    {
+        // The row or column, as a unit index (rows first, then columns), and the block
+        uint32_t line;
+        uint32_t blk;
+        std::array<uint32_t, BoxSize> cells;
+        BasicIndexSet<BoxSize * BoxSize * BoxSize * BoxSize> shared;
+        BasicIndexSet<BoxSize * BoxSize * BoxSize * BoxSize> line_rest;
+        BasicIndexSet<BoxSize * BoxSize * BoxSize * BoxSize> blk_rest;
     };
 
     /**
-     * @brief Convert row/col/blk indices to flat puzzle indices
-     *
-     *  ith row contains the ROW_TO_FLAT[i] puzzle indices
+     * @brief Every mapping between flat indices and the units of a puzzle made of BoxSize x BoxSize blocks, built
+     * at compile time. A puzzle has a side of BoxSize^2, and each of its cells takes one of that many digits.
      *
+     * Units are numbered with the rows first, then the cols, then the blocks, so for a 9x9 puzzle the rows are
+     * units 0-8, the cols 9-17, and the blocks 18-26.
      */
-    constexpr std::array<std::array<uint32_t, 9>, 9> ROW_TO_FLAT = {{
-        {0, 1, 2, 3, 4, 5, 6, 7, 8},
-        {9, 10, 11, 12, 13, 14, 15, 16, 17},
-        {18, 19, 20, 21, 22, 23, 24, 25, 26},
-        {27, 28, 29, 30, 31, 32, 33, 34, 35},
-        {36, 37, 38, 39, 40, 41, 42, 43, 44},
-        {45, 46, 47, 48, 49, 50, 51, 52, 53},
-        {54, 55, 56, 57, 58, 59, 60, 61, 62},
-        {63, 64, 65, 66, 67, 68, 69, 70, 71},
-        {72, 73, 74, 75, 76, 77, 78, 79, 80},
-    }};
-    constexpr std::array<std::array<uint32_t, 9>, 9> COL_TO_FLAT = {{
-        {0, 9, 18, 27, 36, 45, 54, 63, 72},
-        {1, 10, 19, 28, 37, 46, 55, 64, 73},
-        {2, 11, 20, 29, 38, 47, 56, 65, 74},
-        {3, 12, 21, 30, 39, 48, 57, 66, 75},
-        {4, 13, 22, 31, 40, 49, 58, 67, 76},
-        {5, 14, 23, 32, 41, 50, 59, 68, 77},
-        {6, 15, 24, 33, 42, 51, 60, 69, 78},
-        {7, 16, 25, 34, 43, 52, 61, 70, 79},
-        {8, 17, 26, 35, 44, 53, 62, 71, 80},
-    }};
-
-    inline uint32_t flatToRow(uint32_t flat_index)
+    template <uint32_t BoxSize>
+    struct Topology
+    {
+        static constexpr uint32_t BOX = BoxSize;
+        static constexpr uint32_t SIDE = BoxSize * BoxSize;
+        static constexpr uint32_t CELLS = SIDE * SIDE;
+        static constexpr uint32_t UNITS = 3 * SIDE;
+
+        // The other members of a cell's row and col, plus those of its block in neither
+        static constexpr uint32_t PEER_COUNT = 2 * (SIDE - 1) + (BoxSize - 1) * (BoxSize - 1);
+
+        // Every block meets BoxSize rows and BoxSize cols
+        static constexpr uint32_t INTERSECTION_COUNT = 2 * SIDE * BoxSize;
+
+        static_assert((BoxSize >= 2) && (BoxSize <= 5), "Only boxes of 2x2 to 5x5 are supported");
+
+        // The candidates of a cell, one bit per digit, and likewise a mask of the members of a unit
+        using Word = std::conditional_t<(SIDE <= 16), uint16_t, uint32_t>;
+        static constexpr Word ALL_BITS = static_cast<Word>((static_cast<uint64_t>(1) << SIDE) - 1);
+
+        using CellSet = BasicIndexSet<CELLS>;
+        using UnitSet = BasicIndexSet<UNITS>;
+        using Intersection = BasicIntersection<BoxSize>;
+
+        static constexpr uint32_t flatToRow(uint32_t flat_index)
+        {
+            return flatToRowOf<BoxSize>(flat_index);
+        }
+        static constexpr uint32_t flatToCol(uint32_t flat_index)
+        {
+            return flatToColOf<BoxSize>(flat_index);
+        }
+        static constexpr uint32_t flatToBlk(uint32_t flat_index)
+        {
+            return flatToBlkOf<BoxSize>(flat_index);
+        }
+        static constexpr uint32_t flatToBlkPos(uint32_t flat_index)
+        {
+            return flatToBlkPosOf<BoxSize>(flat_index);
+        }
+
+        /**
+         * @brief Counts the candidates in a word. The 9 bit words of the standard puzzle keep the branch-free
+         * count they have always used.
+         *
+         * @param word
+         * @return uint32_t
+         */
+        static uint32_t countBits(Word word)
+        {
+            if constexpr (SIDE <= 9)
+            {
+                return utils::countBits(word);
+            }
+            else
+            {
+                return utils::countBits64(word);
+            }
+        }
+
+        /**
+         * @brief Flat indices of the members of each row, col, and blk. The ith row contains the ROW_TO_FLAT[i]
+         * puzzle indices.
+         */
+        static constexpr std::array<std::array<uint32_t, SIDE>, SIDE> ROW_TO_FLAT = []()
+        {
+            std::array<std::array<uint32_t, SIDE>, SIDE> rows{};
+            for (uint32_t k = 0; k < CELLS; ++k)
+            {
+                rows[flatToRowOf<BoxSize>(k)][flatToColOf<BoxSize>(k)] = k;
+            }
+            return rows;
+        }();
+        static constexpr std::array<std::array<uint32_t, SIDE>, SIDE> COL_TO_FLAT = []()
+        {
+            std::array<std::array<uint32_t, SIDE>, SIDE> cols{};
+            for (uint32_t k = 0; k < CELLS; ++k)
+            {
+                cols[flatToColOf<BoxSize>(k)][flatToRowOf<BoxSize>(k)] = k;
+            }
+            return cols;
+        }();
+        static constexpr std::array<std::array<uint32_t, SIDE>, SIDE> BLK_TO_FLAT = []()
+        {
+            std::array<std::array<uint32_t, SIDE>, SIDE> blks{};
+            for (uint32_t k = 0; k < CELLS; ++k)
+            {
+                blks[flatToBlkOf<BoxSize>(k)][flatToBlkPosOf<BoxSize>(k)] = k;
+            }
+            return blks;
+        }();
+
+        /**
+         * @brief The blk index of every flat index
+         */
+        static constexpr std::array<uint32_t, CELLS> FLAT_TO_BLK = []()
+        {
+            std::array<uint32_t, CELLS> blks{};
+            for (uint32_t k = 0; k < CELLS; ++k)
+            {
+                blks[k] = flatToBlkOf<BoxSize>(k);
+            }
+            return blks;
+        }();
+
+        /**
+         * @brief The flat indices of the members of every unit
+         */
+        static constexpr std::array<std::array<uint32_t, SIDE>, UNITS> UNIT_TO_FLAT = []()
+        {
+            std::array<std::array<uint32_t, SIDE>, UNITS> units{};
+            for (uint32_t i = 0; i < SIDE; ++i)
+            {
+                units[i] = ROW_TO_FLAT[i];
+                units[SIDE + i] = COL_TO_FLAT[i];
+                units[2 * SIDE + i] = BLK_TO_FLAT[i];
+            }
+            return units;
+        }();
+
+        /**
+         * @brief The three units containing each flat index
+         */
+        static constexpr std::array<UnitSet, CELLS> FLAT_TO_UNITS = []()
+        {
+            std::array<UnitSet, CELLS> units{};
+            for (uint32_t k = 0; k < CELLS; ++k)
+            {
+                units[k].insert(flatToRowOf<BoxSize>(k));
+                units[k].insert(SIDE + flatToColOf<BoxSize>(k));
+                units[k].insert(2 * SIDE + flatToBlkOf<BoxSize>(k));
+            }
+            return units;
+        }();
+
+        static constexpr UnitSet ALL_UNITS = UnitSet::full();
+
+        /**
+         * @brief The members of every unit as an index set
+         */
+        static constexpr std::array<CellSet, UNITS> UNIT_INDEX_SETS = []()
+        {
+            std::array<CellSet, UNITS> sets{};
+            for (uint32_t u = 0; u < UNITS; ++u)
+            {
+                for (const uint32_t flat_index : UNIT_TO_FLAT[u])
+                {
+                    sets[u].insert(flat_index);
+                }
+            }
+            return sets;
+        }();
+
+        /**
+         * @brief The peers of every flat index: the other members of its row, col, and blk, in ascending order
+         */
+        static constexpr std::array<std::array<uint32_t, PEER_COUNT>, CELLS> PEERS = []()
+        {
+            std::array<std::array<uint32_t, PEER_COUNT>, CELLS> peers{};
+            for (uint32_t k = 0; k < CELLS; ++k)
+            {
+                uint32_t row = flatToRowOf<BoxSize>(k);
+                uint32_t col = flatToColOf<BoxSize>(k);
+                uint32_t first_blk_col = col - col % BoxSize;
+
+                // Row by row, so the peers come out in ascending order: the whole row itself, the block's cols in
+                // the other rows of the block, and the cell's own col everywhere else
+                uint32_t count = 0;
+                for (uint32_t r = 0; r < SIDE; ++r)
+                {
+                    if (r == row)
+                    {
+                        for (uint32_t c = 0; c < SIDE; ++c)
+                        {
+                            if (c != col)
+                            {
+                                peers[k][count++] = ROW_TO_FLAT[r][c];
+                            }
+                        }
+                    }
+                    else if (r / BoxSize == row / BoxSize)
+                    {
+                        for (uint32_t c = first_blk_col; c < first_blk_col + BoxSize; ++c)
+                        {
+                            peers[k][count++] = ROW_TO_FLAT[r][c];
+                        }
+                    }
+                    else
+                    {
+                        peers[k][count++] = ROW_TO_FLAT[r][col];
+                    }
+                }
+            }
+            return peers;
+        }();
+
+        /**
+         * @brief The peers of every flat index as an index set
+         */
+        static constexpr std::array<CellSet, CELLS> PEER_INDEX_SETS = []()
+        {
+            std::array<CellSet, CELLS> sets{};
+            for (uint32_t k = 0; k < CELLS; ++k)
+            {
+                for (const uint32_t peer : PEERS[k])
+                {
+                    sets[k].insert(peer);
+                }
+            }
+            return sets;
+        }();
+
+        /**
+         * @brief All of the box/line intersections. The nth block a row or col passes through (counting along it)
+         * is at BOX * line + n, so the rows' intersections come first and then the cols'.
+         */
+        static constexpr std::array<Intersection, INTERSECTION_COUNT> INTERSECTIONS = []()
+        {
+            std::array<Intersection, INTERSECTION_COUNT> intersections{};
+            for (uint32_t line = 0; line < 2 * SIDE; ++line)
+            {
+                for (uint32_t n = 0; n < BoxSize; ++n)
+                {
+                    uint32_t blk = (line < SIDE) ? BoxSize * (line / BoxSize) + n : (line - SIDE) / BoxSize + BoxSize * n;
+                    Intersection &x = intersections[BoxSize * line + n];
+                    x.line = line;
+                    x.blk = blk;
+
+                    uint32_t count = 0;
+                    for (const uint32_t flat_index : UNIT_TO_FLAT[line])
+                    {
+                        if (flatToBlkOf<BoxSize>(flat_index) == blk)
+                        {
+                            x.cells[count++] = flat_index;
+                            x.shared.insert(flat_index);
+                        }
+                    }
+                    x.line_rest = UNIT_INDEX_SETS[line].without(x.shared);
+                    x.blk_rest = UNIT_INDEX_SETS[2 * SIDE + blk].without(x.shared);
+                }
+            }
+            return intersections;
+        }();
+
+        /**
+         * @brief For every block, its intersections (its rows and then its cols, top to bottom and left to
+         * right) as indices into INTERSECTIONS
+         */
+        static constexpr std::array<std::array<uint32_t, 2 * BoxSize>, SIDE> BLK_INTERSECTIONS = []()
+        {
+            std::array<std::array<uint32_t, 2 * BoxSize>, SIDE> blk_intersections{};
+            std::array<uint32_t, SIDE> count{};
+            for (uint32_t x = 0; x < INTERSECTION_COUNT; ++x)
+            {
+                uint32_t blk = INTERSECTIONS[x].blk;
+                blk_intersections[blk][count[blk]++] = x;
+            }
+            return blk_intersections;
+        }();
+    };
+
+    //--------------------------------------------------------------------------------------------//
+    //--- The standard 9x9 puzzle ----------------------------------------------------------------//
+    //--------------------------------------------------------------------------------------------//
+
+    using StandardTopology = Topology<3>;
+
+    constexpr const auto &FLAT_TO_BLK = StandardTopology::FLAT_TO_BLK;
+    constexpr const auto &ROW_TO_FLAT = StandardTopology::ROW_TO_FLAT;
+    constexpr const auto &COL_TO_FLAT = StandardTopology::COL_TO_FLAT;
+    constexpr const auto &BLK_TO_FLAT = StandardTopology::BLK_TO_FLAT;
+    constexpr const auto &UNIT_TO_FLAT = StandardTopology::UNIT_TO_FLAT;
+
+    constexpr uint32_t flatToRow(uint32_t flat_index)
+    {
+        return StandardTopology::flatToRow(flat_index);
+    }
+    constexpr uint32_t flatToCol(uint32_t flat_index)
     {
-        return flat_index / 9;
+        return StandardTopology::flatToCol(flat_index);
     }
-    inline uint32_t flatToCol(uint32_t flat_index)
+    constexpr uint32_t flatToBlk(uint32_t flat_index)
     {
-        return flat_index % 9;
+        return StandardTopology::flatToBlk(flat_index);
     }
-    inline uint32_t flatToBlk(uint32_t flat_index)
+    constexpr uint32_t flatToBlkPos(uint32_t flat_index)
     {
-        return FLAT_TO_BLK[flat_index];
+        return StandardTopology::flatToBlkPos(flat_index);
     }
 
 } // maps
 
-#endif
\ No newline at end of file
+#endif
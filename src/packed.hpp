@@ -0,0 +1,376 @@
+#ifndef SUDOFUN_PACKED_HEADER
+#define SUDOFUN_PACKED_HEADER
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Binary files of puzzles and of results, in fixed width records so that any record can be found without
+ * reading the ones before it. A file is a 32 byte header followed by its records:
+ *
+ *     bytes  0-3   magic: SFPZ for puzzles, SFRS for results
+ *     bytes  4-5   format version
+ *     bytes  6-7   side of the puzzles (4, 9, 16, or 25)
+ *     bytes  8-11  bytes per record
+ *     bytes 12-15  zero
+ *     bytes 16-23  number of records
+ *     bytes 24-31  FNV-1a checksum of the records
+ *
+ * with every number little endian. A puzzle record packs each element's value (0 for a blank) into the fewest bits
+ * that hold the side, from the lowest bit of the first byte up: 4 bits for a 9x9 puzzle, so 41 bytes in all. A
+ * result record is the packed solution (or blanks, where there is none), a byte of flags, the number of guesses as
+ * 4 bytes, and the time taken in nanoseconds as 8 bytes.
+ */
+namespace packed
+{
+    constexpr size_t HEADER_SIZE = 32;
+    constexpr uint16_t VERSION = 1;
+    constexpr char PUZZLE_MAGIC[4] = {'S', 'F', 'P', 'Z'};
+    constexpr char RESULT_MAGIC[4] = {'S', 'F', 'R', 'S'};
+
+    // Set in the flags of a result whose puzzle was solved
+    constexpr uint8_t SOLVED_FLAG = 1;
+
+    constexpr uint64_t CHECKSUM_SEED = 0xcbf29ce484222325ull;
+    constexpr uint64_t CHECKSUM_PRIME = 0x100000001b3ull;
+
+    struct Header
+    {
+        const char *magic;
+        uint32_t side;
+        uint32_t record_size;
+        uint64_t count;
+        uint64_t checksum;
+    };
+
+    struct Result
+    {
+        bool solved;
+        uint32_t guesses;
+        uint64_t time_ns;
+    };
+
+    template <typename T>
+    void storeLittle(T value, uint8_t *out)
+    {
+        for (size_t n = 0; n < sizeof(T); ++n)
+        {
+            out[n] = static_cast<uint8_t>(value >> (8 * n));
+        }
+    }
+
+    template <typename T>
+    T loadLittle(const uint8_t *in)
+    {
+        T value = 0;
+        for (size_t n = 0; n < sizeof(T); ++n)
+        {
+            value |= static_cast<T>(in[n]) << (8 * n);
+        }
+        return value;
+    }
+
+    /**
+     * @brief Continues an FNV-1a checksum over some more bytes.
+     *
+     * @param data
+     * @param size
+     * @param hash The checksum of the bytes so far
+     * @return uint64_t
+     */
+    inline uint64_t checksum(const uint8_t *data, size_t size, uint64_t hash = CHECKSUM_SEED)
+    {
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash = (hash ^ data[i]) * CHECKSUM_PRIME;
+        }
+        return hash;
+    }
+
+    inline void writeHeader(const Header &header, uint8_t *out)
+    {
+        std::memcpy(out, header.magic, 4);
+        storeLittle<uint16_t>(VERSION, out + 4);
+        storeLittle<uint16_t>(static_cast<uint16_t>(header.side), out + 6);
+        storeLittle<uint32_t>(header.record_size, out + 8);
+        storeLittle<uint32_t>(0, out + 12);
+        storeLittle<uint64_t>(header.count, out + 16);
+        storeLittle<uint64_t>(header.checksum, out + 24);
+    }
+
+    /**
+     * @brief Reads the header of a file's contents and checks the records against it, throwing if the file has the
+     * given magic but is not a whole, intact file of its kind.
+     *
+     * @param contents
+     * @param size
+     * @param magic PUZZLE_MAGIC or RESULT_MAGIC
+     * @param header Set to the header read
+     * @return false if the contents are not a file of this kind at all
+     */
+    inline bool readHeader(const char *contents, size_t size, const char *magic, Header *header)
+    {
+        if ((size < HEADER_SIZE) || (std::memcmp(contents, magic, 4) != 0))
+        {
+            return false;
+        }
+
+        const uint8_t *bytes = reinterpret_cast<const uint8_t *>(contents);
+        if (loadLittle<uint16_t>(bytes + 4) != VERSION)
+        {
+            throw std::runtime_error("Packed file is of an unsupported version");
+        }
+        header->magic = magic;
+        header->side = loadLittle<uint16_t>(bytes + 6);
+        header->record_size = loadLittle<uint32_t>(bytes + 8);
+        header->count = loadLittle<uint64_t>(bytes + 16);
+        header->checksum = loadLittle<uint64_t>(bytes + 24);
+
+        if ((header->record_size == 0) || ((size - HEADER_SIZE) / header->record_size != header->count) ||
+            ((size - HEADER_SIZE) % header->record_size != 0))
+        {
+            throw std::runtime_error("Packed file is truncated or has trailing bytes");
+        }
+        if (checksum(bytes + HEADER_SIZE, size - HEADER_SIZE) != header->checksum)
+        {
+            throw std::runtime_error("Packed file fails its checksum");
+        }
+        return true;
+    }
+
+    /**
+     * @brief The record layouts for puzzles of one size.
+     *
+     * @tparam BoxSize
+     */
+    template <uint32_t BoxSize>
+    struct Layout
+    {
+        static constexpr uint32_t SIDE = BoxSize * BoxSize;
+        static constexpr uint32_t CELLS = SIDE * SIDE;
+
+        // The fewest bits that hold every value from 0 to SIDE
+        static constexpr uint32_t CELL_BITS = (SIDE < 4) ? 2 : (SIDE < 8) ? 3 : (SIDE < 16) ? 4 : (SIDE < 32) ? 5 : 6;
+        static constexpr uint32_t CELL_MASK = (1 << CELL_BITS) - 1;
+
+        static constexpr uint32_t PUZZLE_RECORD_SIZE = (CELLS * CELL_BITS + 7) / 8;
+        static constexpr uint32_t RESULT_RECORD_SIZE = PUZZLE_RECORD_SIZE + 1 + 4 + 8;
+
+        /**
+         * @brief Packs one value per element into a puzzle record.
+         *
+         * @param values The CELLS values, each from 0 to SIDE
+         * @param record Space for PUZZLE_RECORD_SIZE bytes
+         */
+        static void packValues(const uint8_t *values, uint8_t *record)
+        {
+            if constexpr (CELL_BITS == 4)
+            {
+                // Two elements to a byte, which the compiler can vectorize
+                for (uint32_t i = 0; i < CELLS / 2; ++i)
+                {
+                    record[i] = static_cast<uint8_t>(values[2 * i] | (values[2 * i + 1] << 4));
+                }
+                if (CELLS % 2 != 0)
+                {
+                    record[CELLS / 2] = values[CELLS - 1];
+                }
+                return;
+            }
+
+            uint32_t bits = 0;
+            uint32_t pending = 0;
+            for (uint32_t i = 0; i < CELLS; ++i)
+            {
+                bits |= static_cast<uint32_t>(values[i]) << pending;
+                pending += CELL_BITS;
+                while (pending >= 8)
+                {
+                    *record++ = static_cast<uint8_t>(bits);
+                    bits >>= 8;
+                    pending -= 8;
+                }
+            }
+            if (pending > 0)
+            {
+                *record = static_cast<uint8_t>(bits);
+            }
+        }
+
+        /**
+         * @brief Unpacks a puzzle record into one value per element.
+         *
+         * @param record
+         * @param values Space for the CELLS values
+         * @return true if every value is in range
+         */
+        static bool unpackValues(const uint8_t *record, uint8_t *values)
+        {
+            if constexpr (CELL_BITS == 4)
+            {
+                bool valid = true;
+                for (uint32_t i = 0; i < CELLS / 2; ++i)
+                {
+                    values[2 * i] = record[i] & 15;
+                    values[2 * i + 1] = record[i] >> 4;
+                    valid &= ((record[i] & 15) <= SIDE) & ((record[i] >> 4) <= SIDE);
+                }
+                if (CELLS % 2 != 0)
+                {
+                    values[CELLS - 1] = record[CELLS / 2] & 15;
+                    valid &= ((record[CELLS / 2] & 15) <= SIDE);
+                }
+                return valid;
+            }
+
+            uint32_t bits = 0;
+            uint32_t pending = 0;
+            bool valid = true;
+            for (uint32_t i = 0; i < CELLS; ++i)
+            {
+                if (pending < CELL_BITS)
+                {
+                    bits |= static_cast<uint32_t>(*record++) << pending;
+                    pending += 8;
+                }
+                uint32_t value = bits & CELL_MASK;
+                bits >>= CELL_BITS;
+                pending -= CELL_BITS;
+
+                valid &= (value <= SIDE);
+                values[i] = static_cast<uint8_t>(value);
+            }
+            return valid;
+        }
+
+        /**
+         * @brief Packs a result record.
+         *
+         * @param solution The CELLS values of the solution, or of whatever was left when it could not be solved
+         * @param result
+         * @param record Space for RESULT_RECORD_SIZE bytes
+         */
+        static void packResult(const uint8_t *solution, const Result &result, uint8_t *record)
+        {
+            packValues(solution, record);
+            record += PUZZLE_RECORD_SIZE;
+            record[0] = result.solved ? SOLVED_FLAG : 0;
+            storeLittle<uint32_t>(result.guesses, record + 1);
+            storeLittle<uint64_t>(result.time_ns, record + 5);
+        }
+
+        /**
+         * @brief Unpacks a result record.
+         *
+         * @param record
+         * @param solution Space for the CELLS values of the solution
+         * @return Result
+         */
+        static Result unpackResult(const uint8_t *record, uint8_t *solution)
+        {
+            unpackValues(record, solution);
+            record += PUZZLE_RECORD_SIZE;
+            return Result{(record[0] & SOLVED_FLAG) != 0, loadLittle<uint32_t>(record + 1),
+                          loadLittle<uint64_t>(record + 5)};
+        }
+    };
+
+    /**
+     * @brief Writes a packed file one record at a time. The header is written last, once the count and checksum of
+     * the records are known, so the file has to be seekable. A file that is never finished is left with a header
+     * that doesn't match its records, and is refused when read.
+     */
+    class Writer
+    {
+    private:
+        // Records are collected in a buffer of this size and written out whenever it fills up
+        static constexpr size_t BUFFER_SIZE = 1 << 20;
+
+        std::FILE *file;
+        Header header;
+        std::vector<uint8_t> buffer;
+
+        void flushBuffer()
+        {
+            if (std::fwrite(this->buffer.data(), 1, this->buffer.size(), this->file) != this->buffer.size())
+            {
+                throw std::runtime_error("Could not write packed file");
+            }
+            this->buffer.clear();
+        }
+
+    public:
+        /**
+         * @brief Creates (or truncates) the file and leaves room for its header.
+         *
+         * @param path
+         * @param magic PUZZLE_MAGIC or RESULT_MAGIC
+         * @param side
+         * @param record_size
+         */
+        Writer(const std::string &path, const char *magic, uint32_t side, uint32_t record_size)
+            : file(std::fopen(path.c_str(), "wb")), header{magic, side, record_size, 0, CHECKSUM_SEED}
+        {
+            if (this->file == nullptr)
+            {
+                throw std::runtime_error("Could not open packed file for writing");
+            }
+            this->buffer.reserve(BUFFER_SIZE);
+            this->buffer.resize(HEADER_SIZE);
+        }
+
+        ~Writer()
+        {
+            if (this->file != nullptr)
+            {
+                std::fclose(this->file);
+            }
+        }
+
+        Writer(const Writer &) = delete;
+        Writer &operator=(const Writer &) = delete;
+
+        /**
+         * @brief Appends a record.
+         *
+         * @param record header.record_size bytes
+         */
+        void append(const uint8_t *record)
+        {
+            if (this->buffer.size() + this->header.record_size > BUFFER_SIZE)
+            {
+                this->flushBuffer();
+            }
+            this->buffer.insert(this->buffer.end(), record, record + this->header.record_size);
+            this->header.checksum = checksum(record, this->header.record_size, this->header.checksum);
+            ++this->header.count;
+        }
+
+        /**
+         * @brief Writes out the remaining records and the header, and closes the file.
+         */
+        void finish()
+        {
+            this->flushBuffer();
+
+            uint8_t header_bytes[HEADER_SIZE];
+            writeHeader(this->header, header_bytes);
+            if ((std::fseek(this->file, 0, SEEK_SET) != 0) ||
+                (std::fwrite(header_bytes, 1, HEADER_SIZE, this->file) != HEADER_SIZE) ||
+                (std::fclose(this->file) != 0))
+            {
+                this->file = nullptr;
+                throw std::runtime_error("Could not write packed file header");
+            }
+            this->file = nullptr;
+        }
+    };
+
+} // packed
+
+#endif
@@ -0,0 +1,128 @@
+#ifndef SUDOFUN_PARSER_HEADER
+#define SUDOFUN_PARSER_HEADER
+
+#include "kernels.hpp"
+#include "puzzle.hpp"
+#include <array>
+#include <stdint.h>
+#include <string_view>
+
+/**
+ * @brief Reads puzzles from text in either of the input formats, straight into a puzzle and without allocating.
+ * The text is first read into one value per element (0 for a blank), which the puzzle then takes in one pass.
+ */
+namespace parser
+{
+    /**
+     * @brief Reads the one character per element form (81 characters for a 9x9 puzzle), with digits 1-9 and then
+     * letters from A for clues, and either . or 0 for blanks. 9x9 puzzles are checked and converted by the vector
+     * kernels.
+     *
+     * @tparam BoxSize
+     * @param text
+     * @param values Where to write the CELLS values
+     * @return true if the text is in this form
+     */
+    template <uint32_t BoxSize>
+    bool readCells(std::string_view text, uint8_t *values)
+    {
+        using Puzzle = BasicPuzzle<BoxSize>;
+
+        if (text.length() != Puzzle::CELLS)
+        {
+            return false;
+        }
+
+        if constexpr (BoxSize == 3)
+        {
+            return kernels::active().readCells(text.data(), values);
+        }
+        else
+        {
+            bool valid = true;
+            for (uint32_t i = 0; i < Puzzle::CELLS; ++i)
+            {
+                uint32_t value = utils::charToValue(text[i]);
+                valid &= (value <= Puzzle::SIDE) && ((value != 0) || (text[i] == '0') || (text[i] == '.'));
+                values[i] = static_cast<uint8_t>(value);
+            }
+            return valid;
+        }
+    }
+
+    /**
+     * @brief Reads the colon delimited triplet form of a 9x9 puzzle, where each triplet gives the row, column, and
+     * value of a clue, all from 1 to 9. A later triplet for the same element replaces an earlier one.
+     *
+     * @param text
+     * @param values Where to write the 81 values
+     * @return true if the text is in this form
+     */
+    inline bool readTriplets(std::string_view text, uint8_t *values)
+    {
+        size_t length = text.length();
+        if ((length + 1) % 4 != 0)
+        {
+            return false;
+        }
+
+        std::fill(values, values + 81, 0);
+        for (size_t i = 0; i < length; i += 4)
+        {
+            // Offsetting by '1' wraps anything below it round to a large value, so one compare checks both ends
+            uint32_t row_idx = static_cast<uint8_t>(text[i] - '1');
+            uint32_t col_idx = static_cast<uint8_t>(text[i + 1] - '1');
+            uint32_t value = static_cast<uint8_t>(text[i + 2] - '0');
+            bool delimited = (i + 3 == length) || (text[i + 3] == ':');
+            if ((row_idx >= 9) || (col_idx >= 9) || (value - 1 >= 9) || !delimited)
+            {
+                return false;
+            }
+            values[9 * row_idx + col_idx] = static_cast<uint8_t>(value);
+        }
+        return true;
+    }
+
+    /**
+     * @brief Reads a puzzle in whichever form the text is in (the triplet form only for 9x9 puzzles), tolerating
+     * a trailing carriage return.
+     *
+     * @tparam BoxSize
+     * @param text
+     * @param values Where to write the CELLS values
+     * @return true if the text could be read
+     */
+    template <uint32_t BoxSize>
+    bool readValues(std::string_view text, uint8_t *values)
+    {
+        if (!text.empty() && (text.back() == '\r'))
+        {
+            text.remove_suffix(1);
+        }
+
+        bool read = readCells<BoxSize>(text, values);
+        if constexpr (BoxSize == 3)
+        {
+            read = read || readTriplets(text, values);
+        }
+        return read;
+    }
+
+    /**
+     * @brief Reads a puzzle in whichever form the text is in, and adds its clues to a blank puzzle.
+     *
+     * @tparam BoxSize
+     * @param text
+     * @param puzzle A freshly constructed puzzle
+     * @return true if the text could be read and none of its clues conflict
+     */
+    template <uint32_t BoxSize>
+    bool parsePuzzle(std::string_view text, BasicPuzzle<BoxSize> *puzzle)
+    {
+        std::array<uint8_t, BasicPuzzle<BoxSize>::CELLS> values;
+        return readValues<BoxSize>(text, values.data()) && puzzle->addClueValues(values.data());
+    }
+
+} // parser
+
+#endif
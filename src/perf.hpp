@@ -0,0 +1,284 @@
+#ifndef SUDOFUN_PERF_HEADER
+#define SUDOFUN_PERF_HEADER
+
+#include <array>
+#include <chrono>
+#include <stdint.h>
+#include <utility>
+
+#if defined(__linux__)
+#define SUDOFUN_HAVE_PERF_EVENTS 1
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SUDOFUN_HAVE_RDTSC 1
+#include <x86intrin.h>
+#endif
+
+/**
+ * @brief Hardware performance counters for the calling thread, read through Linux perf_event_open. The counters
+ * are opened as one group so they all cover exactly the same stretch of code, and the whole group is read with a
+ * single system call.
+ *
+ * A group with more events than the PMU has free counters is multiplexed: it only counts for part of the time it is
+ * enabled. Each measurement is then scaled up by the time enabled over the time running, and multiplexed() says so.
+ * A group that never gets onto the PMU at all is closed again, as if perf events couldn't be opened.
+ *
+ * Where perf events can't be opened (other platforms, containers, or a restrictive perf_event_paranoid) only the
+ * cycle count is kept, as time stamp counter ticks from rdtsc, or failing that as nanoseconds from the steady clock.
+ * Counters must be read on the thread that created them.
+ */
+class PerfCounters
+{
+public:
+    enum Event : uint32_t
+    {
+        CYCLES,
+        INSTRUCTIONS,
+        BRANCH_MISSES,
+        L1D_MISSES,
+        LLC_MISSES,
+        DTLB_MISSES,
+        EVENT_COUNT
+    };
+
+    static constexpr std::array<const char *, EVENT_COUNT> EVENT_NAMES = {
+        "cycles", "instructions", "branch-misses", "L1d-misses", "LLC-misses", "dTLB-misses"};
+
+    using Sample = std::array<uint64_t, EVENT_COUNT>;
+
+    // The raw counts at some moment, with how long the group had been enabled and running by then
+    struct Mark
+    {
+        Sample counts;
+        uint64_t time_enabled;
+        uint64_t time_running;
+    };
+
+private:
+    std::array<int, EVENT_COUNT> fds;
+
+    // Where each open event lands in a group read, or -1 if it could not be opened
+    std::array<int, EVENT_COUNT> slots;
+    uint32_t num_open;
+
+    // Whether any measurement so far was taken while the group was only counting part of the time
+    mutable bool was_multiplexed;
+
+#if defined(SUDOFUN_HAVE_PERF_EVENTS)
+    static uint64_t cacheConfig(uint64_t cache, uint64_t op, uint64_t result)
+    {
+        return cache | (op << 8) | (result << 16);
+    }
+
+    int openEvent(uint32_t type, uint64_t config, int group_fd)
+    {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = (group_fd == -1) ? 1 : 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        return static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0));
+    }
+
+    void openGroup()
+    {
+        const std::array<std::pair<uint32_t, uint64_t>, EVENT_COUNT> events = {{
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+            {PERF_TYPE_HW_CACHE, cacheConfig(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ,
+                                             PERF_COUNT_HW_CACHE_RESULT_MISS)},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+            {PERF_TYPE_HW_CACHE, cacheConfig(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ,
+                                             PERF_COUNT_HW_CACHE_RESULT_MISS)},
+        }};
+
+        // Cycles lead the group; without them there is no group at all. Any other event the machine lacks is
+        // simply left out.
+        for (uint32_t e = 0; e < EVENT_COUNT; ++e)
+        {
+            int fd = this->openEvent(events[e].first, events[e].second, this->fds[CYCLES]);
+            if (fd < 0)
+            {
+                if (e == CYCLES)
+                {
+                    return;
+                }
+                continue;
+            }
+            this->fds[e] = fd;
+            this->slots[e] = static_cast<int>(this->num_open++);
+        }
+
+        ::ioctl(this->fds[CYCLES], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ::ioctl(this->fds[CYCLES], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+
+        // The group is scheduled as soon as it is enabled if it fits at all. One that has been enabled without
+        // running never will, and would only ever read zeros.
+        Mark probe;
+        this->read(&probe);
+        if ((probe.time_enabled > 0) && (probe.time_running == 0))
+        {
+            this->closeAll();
+        }
+    }
+#endif
+
+    void closeAll()
+    {
+#if defined(SUDOFUN_HAVE_PERF_EVENTS)
+        for (int &fd : this->fds)
+        {
+            if (fd >= 0)
+            {
+                ::close(fd);
+                fd = -1;
+            }
+        }
+#endif
+        this->slots.fill(-1);
+        this->num_open = 0;
+    }
+
+    void read(Mark *mark) const
+    {
+        mark->counts.fill(0);
+        mark->time_enabled = 0;
+        mark->time_running = 0;
+
+#if defined(SUDOFUN_HAVE_PERF_EVENTS)
+        if (this->num_open > 0)
+        {
+            // A group read gives the number of events, the times enabled and running, then each event's value
+            std::array<uint64_t, EVENT_COUNT + 3> values;
+            if (::read(this->fds[CYCLES], values.data(), sizeof(values)) > 0)
+            {
+                mark->time_enabled = values[1];
+                mark->time_running = values[2];
+                for (uint32_t e = 0; e < EVENT_COUNT; ++e)
+                {
+                    if (this->slots[e] >= 0)
+                    {
+                        mark->counts[e] = values[3 + this->slots[e]];
+                    }
+                }
+            }
+            return;
+        }
+#endif
+
+#if defined(SUDOFUN_HAVE_RDTSC)
+        mark->counts[CYCLES] = __rdtsc();
+#else
+        mark->counts[CYCLES] = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+                .count());
+#endif
+    }
+
+public:
+    PerfCounters() : num_open(0), was_multiplexed(false)
+    {
+        this->fds.fill(-1);
+        this->slots.fill(-1);
+#if defined(SUDOFUN_HAVE_PERF_EVENTS)
+        this->openGroup();
+#endif
+    }
+
+    ~PerfCounters()
+    {
+        this->closeAll();
+    }
+
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    /**
+     * @brief Whether an event is being counted. Without perf events only the cycles are.
+     *
+     * @param event
+     * @return bool
+     */
+    bool counting(Event event) const
+    {
+        return (this->num_open > 0) ? (this->slots[event] >= 0) : (event == CYCLES);
+    }
+
+    /**
+     * @brief Whether any measurement so far was scaled up from part of its time, because the group had to share the
+     * PMU with other events.
+     *
+     * @return bool
+     */
+    bool multiplexed() const
+    {
+        return this->was_multiplexed;
+    }
+
+    /**
+     * @brief Where the counts come from, for the report.
+     *
+     * @return const char*
+     */
+    const char *source() const
+    {
+        if (this->num_open > 0)
+        {
+            return "perf_event_open";
+        }
+#if defined(SUDOFUN_HAVE_RDTSC)
+        return "rdtsc (cycles are reference cycles; other counters unavailable)";
+#else
+        return "steady_clock (cycles are nanoseconds; other counters unavailable)";
+#endif
+    }
+
+    /**
+     * @brief Starts a measurement.
+     *
+     * @param start Set to the current counts, to be passed to stop()
+     */
+    void start(Mark *start) const
+    {
+        this->read(start);
+    }
+
+    /**
+     * @brief Ends a measurement. If the group only counted for part of it, the counts are scaled up to the whole.
+     *
+     * @param start The counts taken by start()
+     * @param delta Set to the counts since start()
+     */
+    void stop(const Mark &start, Sample *delta) const
+    {
+        Mark end;
+        this->read(&end);
+        for (uint32_t e = 0; e < EVENT_COUNT; ++e)
+        {
+            (*delta)[e] = end.counts[e] - start.counts[e];
+        }
+
+        uint64_t enabled = end.time_enabled - start.time_enabled;
+        uint64_t running = end.time_running - start.time_running;
+        if (running < enabled)
+        {
+            this->was_multiplexed = true;
+            double scale = (running > 0) ? (double)enabled / (double)running : 0.0;
+            for (uint64_t &count : *delta)
+            {
+                count = static_cast<uint64_t>((double)count * scale);
+            }
+        }
+    }
+};
+
+#endif
@@ -3,6 +3,9 @@
 #define SUDOFUN_PUZZLE_CLASS_HEADER
 
 #include "clue.hpp"
+#include "indices.hpp"
+#include "journal.hpp"
+#include "kernels.hpp"
 #include "maps.hpp"
 #include "utils.hpp"
 #include <iostream>
@@ -10,42 +13,148 @@
 #include <algorithm>
 #include <tuple>
 #include <numeric>
-
-class Puzzle
+#include <string_view>
+#include <type_traits>
+
+/**
+ * @brief A puzzle made of BoxSize x BoxSize blocks, i.e. with a side of BoxSize^2 (9 for the standard puzzle, 16 or
+ * 25 for the larger ones). Each element holds its solution space as a word with one bit per digit.
+ *
+ * @tparam BoxSize
+ */
+template <uint32_t BoxSize>
+class BasicPuzzle
 {
+public:
+    using Topo = maps::Topology<BoxSize>;
+    using Word = typename Topo::Word;
+    using CellSet = typename Topo::CellSet;
+    using UnitSet = typename Topo::UnitSet;
+    using Journal = BasicJournal<Topo::CELLS, Topo::SIDE, Word>;
+    using IndexStack = BasicIndexStack<Topo::CELLS>;
+
+    // The smallest type that holds any flat index
+    using CellIndex = std::conditional_t<(Topo::CELLS <= 256), uint8_t, uint16_t>;
+
+    static constexpr uint32_t SIDE = Topo::SIDE;
+    static constexpr uint32_t CELLS = Topo::CELLS;
+    static constexpr Word ALL_BITS = Topo::ALL_BITS;
+
+    // Only the standard puzzle has vector kernels; the larger ones scan their data directly
+    static constexpr bool USE_KERNELS = (BoxSize == 3);
+    static constexpr uint32_t PADDED_CELLS = USE_KERNELS ? kernels::PADDED_CELLS : CELLS;
+
+    /**
+     * @brief Bits seen at least once and at least twice within each unit, laid out as the units of the topology.
+     */
+    struct ScalarUnitMasks
+    {
+        std::array<Word, Topo::UNITS> once;
+        std::array<Word, Topo::UNITS> twice;
+    };
+    using UnitMasks = std::conditional_t<USE_KERNELS, kernels::UnitMasks, ScalarUnitMasks>;
+
 private:
-    // Data attribute tracking the solution space for each square
-    std::array<uint16_t, 81> data;
+    // Data attribute tracking the solution space for each square, zero padded past the last square so the
+    // vector kernels can load it whole
+    alignas(64) std::array<Word, PADDED_CELLS> data;
     bool loaded_clue;
 
-    // Companion data objects to track the unsolved row, column, and block members for
-    // each puzzle index; values are in flat index
-    std::array<std::vector<uint32_t>, 9> row_u_groups;
-    std::array<std::vector<uint32_t>, 9> col_u_groups;
-    std::array<std::vector<uint32_t>, 9> blk_u_groups;
+    // Companion masks to track the unsolved row, column, and block members for each puzzle
+    // index; bit n of a mask is set while the nth member of that group is unsolved
+    std::array<Word, SIDE> row_u_masks;
+    std::array<Word, SIDE> col_u_masks;
+    std::array<Word, SIDE> blk_u_masks;
+
+    // Undo trail recording writes to data while a checkpoint is open; null otherwise
+    Journal *journal;
+
+    // The units (as laid out in Topo::FLAT_TO_UNITS) with a member written since the mask was last taken
+    UnitSet dirty_units;
+
+    // The same solution space seen digit first: the elements which may still take each digit, kept in step with
+    // data by every write
+    std::array<CellSet, SIDE> digit_cells;
 
 public:
+    /**
+     * @brief The bit standing for a digit.
+     *
+     * @param digit From 0 to SIDE - 1
+     * @return Word
+     */
+    static constexpr Word digitBit(uint32_t digit)
+    {
+        return static_cast<Word>(static_cast<Word>(1) << digit);
+    }
+
+    /**
+     * @brief The value (1 to SIDE) of a solved word, or 0 for a word of any other number of bits.
+     *
+     * @param word
+     * @return uint32_t
+     */
+    static uint32_t wordToValue(Word word)
+    {
+        bool single = (word != 0) && ((word & (word - 1)) == 0);
+        return single ? utils::lowestBitIndex(word) + 1 : 0;
+    }
+
+    /**
+     * @brief Everything needed to rewind a puzzle to an earlier state: the journal position for the puzzle
+     * data, plus the (small) unsolved bookkeeping captured by value.
+     */
+    struct Checkpoint
+    {
+        Journal *prev_journal;
+        uint32_t journal_position;
+        std::array<Word, SIDE> row_u_masks;
+        std::array<Word, SIDE> col_u_masks;
+        std::array<Word, SIDE> blk_u_masks;
+        std::array<CellSet, SIDE> digit_cells;
+        IndexStack latest_solved_indices;
+        CellSet unsolved_indices;
+    };
+
+    /**
+     * @brief A set of mutually exclusive alternatives for a search to branch on, each of which sets a single
+     * element to a single bit.
+     */
+    struct Branch
+    {
+        std::array<CellIndex, SIDE> cells;
+        std::array<Word, SIDE> bits;
+        uint32_t count;
+    };
+
     // Companion objects to track which indices have been solved, and which haven't
-    std::vector<uint32_t> latest_solved_indices;
-    std::vector<uint32_t> unsolved_indices;
+    IndexStack latest_solved_indices;
+    CellSet unsolved_indices;
 
     // Constructor
-    Puzzle()
+    BasicPuzzle()
     {
         // Initialize the puzzle data to be entirely unsolved
-        data.fill(511); // bin(511) = 0000000111111111
+        data.fill(0);
+        std::fill(data.begin(), data.begin() + CELLS, ALL_BITS);
 
         // Signify that we haven't loaded any clue yet
         loaded_clue = false;
 
-        // Initialize helper members to hard-coded pre-computed vectors
-        unsolved_indices = maps::INIT_UNSOLVED_INDICES;
-        row_u_groups = maps::INIT_ROW_GROUPS;
-        col_u_groups = maps::INIT_COL_GROUPS;
-        blk_u_groups = maps::INIT_BLK_GROUPS;
+        // Nothing to journal until a checkpoint is opened
+        journal = nullptr;
+
+        // Nothing has been looked at yet
+        dirty_units = Topo::ALL_UNITS;
 
-        // Latest solved is empty, but reserve enough space to never need re-allocation
-        latest_solved_indices.reserve(81);
+        // Every digit may go anywhere
+        digit_cells.fill(CellSet::full());
+
+        // Every index starts out unsolved
+        unsolved_indices = CellSet::full();
+        row_u_masks.fill(ALL_BITS);
+        col_u_masks.fill(ALL_BITS);
+        blk_u_masks.fill(ALL_BITS);
     }
 
     //--------------------------------------------------------------------------------------------//
@@ -53,12 +162,13 @@ public:
     //--------------------------------------------------------------------------------------------//
 
     /**
-     * @brief Adds a clue to a blank initialized puzzle.
+     * @brief Adds a clue to a blank initialized puzzle. Clue strings only describe 9x9 puzzles.
      *
      * @param clue A clue which defines the puzzle
      */
     void addClueString(StringClue *clue)
     {
+        static_assert(BoxSize == 3, "Clue strings only describe 9x9 puzzles");
 
         if (this->loaded_clue)
         {
@@ -71,93 +181,155 @@ public:
             throw std::runtime_error("Clue has invalid length after validation?!");
         }
 
-        // Iterate over triplet substrings of the cluestring
-        for (uint32_t i = 0; i < string_len; i += 3)
+        // Read the index/value triplets, remembering that cluestrings index starting at 1, not zero. A later clue
+        // for the same element replaces an earlier one.
+        std::array<uint8_t, CELLS> values{};
+        const std::string &clue_string = clue->clue_string;
+        for (size_t i = 0; i < string_len; i += 3)
         {
-            std::string s = clue->clue_string.substr(i, 3);
-
-            // Convert clues to their index/value combination, remembering that cluestrings will
-            // index starting at 1, not zero
-            uint32_t row_idx = static_cast<uint32_t>(s[0] - '0') - 1;
-            uint32_t col_idx = static_cast<uint32_t>(s[1] - '0') - 1;
-            uint32_t val_num = static_cast<uint32_t>(s[2] - '0');
-            uint32_t flat_index = row_idx * 9 + col_idx;
-
-            // Set the corresponding flat index to the value converted to a 9-bit representation
-            this->setValue(flat_index, utils::valueToNineBit(val_num));
-
-            // Add to the list of solved
-            this->latest_solved_indices.push_back(flat_index);
-
-            // Remove from the unsolved list
-            for (auto it = this->unsolved_indices.begin(); it != this->unsolved_indices.end(); ++it)
-            {
-                if (*it == flat_index)
-                {
-                    this->unsolved_indices.erase(it);
-                    break;
-                }
-            }
+            uint32_t row_idx = static_cast<uint32_t>(clue_string[i] - '1');
+            uint32_t col_idx = static_cast<uint32_t>(clue_string[i + 1] - '1');
+            values[row_idx * SIDE + col_idx] = static_cast<uint8_t>(clue_string[i + 2] - '0');
         }
 
-        this->removeVecFromUGroups(this->latest_solved_indices);
+        this->addClueValues(values.data());
     }
 
     void addClueVector(WindowClue *clue)
     {
+        static_assert(BoxSize == 3, "Window clues only describe 9x9 puzzles");
 
         if (this->loaded_clue)
         {
             throw std::runtime_error("A clue has already been added to this puzzle");
         }
 
-        for (auto i = clue->clue_vector.begin(); i != clue->clue_vector.end(); ++i)
+        std::array<uint8_t, CELLS> values{};
+        for (const auto &[flat_index, val_num] : clue->clue_vector)
         {
-            auto [flat_index, val_num] = *i;
+            values[flat_index] = static_cast<uint8_t>(val_num);
+        }
 
-            // Set the corresponding flat index to the value converted to a 9-bit representation
-            this->setValue(flat_index, utils::valueToNineBit(val_num));
+        this->addClueValues(values.data());
+    }
 
-            // Add to the list of solved
-            this->latest_solved_indices.push_back(flat_index);
+    /**
+     * @brief Adds the clues of a blank initialized puzzle in one pass, from one value per element: 0 for a blank,
+     * otherwise 1 to SIDE. A clue repeating a digit given earlier in one of its units conflicts with it, and is left
+     * with no options at all, so the solver sees the puzzle as broken straight away.
+     *
+     * @param values The CELLS values
+     * @return true if no two clues conflict
+     */
+    bool addClueValues(const uint8_t *values)
+    {
+        // The digits given so far in each unit
+        std::array<Word, SIDE> row_seen{};
+        std::array<Word, SIDE> col_seen{};
+        std::array<Word, SIDE> blk_seen{};
 
-            // Remove from the unsolved list
-            for (auto it = this->unsolved_indices.begin(); it != this->unsolved_indices.end(); ++it)
+        // The clues of each digit, and every element with a clue (conflicting or not)
+        std::array<CellSet, SIDE> clue_cells{};
+        CellSet given;
+        bool consistent = true;
+
+        for (uint32_t flat_index = 0; flat_index < CELLS; ++flat_index)
+        {
+            uint32_t value = values[flat_index];
+            if (value == 0)
             {
-                if (*it == flat_index)
-                {
-                    this->unsolved_indices.erase(it);
-                    break;
-                }
+                continue;
+            }
+            given.insert(flat_index);
+
+            uint32_t row_idx = Topo::flatToRow(flat_index);
+            uint32_t col_idx = Topo::flatToCol(flat_index);
+            uint32_t blk_idx = Topo::flatToBlk(flat_index);
+            Word bit = digitBit(value - 1);
+            if (((row_seen[row_idx] | col_seen[col_idx] | blk_seen[blk_idx]) & bit) != 0)
+            {
+                consistent = false;
+                this->data[flat_index] = 0;
+                continue;
             }
+            row_seen[row_idx] |= bit;
+            col_seen[col_idx] |= bit;
+            blk_seen[blk_idx] |= bit;
+
+            this->data[flat_index] = bit;
+            clue_cells[value - 1].insert(flat_index);
+            this->latest_solved_indices.push_back(flat_index);
+            this->unsolved_indices.erase(flat_index);
+            this->removeIdxFromUGroups(flat_index);
+        }
+
+        // Every digit may still go in any element without a clue
+        CellSet open = CellSet::full().without(given);
+        for (uint32_t digit = 0; digit < SIDE; ++digit)
+        {
+            this->digit_cells[digit] = open | clue_cells[digit];
         }
+
+        return consistent;
     }
 
     /**
-     * @brief The conventional form for puzzle strings is an 81 character long string where . represents
-     * a null entry.
+     * @brief Checks that a string is in the conventional one character per element form (81 characters for a 9x9
+     * puzzle), with digits 1-9 and then letters from A for clues, and either . or 0 for null entries.
      *
      * @param benchmarkString
+     * @return bool
      */
-    void addBenchmarkString(const std::string &benchmarkString)
+    static bool validBenchmarkString(std::string_view benchmarkString)
     {
-        uint32_t removedCount = 0;
-        auto itBegin = this->unsolved_indices.begin();
-        for (uint32_t flat_index = 0; flat_index < 81; ++flat_index)
+        if (benchmarkString.length() != CELLS)
         {
-            char s = benchmarkString[flat_index];
-            if (s != '.')
-            {
-                // Set the corresponding flat index to the value converted to a 9-bit representation
-                this->setValue(flat_index, utils::valueToNineBit(static_cast<uint32_t>(s - '0')));
+            return false;
+        }
 
-                // Add to the list of solved
-                this->latest_solved_indices.push_back(flat_index);
+        bool goodness{true};
+        for (const char s : benchmarkString)
+        {
+            uint32_t value = utils::charToValue(s);
+            goodness &= ((value >= 1) && (value <= SIDE)) || (s == '0') || (s == '.');
+        }
 
-                // Remove from the unsolved list
-                this->unsolved_indices.erase(itBegin + flat_index - removedCount);
+        return goodness;
+    }
+
+    /**
+     * @brief The conventional form for puzzle strings is one character per element (81 for a 9x9 puzzle) where
+     * . (or 0) represents a null entry.
+     *
+     * @param benchmarkString
+     * @return true if no two clues conflict
+     */
+    bool addBenchmarkString(std::string_view benchmarkString)
+    {
+        std::array<uint8_t, CELLS> values;
+        for (uint32_t flat_index = 0; flat_index < CELLS; ++flat_index)
+        {
+            values[flat_index] = static_cast<uint8_t>(utils::charToValue(benchmarkString[flat_index]));
+        }
 
-                ++removedCount;
+        return this->addClueValues(values.data());
+    }
+
+    /**
+     * @brief Takes the solution space of every element from a puzzle already partly solved elsewhere, e.g. in one
+     * lane of the batch solver. Elements down to a single bit count as solved.
+     *
+     * @param values The CELLS values, in the same encoding as the puzzle data
+     */
+    void addCandidateValues(const Word *values)
+    {
+        for (uint32_t flat_index = 0; flat_index < CELLS; ++flat_index)
+        {
+            this->setValue(flat_index, values[flat_index]);
+            if (wordToValue(values[flat_index]) != 0)
+            {
+                this->latest_solved_indices.push_back(flat_index);
+                this->unsolved_indices.erase(flat_index);
             }
         }
 
@@ -168,17 +340,82 @@ public:
     //--- Setting and getting the puzzle data ----------------------------------------------------//
     //--------------------------------------------------------------------------------------------//
 
-    void setValue(uint32_t flat_index, uint16_t val)
+    void setValue(uint32_t flat_index, Word val)
     {
+        if (data[flat_index] != val)
+        {
+            if (this->journal != nullptr)
+            {
+                this->journal->record(flat_index, data[flat_index]);
+            }
+            this->dirty_units |= Topo::FLAT_TO_UNITS[flat_index];
+
+            for (Word removed = data[flat_index] & ~val; removed != 0; removed &= removed - 1)
+            {
+                this->digit_cells[utils::lowestBitIndex(removed)].erase(flat_index);
+            }
+            for (Word added = val & ~data[flat_index]; added != 0; added &= added - 1)
+            {
+                this->digit_cells[utils::lowestBitIndex(added)].insert(flat_index);
+            }
+        }
         data[flat_index] = val;
     }
 
-    uint16_t getValue(uint32_t flat_index)
+    /**
+     * @brief Removes the given bits from the solution space of an element.
+     *
+     * @param flat_index
+     * @param bits
+     */
+    void removeBits(uint32_t flat_index, Word bits)
+    {
+        this->setValue(flat_index, data[flat_index] - (data[flat_index] & bits));
+    }
+
+    /**
+     * @brief Removes the given bits from the solution space of an element referenced by a pointer obtained
+     * from one of the value slice accessors.
+     *
+     * @param val_ptr
+     * @param bits
+     */
+    void removeBits(Word *val_ptr, Word bits)
+    {
+        this->removeBits(static_cast<uint32_t>(val_ptr - data.data()), bits);
+    }
+
+    /**
+     * @brief Removes a bit from the solution space of each of a set of elements.
+     *
+     * @param cells
+     * @param bit
+     */
+    void removeBitFrom(const CellSet &cells, Word bit)
+    {
+        for (const uint32_t flat_index : cells)
+        {
+            this->removeBits(flat_index, bit);
+        }
+    }
+
+    Word getValue(uint32_t flat_index)
     {
         return data[flat_index];
     }
 
-    uint16_t *ptrValue(uint32_t flat_index)
+    /**
+     * @brief Returns the elements which may still take a digit, solved or not.
+     *
+     * @param digit From 0 to SIDE - 1, i.e. the bit position of the digit
+     * @return const CellSet&
+     */
+    const CellSet &digitCells(uint32_t digit) const
+    {
+        return this->digit_cells[digit];
+    }
+
+    Word *ptrValue(uint32_t flat_index)
     {
         return &data[flat_index];
     }
@@ -193,6 +430,33 @@ public:
         return this->unsolved_indices.size();
     }
 
+    /**
+     * @brief Returns the total number of candidate bits left across every element of the puzzle.
+     *
+     * @return uint32_t
+     */
+    uint32_t numCandidates()
+    {
+        uint32_t candidates = 0;
+        for (uint32_t i = 0; i < CELLS; ++i)
+        {
+            candidates += Topo::countBits(this->data[i]);
+        }
+        return candidates;
+    }
+
+    /**
+     * @brief Returns the units with a member written since the last call, and starts tracking afresh.
+     *
+     * @return UnitSet Laid out as in Topo::FLAT_TO_UNITS
+     */
+    UnitSet takeDirtyUnits()
+    {
+        UnitSet dirty = this->dirty_units;
+        this->dirty_units = UnitSet();
+        return dirty;
+    }
+
     /**
      * @brief Looks over the unsolved indices to see whether any are actually solved. If one is solved,
      * remove it from the unsolved indices and add it to the recently solved indices.
@@ -200,29 +464,33 @@ public:
      */
     void checkUnsolved()
     {
-        // Check which flat indices have been solved and put them into the latest solved vector
-        uint32_t index_in_unsolved = 0;
-        std::vector<uint32_t> indices_to_remove;
-        indices_to_remove.reserve(this->unsolved_indices.size());
-        for (const uint32_t &puzzle_index : this->unsolved_indices)
+        // Find every element down to a single bit, and keep those we didn't already know were solved
+        CellSet newly_solved;
+        if constexpr (USE_KERNELS)
+        {
+            uint64_t singletons[2];
+            kernels::active().singletons(this->data.data(), singletons);
+            newly_solved = CellSet(singletons[0], singletons[1]) & this->unsolved_indices;
+        }
+        else
         {
-            if (utils::countBits(this->getValue(puzzle_index)) == 1)
+            // An element is down to a single bit when it is among the places of exactly one digit
+            CellSet once;
+            CellSet twice;
+            for (const CellSet &places : this->digit_cells)
             {
-                // Add this index to latest solved
-                this->latest_solved_indices.push_back(puzzle_index);
-
-                // Push this index into the tracker
-                indices_to_remove.push_back(index_in_unsolved);
+                twice |= once & places;
+                once |= places;
             }
-
-            ++index_in_unsolved;
+            newly_solved = once.without(twice) & this->unsolved_indices;
         }
 
-        // Iterate in reverse through the indices to remove from the unsolved indices
-        for (auto it = indices_to_remove.rbegin(); it != indices_to_remove.rend(); ++it)
+        // Move them from the unsolved indices into the latest solved
+        for (const uint32_t puzzle_index : newly_solved)
         {
-            this->unsolved_indices.erase(this->unsolved_indices.begin() + *it);
+            this->latest_solved_indices.push_back(puzzle_index);
         }
+        this->unsolved_indices.erase(newly_solved);
     }
 
     /**
@@ -232,14 +500,107 @@ public:
      */
     bool validPuzzle()
     {
-        bool goodness{true};
+        if constexpr (USE_KERNELS)
+        {
+            return !kernels::active().anyEmpty(this->data.data());
+        }
+        else
+        {
+            return std::find(this->data.begin(), this->data.end(), 0) == this->data.end();
+        }
+    }
 
-        for (const uint16_t &val : this->data)
+    /**
+     * @brief Determines whether the puzzle is fully solved without any row, column, or block repeating a value.
+     *
+     * @return bool
+     */
+    bool validSolution()
+    {
+        if (this->numUnsolved() != 0)
         {
-            goodness &= (val != 0);
+            return false;
         }
 
-        return goodness;
+        // With every element down to a single bit, a repeated value is a bit seen twice in some unit
+        UnitMasks masks;
+        this->unitMasks(&masks);
+
+        Word repeated = 0;
+        for (const Word &twice : masks.twice)
+        {
+            repeated |= twice;
+        }
+
+        return repeated == 0;
+    }
+
+    //--------------------------------------------------------------------------------------------//
+    //--- Checkpoints for trial-and-error solving ------------------------------------------------//
+    //--------------------------------------------------------------------------------------------//
+
+    /**
+     * @brief Opens a checkpoint which the puzzle can later be rewound to. Until the checkpoint is rewound or
+     * released, every write to the puzzle data is recorded in the given journal. Checkpoints may be nested, but
+     * must be closed in reverse order of opening.
+     *
+     * @param journal The undo trail to record writes into
+     * @return Checkpoint
+     */
+    Checkpoint checkpoint(Journal *journal)
+    {
+        Checkpoint cp{this->journal, journal->position(), this->row_u_masks, this->col_u_masks, this->blk_u_masks,
+                      this->digit_cells, this->latest_solved_indices, this->unsolved_indices};
+        this->journal = journal;
+        return cp;
+    }
+
+    /**
+     * @brief Restores the puzzle to its state when the checkpoint was opened, and closes the checkpoint.
+     *
+     * @param cp
+     */
+    void rewind(const Checkpoint &cp)
+    {
+        this->journal->rewind(cp.journal_position, this->data.data());
+
+        // Rewinding restores options that techniques may since have acted on, so everything needs another look
+        this->dirty_units = Topo::ALL_UNITS;
+        this->row_u_masks = cp.row_u_masks;
+        this->col_u_masks = cp.col_u_masks;
+        this->blk_u_masks = cp.blk_u_masks;
+        this->digit_cells = cp.digit_cells;
+        this->latest_solved_indices = cp.latest_solved_indices;
+        this->unsolved_indices = cp.unsolved_indices;
+        this->journal = cp.prev_journal;
+    }
+
+    /**
+     * @brief Closes a checkpoint while keeping every change made since it was opened.
+     *
+     * @param cp
+     */
+    void release(const Checkpoint &cp)
+    {
+        // The outermost checkpoint no longer needs its trail
+        if (cp.prev_journal == nullptr)
+        {
+            this->journal->clear();
+        }
+        this->journal = cp.prev_journal;
+    }
+
+    /**
+     * @brief Returns a copy of the puzzle that is detached from any journal, for keeping a state found inside a
+     * checkpoint after the checkpoint has been rewound.
+     *
+     * @return BasicPuzzle
+     */
+    BasicPuzzle detachedCopy() const
+    {
+        BasicPuzzle copy = *this;
+        copy.journal = nullptr;
+        return copy;
     }
 
     //--------------------------------------------------------------------------------------------//
@@ -250,22 +611,65 @@ public:
      * @brief Returns the flat indices of all members of a given row.
      *
      * @param row_index
-     * @return const std::array<uint32_t, 9>&
+     * @return const std::array<uint32_t, SIDE>&
      */
-    const std::array<uint32_t, 9> &refIndicesInRow(uint32_t row_index)
+    const std::array<uint32_t, SIDE> &refIndicesInRow(uint32_t row_index)
     {
-        return maps::ROW_TO_FLAT[row_index];
+        return Topo::ROW_TO_FLAT[row_index];
     }
 
     /**
      * @brief Returns the flat indices of all members of a given column.
      *
      * @param col_index
-     * @return const std::array<uint32_t, 9>&
+     * @return const std::array<uint32_t, SIDE>&
+     */
+    const std::array<uint32_t, SIDE> &refIndicesInCol(uint32_t col_index)
+    {
+        return Topo::COL_TO_FLAT[col_index];
+    }
+
+    /**
+     * @brief Returns the flat indices of the unsolved elements of a given row.
+     *
+     * @param row_index
+     * @return UnitIndices
+     */
+    UnitIndices rowUGroup(uint32_t row_index) const
+    {
+        return UnitIndices(this->row_u_masks[row_index], Topo::ROW_TO_FLAT[row_index]);
+    }
+
+    /**
+     * @brief Returns the flat indices of the unsolved elements of a given column.
+     *
+     * @param col_index
+     * @return UnitIndices
      */
-    const std::array<uint32_t, 9> &refIndicesInCol(uint32_t col_index)
+    UnitIndices colUGroup(uint32_t col_index) const
     {
-        return maps::COL_TO_FLAT[col_index];
+        return UnitIndices(this->col_u_masks[col_index], Topo::COL_TO_FLAT[col_index]);
+    }
+
+    /**
+     * @brief Returns the flat indices of the unsolved elements of a given block.
+     *
+     * @param blk_index
+     * @return UnitIndices
+     */
+    UnitIndices blkUGroup(uint32_t blk_index) const
+    {
+        return UnitIndices(this->blk_u_masks[blk_index], Topo::BLK_TO_FLAT[blk_index]);
+    }
+
+    /**
+     * @brief Returns every element still in its unsolved groups, i.e. not yet struck from the puzzle.
+     *
+     * @return CellSet
+     */
+    CellSet uCells() const
+    {
+        return CellSet::fromRowMasks(this->row_u_masks);
     }
 
     /**
@@ -273,11 +677,11 @@ public:
      * flat index.
      *
      * @param flat_idx
-     * @return std::vector<uint32_t>*
+     * @return UnitIndices
      */
-    std::vector<uint32_t> *ptrRowUGroup(uint32_t flat_idx)
+    UnitIndices rowUGroupOf(uint32_t flat_idx) const
     {
-        return &this->row_u_groups[maps::flatToRow(flat_idx)];
+        return this->rowUGroup(Topo::flatToRow(flat_idx));
     }
 
     /**
@@ -285,11 +689,11 @@ public:
      * flat index.
      *
      * @param flat_idx
-     * @return std::vector<uint32_t>*
+     * @return UnitIndices
      */
-    std::vector<uint32_t> *ptrColUGroup(uint32_t flat_idx)
+    UnitIndices colUGroupOf(uint32_t flat_idx) const
     {
-        return &this->col_u_groups[maps::flatToCol(flat_idx)];
+        return this->colUGroup(Topo::flatToCol(flat_idx));
     }
 
     /**
@@ -297,11 +701,11 @@ public:
      * flat index.
      *
      * @param flat_idx
-     * @return std::vector<uint32_t>*
+     * @return UnitIndices
      */
-    std::vector<uint32_t> *ptrBlkUGroup(uint32_t flat_idx)
+    UnitIndices blkUGroupOf(uint32_t flat_idx) const
     {
-        return &this->blk_u_groups[maps::flatToBlk(flat_idx)];
+        return this->blkUGroup(Topo::flatToBlk(flat_idx));
     }
 
     //--------------------------------------------------------------------------------------------//
@@ -312,13 +716,13 @@ public:
      * @brief Returns pointers to the values of each element of a given row.
      *
      * @param row_index
-     * @return std::array<uint16_t *, 9>
+     * @return std::array<Word *, SIDE>
      */
-    std::array<uint16_t *, 9> ptrValuesInRow(uint32_t row_index)
+    std::array<Word *, SIDE> ptrValuesInRow(uint32_t row_index)
     {
-        std::array<uint16_t *, 9> vals_in_row;
+        std::array<Word *, SIDE> vals_in_row;
 
-        for (uint32_t n = 0; n < 9; ++n)
+        for (uint32_t n = 0; n < SIDE; ++n)
         {
             vals_in_row[n] = this->ptrValue(this->refIndicesInRow(row_index)[n]);
         }
@@ -330,13 +734,13 @@ public:
      * @brief Returns pointers to the values of each element of a given column.
      *
      * @param col_index
-     * @return std::array<uint16_t *, 9>
+     * @return std::array<Word *, SIDE>
      */
-    std::array<uint16_t *, 9> ptrValuesInCol(uint32_t col_index)
+    std::array<Word *, SIDE> ptrValuesInCol(uint32_t col_index)
     {
-        std::array<uint16_t *, 9> vals_in_col;
+        std::array<Word *, SIDE> vals_in_col;
 
-        for (uint32_t n = 0; n < 9; ++n)
+        for (uint32_t n = 0; n < SIDE; ++n)
         {
             vals_in_col[n] = this->ptrValue(this->refIndicesInCol(col_index)[n]);
         }
@@ -348,26 +752,6 @@ public:
     //--- Methods to remove indices or vectors of indices from the unsolved row/col/blk groups ---//
     //--------------------------------------------------------------------------------------------//
 
-    /**
-     * @brief
-     *
-     * @param group
-     * @param cut_value
-     */
-    static void removeFromGroup(std::vector<uint32_t> *group, uint32_t cut_index)
-    {
-        // If the cut index is in the group, remove it (there will be at most one instance).
-        // NOTE: using std::find instead of this loop fails to compile on my build system
-        for (auto it = group->begin(); it != group->end(); ++it)
-        {
-            if (*it == cut_index)
-            {
-                group->erase(it);
-                break;
-            }
-        }
-    }
-
     /**
      * @brief Removes a given flat index from the unsolved groups
      *
@@ -376,15 +760,14 @@ public:
     void removeIdxFromUGroups(uint32_t cut_index)
     {
         // Convert to row, col, and blk indices
-        uint32_t row_idx = maps::flatToRow(cut_index);
-        uint32_t col_idx = maps::flatToCol(cut_index);
-        uint32_t blk_idx = maps::flatToBlk(cut_index);
-
-        // If the cut index is in the group, remove it (there will be at most one instance).
-        // NOTE: using std::find instead of this loop fails to compile on my build system
-        removeFromGroup(&this->row_u_groups[row_idx], cut_index);
-        removeFromGroup(&this->col_u_groups[col_idx], cut_index);
-        removeFromGroup(&this->blk_u_groups[blk_idx], cut_index);
+        uint32_t row_idx = Topo::flatToRow(cut_index);
+        uint32_t col_idx = Topo::flatToCol(cut_index);
+        uint32_t blk_idx = Topo::flatToBlk(cut_index);
+
+        // Clear the member bit of the cut index in each of its groups
+        this->row_u_masks[row_idx] &= ~digitBit(col_idx);
+        this->col_u_masks[col_idx] &= ~digitBit(row_idx);
+        this->blk_u_masks[blk_idx] &= ~digitBit(Topo::flatToBlkPos(cut_index));
     }
 
     /**
@@ -392,9 +775,9 @@ public:
      *
      * @param cut_vector
      */
-    void removeVecFromUGroups(const std::vector<uint32_t> &cut_vector)
+    void removeVecFromUGroups(const IndexStack &cut_vector)
     {
-        for (const uint32_t &cut_index : cut_vector)
+        for (const uint32_t cut_index : cut_vector)
         {
             this->removeIdxFromUGroups(cut_index);
         }
@@ -405,54 +788,28 @@ public:
     //--------------------------------------------------------------------------------------------//
 
     /**
-     * @brief Strikes a value from all members of the group except at the strike index.
+     * @brief For a solved cell specified by index, remove the bit from all of its groups, and
+     * remove the cell from the unsolved groups.
      *
-     * @param group One of the unsolved row, column, or block groups for a specific index
-     * @param strike_idx The index of the value being struck from the group
-     * @param strike_val The value to remove from the group
+     * @param strike_idx Flat index in puzzle
      */
-    void bitRemoveFromUGroup(std::vector<uint32_t> *group, uint32_t strike_idx, uint16_t strike_val)
+    void strikeIdxFromPuzzle(uint32_t strike_idx)
     {
-        uint32_t remove_offset = 9;
-        uint32_t count = 0;
+        Word puzzle_value = this->getValue(strike_idx);
 
-        // Remove the bit from every other member of the group
-        for (auto it = group->begin(); it != group->end(); ++it)
-        {
-            if (strike_idx != *it)
-            {
-                this->data[*it] -= this->data[*it] & strike_val;
-                ++count;
-            }
-            else
-            {
-                remove_offset = count;
-            }
-        }
+        // Remove the struck cell from its groups
+        this->removeIdxFromUGroups(strike_idx);
 
-        // Remove the corresponding struck cell from the group
-        if (remove_offset < 9) // TODO: this check should be unnecessary
+        // Remove the bit from every peer still in the unsolved groups which may take it
+        CellSet u_peers = Topo::PEER_INDEX_SETS[strike_idx] & this->uCells();
+        for (Word bits = puzzle_value; bits != 0; bits &= bits - 1)
         {
-            group->erase(group->begin() + remove_offset);
+            uint32_t digit = utils::lowestBitIndex(bits);
+            this->removeBitFrom(this->digit_cells[digit] & u_peers, digitBit(digit));
         }
-    }
 
-    /**
-     * @brief For a solved cell specified by index, remove the bit from all of its groups, and
-     * remove the cell from the unsolved groups.
-     *
-     * @param strike_idx Flat index in puzzle
-     */
-    void strikeIdxFromPuzzle(uint32_t strike_idx)
-    {
-        uint32_t row_idx = maps::flatToRow(strike_idx);
-        uint32_t col_idx = maps::flatToCol(strike_idx);
-        uint32_t blk_idx = maps::flatToBlk(strike_idx);
-        uint16_t puzzle_value = this->getValue(strike_idx);
-
-        this->bitRemoveFromUGroup(&this->row_u_groups[row_idx], strike_idx, puzzle_value);
-        this->bitRemoveFromUGroup(&this->col_u_groups[col_idx], strike_idx, puzzle_value);
-        this->bitRemoveFromUGroup(&this->blk_u_groups[blk_idx], strike_idx, puzzle_value);
+        // Leaving the unsolved groups changes what the group techniques see, even if no options changed
+        this->dirty_units |= Topo::FLAT_TO_UNITS[strike_idx];
     }
 
     /**
@@ -461,9 +818,9 @@ public:
      *
      * @param strike_idx_vec Flat indices in puzzle
      */
-    void strikeVecFromPuzzle(const std::vector<uint32_t> &strike_idx_vec)
+    void strikeVecFromPuzzle(const IndexStack &strike_idx_vec)
     {
-        for (const uint32_t &strike_idx : strike_idx_vec)
+        for (const uint32_t strike_idx : strike_idx_vec)
         {
             this->strikeIdxFromPuzzle(strike_idx);
         }
@@ -479,273 +836,78 @@ public:
     }
 
     //--------------------------------------------------------------------------------------------//
-    //--- Squeeze functions ----------------------------------------------------------------------//
+    //--- Box/line intersections -----------------------------------------------------------------//
     //--------------------------------------------------------------------------------------------//
 
     /**
-     * @brief Divide every row or column into three sections according to block membership, and identify bits
-     * which are unique to any particular section of the row/column.
+     * @brief Removes each of a set of digits from those of a set of elements which may take it. This is the common
+     * step of both directions of a box/line intersection, once the digits locked into the intersection are known.
      *
-     * @param row_or_col_index
-     * @param is_row
-     * @return std::array<uint16_t, 3>
+     * @param bits The digits, one bit each
+     * @param targets
      */
-    std::array<uint16_t, 3> uniqueBitsBySections(uint32_t row_or_col_index, bool is_row)
+    void removeDigitsFrom(Word bits, const CellSet &targets)
     {
-        // Puzzle values in the row or column
-        std::array<uint16_t *, 9> vals;
-
-        if (is_row)
+        for (; bits != 0; bits &= bits - 1)
         {
-            vals = this->ptrValuesInRow(row_or_col_index);
+            uint32_t digit = utils::lowestBitIndex(bits);
+            this->removeBitFrom(this->digit_cells[digit] & targets, digitBit(digit));
         }
-        else
-        {
-            vals = this->ptrValuesInCol(row_or_col_index);
-        }
-
-        // Determine what bits are present in each section
-        uint16_t section_1_bits = 0;
-        uint16_t section_2_bits = 0;
-        uint16_t section_3_bits = 0;
-        for (uint32_t i = 0; i < 3; ++i)
-        {
-            section_1_bits |= *vals[i];
-            section_2_bits |= *vals[i + 3];
-            section_3_bits |= *vals[i + 6];
-        }
-
-        // Identify any bits unique to a section
-        uint16_t section_1_unq = ((section_2_bits | section_3_bits) ^ 511) & section_1_bits;
-        uint16_t section_2_unq = ((section_1_bits | section_3_bits) ^ 511) & section_2_bits;
-        uint16_t section_3_unq = ((section_1_bits | section_2_bits) ^ 511) & section_3_bits;
-
-        return {section_1_unq, section_2_unq, section_3_unq};
-    }
-
-    /**
-     * @brief Returns the unsolved puzzle values in a given block that are not in the specified row.
-     *
-     * @param blk_index
-     * @param row_index
-     * @return std::vector<uint16_t *>
-     */
-    std::vector<uint16_t *> uBlkValuesNotInRow(uint32_t blk_index, uint32_t row_index)
-    {
-        std::vector<uint16_t *> not_in_row;
-
-        // WE ASSUME THE ROW INTERSECTS THE BLOCK
-        not_in_row.reserve(6);
-
-        // Loop over unsolved elements of the block
-        for (const uint32_t &flat_idx : this->blk_u_groups[blk_index])
-        {
-            // The row index of this element
-            uint32_t i = maps::flatToRow(flat_idx);
-
-            // If this row isn't the one we're trying to avoid, add it to the list
-            if (i != row_index)
-            {
-                not_in_row.push_back(this->ptrValue(flat_idx));
-            }
-        }
-
-        return not_in_row;
-    }
-
-    /**
-     * @brief Returns the unsolved puzzle values in a given block that are not in the specified column.
-     *
-     * @param blk_index
-     * @param col_index
-     * @return std::vector<uint16_t *>
-     */
-    std::vector<uint16_t *> uBlkValuesNotInCol(uint32_t blk_index, uint32_t col_index)
-    {
-        std::vector<uint16_t *> not_in_col;
-
-        // WE ASSUME THE COL INTERSECTS THE BLOCK
-        not_in_col.reserve(6);
-
-        // Loop over unsolved elements of the block
-        for (const uint32_t &flat_idx : this->blk_u_groups[blk_index])
-        {
-            // The col index of this element
-            uint32_t i = maps::flatToCol(flat_idx);
-
-            // If this col isn't the one we're trying to avoid, add the puzzle value
-            if (i != col_index)
-            {
-                not_in_col.push_back(this->ptrValue(flat_idx));
-            }
-        }
-
-        return not_in_col;
     }
 
     //--------------------------------------------------------------------------------------------//
-    //--- Pipe functions -------------------------------------------------------------------------//
+    //--- Bit operations -------------------------------------------------------------------------//
     //--------------------------------------------------------------------------------------------//
 
     /**
-     * @brief Sort all of the unsolved elements of a given block into two groups: those included in a given row, and
-     * those not.
+     * @brief Computes, for every row, column, and block, the bits seen at least once and at least twice.
      *
-     * @param blk_index
-     * @param row_index
-     * @return std::tuple<std::vector<uint16_t *>, std::vector<uint16_t *>>
+     * @param masks
      */
-    std::tuple<std::vector<uint16_t *>, std::vector<uint16_t *>> uBlkValuesSiftRow(uint32_t blk_index, uint32_t row_index)
+    void unitMasks(UnitMasks *masks)
     {
-        std::vector<uint16_t *> in_row;
-        std::vector<uint16_t *> not_in_row;
-
-        // WE ASSUME THE ROWS CORRESPOND TO ROWS THAT THE BLOCK INTERSECTS WITH
-        in_row.reserve(3);
-        not_in_row.reserve(6);
-
-        // Loop over unsolved elements of the block
-        for (const uint32_t &flat_idx : this->blk_u_groups[blk_index])
+        if constexpr (USE_KERNELS)
         {
-            // The col index of this element
-            uint32_t i = maps::flatToRow(flat_idx);
-
-            // Separate elements based on row inclusion
-            if (i == row_index)
-            {
-                in_row.push_back(this->ptrValue(flat_idx));
-            }
-            else
-            {
-                not_in_row.push_back(this->ptrValue(flat_idx));
-            }
+            kernels::active().unitMasks(this->data.data(), masks);
         }
-
-        return {in_row, not_in_row};
-    }
-
-    /**
-     * @brief Sort all of the unsolved elements of a given block into two groups: those included in a given column, and
-     * those not.
-     *
-     * @param blk_index
-     * @param col_index
-     * @return std::tuple<std::vector<uint16_t *>, std::vector<uint16_t *>>
-     */
-    std::tuple<std::vector<uint16_t *>, std::vector<uint16_t *>> uBlkValuesSiftCol(uint32_t blk_index, uint32_t col_index)
-    {
-        std::vector<uint16_t *> in_col;
-        std::vector<uint16_t *> not_in_col;
-
-        // WE ASSUME THE COLS CORRESPOND TO COLS THAT THE BLOCK INTERSECTS WITH
-        in_col.reserve(3);
-        not_in_col.reserve(6);
-
-        // Loop over unsolved elements of the block
-        for (const uint32_t &flat_idx : this->blk_u_groups[blk_index])
+        else
         {
-            // The col index of this element
-            uint32_t i = maps::flatToCol(flat_idx);
-
-            // Separate elements based on col inclusion
-            if (i == col_index)
-            {
-                in_col.push_back(this->ptrValue(flat_idx));
-            }
-            else
+            for (uint32_t unit = 0; unit < Topo::UNITS; ++unit)
             {
-                not_in_col.push_back(this->ptrValue(flat_idx));
+                Word once = 0;
+                Word twice = 0;
+                for (const uint32_t flat_index : Topo::UNIT_TO_FLAT[unit])
+                {
+                    twice |= once & this->data[flat_index];
+                    once |= this->data[flat_index];
+                }
+                masks->once[unit] = once;
+                masks->twice[unit] = twice;
             }
         }
-
-        return {in_col, not_in_col};
     }
 
     /**
-     * @brief Return all of the values for unsolved elements in a given row which are not in a given block.
+     * @brief For a given unsolved flat index, determine which of its bits are not included among any other
+     * unsolved member of its row, column, or block.
      *
-     * @param row_index
-     * @param blk_index
-     * @return std::vector<uint16_t *>
-     */
-    std::vector<uint16_t *> uRowValuesNotInBlk(uint32_t row_index, uint32_t blk_index)
-    {
-        std::vector<uint16_t *> not_in_blk;
-
-        // WE ASSUME THE ROWS CORRESPOND TO ROWS THAT THE BLOCK INTERSECTS WITH
-        not_in_blk.reserve(6);
-
-        // Loop over unsolved elements of the row
-        for (const uint32_t &flat_idx : this->row_u_groups[row_index])
-        {
-            // The blk index of this element
-            uint32_t g = maps::flatToBlk(flat_idx);
-
-            // Add if the element is not in the blk
-            if (g != blk_index)
-            {
-                not_in_blk.push_back(this->ptrValue(flat_idx));
-            }
-        }
-
-        return not_in_blk;
-    }
-
-    /**
-     * @brief Return all of the values for unsolved elements in a given column which are not in a given block.
+     * Because every solved element has already been struck from its groups, a bit of an unsolved element that
+     * is seen only once in a whole unit is seen only at that element.
      *
-     * @param col_index
-     * @param blk_index
-     * @return std::vector<uint16_t *>
+     * @param flat_index
+     * @param masks Unit masks computed by unitMasks()
+     * @return Word
      */
-    std::vector<uint16_t *> uColValuesNotInBlk(uint32_t col_index, uint32_t blk_index)
+    Word uniqueUGroupBits(uint32_t flat_index, const UnitMasks &masks)
     {
-        std::vector<uint16_t *> not_in_blk;
-
-        // WE ASSUME THE COLS CORRESPOND TO COLS THAT THE BLOCK INTERSECTS WITH
-        not_in_blk.reserve(6);
-
-        // Loop over unsolved elements of the col
-        for (const uint32_t &flat_idx : this->col_u_groups[col_index])
-        {
-            // The blk index of this element
-            uint32_t g = maps::flatToBlk(flat_idx);
-
-            // Add if the element is not in the blk
-            if (g != blk_index)
-            {
-                not_in_blk.push_back(this->ptrValue(flat_idx));
-            }
-        }
-
-        return not_in_blk;
-    }
+        uint32_t row = Topo::flatToRow(flat_index);
+        uint32_t col = SIDE + Topo::flatToCol(flat_index);
+        uint32_t blk = 2 * SIDE + Topo::flatToBlk(flat_index);
 
-    //--------------------------------------------------------------------------------------------//
-    //--- Bit operations -------------------------------------------------------------------------//
-    //--------------------------------------------------------------------------------------------//
+        Word unique_bits = (masks.once[row] & ~masks.twice[row]) | (masks.once[col] & ~masks.twice[col]) |
+                               (masks.once[blk] & ~masks.twice[blk]);
 
-    uint16_t uniqueUGroupBits(uint32_t flat_index){
-        uint16_t unique_bits_row = this->getValue(flat_index);
-        uint16_t unique_bits_col = this->getValue(flat_index);
-        uint16_t unique_bits_blk = this->getValue(flat_index);
-        for (const uint32_t &row_neighbor_idx : *this->ptrRowUGroup(flat_index))
-        {
-            uint16_t same_idx = (flat_index - row_neighbor_idx) == 0;
-            unique_bits_row &= (unique_bits_row * same_idx) | (unique_bits_row ^ this->getValue(row_neighbor_idx));
-        }
-        for (const uint32_t &col_neighbor_idx : *this->ptrColUGroup(flat_index))
-        {
-            uint16_t same_idx = (flat_index - col_neighbor_idx) == 0;
-            unique_bits_col &= (unique_bits_col * same_idx) | (unique_bits_col ^ this->getValue(col_neighbor_idx));
-        }
-        for (const uint32_t &blk_neighbor_idx : *this->ptrBlkUGroup(flat_index))
-        {
-            uint16_t same_idx = (flat_index - blk_neighbor_idx) == 0;
-            unique_bits_blk &= (unique_bits_blk * same_idx) | (unique_bits_blk ^ this->getValue(blk_neighbor_idx));
-        }
-
-        return unique_bits_row | unique_bits_col | unique_bits_blk;
+        return this->getValue(flat_index) & unique_bits;
     }
 
     /**
@@ -753,14 +915,14 @@ public:
      * any other unsolved row members.
      *
      * @param flat_index
-     * @return uint16_t
+     * @return Word
      */
-    uint16_t uniqueURowBits(uint32_t flat_index)
+    Word uniqueURowBits(uint32_t flat_index)
     {
-        uint16_t unique_bits = this->getValue(flat_index);
-        for (const uint32_t &row_neighbor_idx : *this->ptrRowUGroup(flat_index))
+        Word unique_bits = this->getValue(flat_index);
+        for (const uint32_t row_neighbor_idx : this->rowUGroupOf(flat_index))
         {
-            uint16_t same_idx = (flat_index - row_neighbor_idx) == 0;
+            Word same_idx = (flat_index - row_neighbor_idx) == 0;
             unique_bits &= (unique_bits * same_idx) | (unique_bits ^ this->getValue(row_neighbor_idx));
         }
 
@@ -772,14 +934,14 @@ public:
      * any other unsolved col members.
      *
      * @param flat_index
-     * @return uint16_t
+     * @return Word
      */
-    uint16_t uniqueUColBits(uint32_t flat_index)
+    Word uniqueUColBits(uint32_t flat_index)
     {
-        uint16_t unique_bits = this->getValue(flat_index);
-        for (const uint32_t &col_neighbor_idx : *this->ptrColUGroup(flat_index))
+        Word unique_bits = this->getValue(flat_index);
+        for (const uint32_t col_neighbor_idx : this->colUGroupOf(flat_index))
         {
-            uint16_t same_idx = (flat_index - col_neighbor_idx) == 0;
+            Word same_idx = (flat_index - col_neighbor_idx) == 0;
             unique_bits &= (unique_bits * same_idx) | (unique_bits ^ this->getValue(col_neighbor_idx));
         }
 
@@ -791,14 +953,14 @@ public:
      * any other unsolved blk members.
      *
      * @param flat_index
-     * @return uint16_t
+     * @return Word
      */
-    uint16_t uniqueUBlkBits(uint32_t flat_index)
+    Word uniqueUBlkBits(uint32_t flat_index)
     {
-        uint16_t unique_bits = this->getValue(flat_index);
-        for (const uint32_t &blk_neighbor_idx : *this->ptrBlkUGroup(flat_index))
+        Word unique_bits = this->getValue(flat_index);
+        for (const uint32_t blk_neighbor_idx : this->blkUGroupOf(flat_index))
         {
-            uint16_t same_idx = (flat_index - blk_neighbor_idx) == 0;
+            Word same_idx = (flat_index - blk_neighbor_idx) == 0;
             unique_bits &= (unique_bits * same_idx) | (unique_bits ^ this->getValue(blk_neighbor_idx));
         }
 
@@ -816,7 +978,7 @@ public:
     // {
     //     uint16_t neighbor_bits = 0;
     //     // Accumulate all of the bits found amongst row neighbors
-    //     for (const uint32_t &neighbor_idx : *this->ptrRowUGroup(flat_index))
+    //     for (const uint32_t &neighbor_idx : this->rowUGroupOf(flat_index))
     //     {
     //         if (flat_index != neighbor_idx)
     //         {
@@ -838,7 +1000,7 @@ public:
     // {
     //     uint16_t neighbor_bits = 0;
     //     // Accumulate all of the bits found amongst col neighbors
-    //     for (const uint32_t &neighbor_idx : *this->ptrColUGroup(flat_index))
+    //     for (const uint32_t &neighbor_idx : this->colUGroupOf(flat_index))
     //     {
     //         if (flat_index != neighbor_idx)
     //         {
@@ -860,7 +1022,7 @@ public:
     // {
     //     uint16_t neighbor_bits = 0;
     //     // Accumulate all of the bits found amongst blk neighbors
-    //     for (const uint32_t &neighbor_idx : *this->ptrBlkUGroup(flat_index))
+    //     for (const uint32_t &neighbor_idx : this->blkUGroupOf(flat_index))
     //     {
     //         if (flat_index != neighbor_idx)
     //         {
@@ -872,54 +1034,87 @@ public:
     // }
 
     /**
-     * @brief
+     * @brief Looks for a digit which has exactly two possible places among the unsolved members of a group. If
+     * one is found, the branch is filled with those two places.
      *
-     * @return std::tuple<std::vector<uint16_t>, std::vector<uint32_t>, std::vector<uint32_t>> The bit index, multiplicity, and locations in the puzzle
+     * @param group The unsolved members of a row, column, or block
+     * @param branch
+     * @return true if such a digit was found
      */
-    std::tuple<std::vector<uint16_t>, std::vector<std::vector<uint32_t>>> leastPopularBit()
+    bool digitPairInGroup(const CellSet &group, Branch *branch)
     {
-        std::array<uint16_t, 9> bits;
-        std::array<uint32_t, 9> multiplicity = {};
-        std::array<std::vector<uint32_t>, 9> locations;
+        // Take the lowest such digit and record where it can go
+        for (uint32_t digit = 0; digit < SIDE; ++digit)
+        {
+            CellSet places = this->digit_cells[digit] & group;
+            if (places.size() == 2)
+            {
+                branch->count = 0;
+                for (const uint32_t flat_idx : places)
+                {
+                    branch->cells[branch->count] = static_cast<CellIndex>(flat_idx);
+                    branch->bits[branch->count] = digitBit(digit);
+                    ++branch->count;
+                }
+                return true;
+            }
+        }
+
+        return false;
+    }
 
-        // Count bit multiplicity for each bit amongst the unsolved elements
-        for (const uint32_t &unsolved_idx : this->unsolved_indices)
+    /**
+     * @brief Chooses the set of alternatives with the fewest options to branch a search on: either the possible
+     * values of the unsolved element with the fewest bits, or the possible places of a digit within a row, column,
+     * or block when no element is down to two values. Exactly one of the alternatives is part of any solution.
+     *
+     * @param branch Filled with the chosen alternatives
+     */
+    void fewestOptionsBranch(Branch *branch)
+    {
+        // Find the unsolved element with the fewest remaining bits
+        uint32_t best_idx = 0;
+        uint32_t best_count = SIDE + 1;
+        for (const uint32_t unsolved_idx : this->unsolved_indices)
         {
-            for (uint16_t i = 0; i < 9; ++i)
+            uint32_t count = Topo::countBits(this->getValue(unsolved_idx));
+            if (count < best_count)
             {
-                bits[i] = 1 << i;
+                best_idx = unsolved_idx;
+                best_count = count;
 
-                if ((this->getValue(unsolved_idx) & (1 << i)) != 0)
+                // Can't do better than two options
+                if (count <= 2)
                 {
-                    multiplicity[i]++;
-                    locations[i].push_back(unsolved_idx);
+                    break;
                 }
             }
         }
 
-        // Determine the index map which sort multiplicity by ascending value
-        // (least popular bits first)
-        std::vector<size_t> sort_map(9);
-        std::iota(sort_map.begin(), sort_map.end(), 0);
-        std::sort(sort_map.begin(), sort_map.end(), [&](size_t a, size_t b)
-                  { return multiplicity[a] < multiplicity[b]; });
-
-        // We want to remove anything with multiplicity of zero, and order the return
-        // by ascending multiplicity
-        std::vector<uint16_t> bits_v;
-        std::vector<std::vector<uint32_t>> loc_v;
-        bits_v.reserve(9);
-        loc_v.reserve(9);
-        for (auto i : sort_map)
+        // If no element is down to two options, a digit with two places in some group is the better branch
+        if (best_count > 2)
         {
-            if (multiplicity[i] > 0)
+            CellSet u_cells = this->uCells();
+            for (uint32_t i = 0; i < SIDE; ++i)
             {
-                bits_v.push_back(bits[i]);
-                loc_v.push_back(locations[i]);
+                if (this->digitPairInGroup(Topo::UNIT_INDEX_SETS[i] & u_cells, branch) ||
+                    this->digitPairInGroup(Topo::UNIT_INDEX_SETS[SIDE + i] & u_cells, branch) ||
+                    this->digitPairInGroup(Topo::UNIT_INDEX_SETS[2 * SIDE + i] & u_cells, branch))
+                {
+                    return;
+                }
             }
         }
 
-        return {bits_v, loc_v};
+        // Branch on each of the possible values of the chosen element
+        Word val = this->getValue(best_idx);
+        branch->count = 0;
+        for (Word bits = val; bits != 0; bits &= bits - 1)
+        {
+            branch->cells[branch->count] = static_cast<CellIndex>(best_idx);
+            branch->bits[branch->count] = digitBit(utils::lowestBitIndex(bits));
+            ++branch->count;
+        }
     }
 
     //--------------------------------------------------------------------------------------------//
@@ -939,30 +1134,57 @@ public:
     //--- Printing functions ---------------------------------------------------------------------//
     //--------------------------------------------------------------------------------------------//
 
+    /**
+     * @brief Writes the puzzle in the conventional one character per element form, with . for any unsolved
+     * element.
+     *
+     * @param out Space for at least CELLS characters
+     */
+    void writeBenchmarkString(char *out)
+    {
+        for (uint32_t i = 0; i < CELLS; ++i)
+        {
+            out[i] = utils::valueToChar(wordToValue(this->getValue(i)));
+        }
+    }
+
+    /**
+     * @brief Writes the puzzle as one value per element, with 0 for any unsolved element.
+     *
+     * @param out Space for at least CELLS values
+     */
+    void writeValues(uint8_t *out)
+    {
+        for (uint32_t i = 0; i < CELLS; ++i)
+        {
+            out[i] = static_cast<uint8_t>(wordToValue(this->getValue(i)));
+        }
+    }
+
     void printPuzzle(bool nine_bit = true)
     {
-        for (uint32_t i = 0; i < 81; ++i)
+        for (uint32_t i = 0; i < CELLS; ++i)
         {
             if (nine_bit)
             {
-                std::cout << std::setw(3) << this->getValue(i) << " ";
+                std::cout << std::setw((SIDE <= 9) ? 3 : 8) << this->getValue(i) << " ";
             }
             else
             {
-                std::cout << std::setw(3) << utils::nineBitToValue(this->getValue(i)) << " ";
+                std::cout << std::setw(3) << wordToValue(this->getValue(i)) << " ";
             }
-            if ((i + 1) % 9 == 0)
+            if ((i + 1) % SIDE == 0)
             {
                 std::cout << std::endl;
 
-                if ((i + 1) % 27 == 0)
+                if ((i + 1) % (SIDE * BoxSize) == 0)
                 {
                     std::cout << "\n"
                               << std::endl;
                     std::cout.flush();
                 }
             }
-            else if ((i + 1) % 3 == 0)
+            else if ((i + 1) % BoxSize == 0)
             {
                 std::cout << " ";
                 std::cout.flush();
@@ -976,7 +1198,7 @@ public:
 
     void printUnsolved()
     {
-        for (const uint32_t &index : this->unsolved_indices)
+        for (const uint32_t index : this->unsolved_indices)
         {
             std::cout << (int)index << " ";
         }
@@ -984,11 +1206,12 @@ public:
         std::cout << std::endl;
     }
 
-    void printUGroup(const std::array<std::vector<uint32_t>, 9> &group)
+    void printUGroup(const std::array<Word, SIDE> &group_masks,
+                     const std::array<std::array<uint32_t, SIDE>, SIDE> &group_flat)
     {
-        for (uint32_t i = 0; i < 9; ++i)
+        for (uint32_t i = 0; i < SIDE; ++i)
         {
-            for (const uint32_t &elem : group[i])
+            for (const uint32_t elem : UnitIndices(group_masks[i], group_flat[i]))
             {
                 std::cout << std::setw(2) << (int)elem << " ";
                 std::cout.flush();
@@ -1000,10 +1223,10 @@ public:
 
     void printRowMap()
     {
-        for (uint32_t k = 0; k < 81; ++k)
+        for (uint32_t k = 0; k < CELLS; ++k)
         {
-            std::cout << std::setw(2) << (int)k << " -> " << (int)maps::flatToRow(k) << "     ";
-            if ((k + 1) % 9 == 0)
+            std::cout << std::setw(2) << (int)k << " -> " << (int)Topo::flatToRow(k) << "     ";
+            if ((k + 1) % SIDE == 0)
             {
                 std::cout << std::endl;
             }
@@ -1016,10 +1239,10 @@ public:
 
     void printColMap()
     {
-        for (uint32_t k = 0; k < 81; ++k)
+        for (uint32_t k = 0; k < CELLS; ++k)
         {
-            std::cout << std::setw(2) << (int)k << " -> " << (int)maps::flatToCol(k) << "     ";
-            if ((k + 1) % 9 == 0)
+            std::cout << std::setw(2) << (int)k << " -> " << (int)Topo::flatToCol(k) << "     ";
+            if ((k + 1) % SIDE == 0)
             {
                 std::cout << std::endl;
             }
@@ -1032,10 +1255,10 @@ public:
 
     void printBlkMap()
     {
-        for (uint32_t k = 0; k < 81; ++k)
+        for (uint32_t k = 0; k < CELLS; ++k)
         {
-            std::cout << std::setw(2) << (int)k << " -> " << (int)maps::flatToBlk(k) << "     ";
-            if ((k + 1) % 9 == 0)
+            std::cout << std::setw(2) << (int)k << " -> " << (int)Topo::flatToBlk(k) << "     ";
+            if ((k + 1) % SIDE == 0)
             {
                 std::cout << std::endl;
             }
@@ -1047,4 +1270,9 @@ public:
     }
 };
 
+// The standard 9x9 puzzle
+using Puzzle = BasicPuzzle<3>;
+
+static_assert(std::is_trivially_copyable<Puzzle>::value, "Puzzle copies should be a plain memcpy");
+
 #endif
\ No newline at end of file
@@ -9,13 +9,34 @@
 
 #endif
 
+#include "batch.hpp"
+#include "cache.hpp"
+#include "dataset.hpp"
+#include "packed.hpp"
+#include "parser.hpp"
 #include "solver.hpp"
+#include "store.hpp"
+#include <chrono>
+#include <cstdio>
 #include <iostream>
 #include <tuple>
+#include <unordered_map>
 #include <list>
 #include <array>
+#include <memory>
+#include <vector>
 
-void runConsoleSolve(int maxGuesses, bool nine_bit_print = false)
+// Batch output is collected in a buffer of this size and written out whenever it fills up
+constexpr size_t BATCH_OUTPUT_BUFFER_SIZE = 1 << 20;
+
+// Batch input is solved this many lines at a time
+constexpr size_t BATCH_CHUNK_SIZE = 256;
+
+// Written in place of a solution for input that can't be parsed or solved
+constexpr std::string_view BATCH_FAILURE_MARKER = "FAIL";
+
+void runConsoleSolve(uint32_t maxGuesses, bool nine_bit_print = false,
+                     Solver::Pipeline pipeline = Solver::Pipeline::STANDARD)
 {
     std::string input_cluestring;
     std::cout << "Enter a clue string for simple src: ";
@@ -33,14 +54,457 @@ void runConsoleSolve(int maxGuesses, bool nine_bit_print = false)
     std::cout.flush();
 
     Solver solver = Solver(&puzzle);
-    solver.solve(maxGuesses);
+    solver.solve(maxGuesses, pipeline);
 
     puzzle.printPuzzle(nine_bit_print);
 }
 
+/**
+ * @brief Solves a chunk of batch input. 9x9 puzzles go through the batch solver, and the larger ones through the
+ * scalar solver one at a time. The puzzles of the batch solver share their lanes, so each is given an equal share of
+ * the chunk's time.
+ *
+ * @tparam BoxSize
+ * @param puzzles The puzzles of the lines which could be parsed, in order
+ * @param maxGuesses
+ * @param pipeline
+ * @param results Set to what happened to each puzzle
+ */
+template <uint32_t BoxSize>
+void solveBatchChunk(std::vector<BasicPuzzle<BoxSize>> *puzzles, uint32_t maxGuesses, Solver::Pipeline pipeline,
+                     std::vector<packed::Result> *results)
+{
+    using Solver = BasicSolver<BoxSize>;
+    using clock = std::chrono::steady_clock;
+
+    size_t count = puzzles->size();
+    results->assign(count, packed::Result{});
+    if (count == 0)
+    {
+        return;
+    }
+
+    if constexpr (BoxSize == 3)
+    {
+        std::array<uint32_t, BATCH_CHUNK_SIZE> guesses;
+        BatchSolver batch_solver(pipeline);
+        auto start = clock::now();
+        batch_solver.solve(puzzles->data(), count, maxGuesses, guesses.data());
+        auto stop = clock::now();
+
+        std::chrono::nanoseconds elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start);
+        uint64_t share_ns = static_cast<uint64_t>(elapsed.count()) / count;
+        for (size_t i = 0; i < count; ++i)
+        {
+            (*results)[i].guesses = guesses[i];
+            (*results)[i].time_ns = share_ns;
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            Solver solver = Solver(&(*puzzles)[i]);
+            auto start = clock::now();
+            solver.solve(maxGuesses, pipeline);
+            auto stop = clock::now();
+
+            (*results)[i].guesses = solver.numGuesses();
+            std::chrono::nanoseconds elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start);
+            (*results)[i].time_ns = static_cast<uint64_t>(elapsed.count());
+        }
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        (*results)[i].solved = (*puzzles)[i].validSolution();
+    }
+}
+
+/**
+ * @brief Solves puzzles from a file (or from text on standard input when no file is given), writing either one line
+ * of text per puzzle to standard output, or one record per puzzle to a packed results file (see packed.hpp). The
+ * file may be text, with one puzzle per line, or a packed puzzle file. There are no prompts and no flushes until the
+ * output buffer fills, so this can sit in a pipeline. Puzzles are read and solved a chunk at a time, so that 9x9
+ * puzzles can be solved together by the batch solver.
+ *
+ * With a result cache, each puzzle is first looked up by its clues, and only the misses are solved. A puzzle whose
+ * clues conflict is cached as unsolvable. The cache's counters are reported on standard error at the end. With
+ * canonical keys, 9x9 puzzles are looked up by their canonical form instead, so a puzzle also hits on any symmetry of
+ * it solved before, and gets that puzzle's solution mapped back onto it. A puzzle with more than one solution may
+ * then get a different one than solving it would give, and with a guess limit, a puzzle takes the verdict of
+ * whichever symmetry of it was solved first. A line which repeats a puzzle (or with canonical keys, a symmetry of a
+ * puzzle) still waiting to be solved with its chunk reuses that puzzle's outcome, and counts as a hit.
+ *
+ * With a solution store, puzzles that miss the cache (if any) are looked up in the store, and the puzzles solved are
+ * added to it, so results carry over from one run to the next. 9x9 puzzles are always keyed by canonical form then.
+ * The store's counters are reported on standard error at the end too.
+ *
+ * @tparam BoxSize
+ * @param maxGuesses
+ * @param input_path The file to read, or empty for standard input
+ * @param pipeline
+ * @param results_path The packed results file to write, or empty for text on standard output
+ * @param cache_capacity The most results to cache, or 0 for no cache
+ * @param canonical_keys Whether to key the cache by canonical forms
+ * @param store_path The solution store to use, or empty for none
+ * @return int
+ */
+template <uint32_t BoxSize = 3>
+int runBatchSolve(uint32_t maxGuesses, const std::string &input_path,
+                  Solver::Pipeline pipeline = Solver::Pipeline::STANDARD, const std::string &results_path = "",
+                  size_t cache_capacity = 0, bool canonical_keys = false, const std::string &store_path = "")
+{
+    using Puzzle = BasicPuzzle<BoxSize>;
+    using Layout = packed::Layout<BoxSize>;
+    using Cache = ResultCache<BoxSize>;
+    using Store = SolutionStore<BoxSize>;
+    using Solution = std::array<uint8_t, Puzzle::CELLS>;
+    using clock = std::chrono::steady_clock;
+
+    // Where the outcome of a line comes from: nowhere, as it couldn't be read or its clues conflict; the cache, the
+    // store, or an earlier line of the chunk; or the puzzle solved with the rest of the chunk. The index is into the
+    // hits or the puzzles respectively.
+    enum class Source
+    {
+        FAILED,
+        CACHED,
+        SOLVED
+    };
+    struct Line
+    {
+        Source source;
+        size_t index;
+    };
+    struct Hit
+    {
+        Solution solution;
+        packed::Result result;
+    };
+    // A hit on a puzzle of the chunk, which is filled in once the chunk is solved, along with how the line maps to
+    // the canonical form (when keys are canonical)
+    struct Repeat
+    {
+        size_t hit;
+        size_t puzzle;
+        Canonicalizer::Transform transform;
+    };
+
+    std::string output;
+    std::unique_ptr<packed::Writer> writer;
+    if (results_path.empty())
+    {
+        output.reserve(BATCH_OUTPUT_BUFFER_SIZE);
+    }
+    else
+    {
+        writer.reset(new packed::Writer(results_path, packed::RESULT_MAGIC, Layout::SIDE, Layout::RESULT_RECORD_SIZE));
+    }
+
+    if (canonical_keys && (BoxSize != 3))
+    {
+        throw std::runtime_error("Only 9x9 puzzles have canonical forms");
+    }
+
+    std::unique_ptr<Cache> cache;
+    if (cache_capacity > 0)
+    {
+        cache.reset(new Cache(cache_capacity));
+    }
+    std::unique_ptr<Store> store;
+    if (!store_path.empty())
+    {
+        store.reset(new Store(store_path, maxGuesses, pipeline));
+        canonical_keys = (BoxSize == 3);
+        if (!store->isWritable())
+        {
+            std::cerr << "Solution store is open for writing elsewhere, so it is only read from" << std::endl;
+        }
+    }
+    Canonicalizer canonicalizer;
+
+    std::vector<Line> lines;
+    std::vector<Hit> hits;
+    std::vector<Puzzle> puzzles;
+    std::vector<typename Cache::Key> keys;
+    std::vector<Canonicalizer::Transform> transforms;
+    std::vector<packed::Result> results;
+    std::vector<Solution> solutions;
+    std::vector<Repeat> repeats;
+    std::unordered_map<typename Cache::Key, size_t, typename Cache::KeyHash> pending;
+    uint64_t repeat_count = 0;
+    lines.reserve(BATCH_CHUNK_SIZE);
+    hits.reserve(BATCH_CHUNK_SIZE);
+    puzzles.reserve(BATCH_CHUNK_SIZE);
+    keys.reserve(BATCH_CHUNK_SIZE);
+    transforms.reserve(BATCH_CHUNK_SIZE);
+
+    // Writes out the outcome of each line of the chunk
+    auto writeChunk = [&]()
+    {
+        const Solution blank{};
+        std::array<uint8_t, Layout::RESULT_RECORD_SIZE> record;
+
+        for (const Line &line : lines)
+        {
+            const Solution *solution = &blank;
+            packed::Result result{};
+            if (line.source == Source::CACHED)
+            {
+                solution = &hits[line.index].solution;
+                result = hits[line.index].result;
+            }
+            else if (line.source == Source::SOLVED)
+            {
+                solution = &solutions[line.index];
+                result = results[line.index];
+            }
+
+            if (writer)
+            {
+                Layout::packResult(solution->data(), result, record.data());
+                writer->append(record.data());
+            }
+            else
+            {
+                if (result.solved)
+                {
+                    for (const uint8_t value : *solution)
+                    {
+                        output.push_back(utils::valueToChar(value));
+                    }
+                }
+                else
+                {
+                    output.append(BATCH_FAILURE_MARKER);
+                }
+                output.push_back('\n');
+            }
+        }
+    };
+
+    auto solveChunk = [&]()
+    {
+        solveBatchChunk<BoxSize>(&puzzles, maxGuesses, pipeline, &results);
+        solutions.resize(puzzles.size());
+        for (size_t i = 0; i < puzzles.size(); ++i)
+        {
+            puzzles[i].writeValues(solutions[i].data());
+            if (!cache && !store)
+            {
+                continue;
+            }
+
+            // The cache and the store hold solutions on the canonical side
+            const uint8_t *kept_solution = solutions[i].data();
+            Solution canonical_solution;
+            if constexpr (BoxSize == 3)
+            {
+                if (canonical_keys)
+                {
+                    transforms[i].apply(solutions[i].data(), canonical_solution.data());
+                    kept_solution = canonical_solution.data();
+                }
+            }
+            if (cache)
+            {
+                cache->insert(keys[i], kept_solution, results[i].solved);
+            }
+            if (store)
+            {
+                store->insert(keys[i], kept_solution, results[i]);
+            }
+        }
+
+        for (const Repeat &repeat : repeats)
+        {
+            Hit &hit = hits[repeat.hit];
+            hit.result.solved = results[repeat.puzzle].solved;
+            if (!hit.result.solved)
+            {
+                continue;
+            }
+
+            hit.solution = solutions[repeat.puzzle];
+            if constexpr (BoxSize == 3)
+            {
+                if (canonical_keys)
+                {
+                    Solution canonical_solution;
+                    transforms[repeat.puzzle].apply(solutions[repeat.puzzle].data(), canonical_solution.data());
+                    repeat.transform.invert(canonical_solution.data(), hit.solution.data());
+                }
+            }
+        }
+
+        writeChunk();
+        lines.clear();
+        hits.clear();
+        puzzles.clear();
+        keys.clear();
+        transforms.clear();
+        repeats.clear();
+        pending.clear();
+        if (output.size() > BATCH_OUTPUT_BUFFER_SIZE - BATCH_CHUNK_SIZE * (Puzzle::CELLS + 1))
+        {
+            std::fwrite(output.data(), 1, output.size(), stdout);
+            output.clear();
+        }
+    };
+
+    auto addValues = [&](bool read, const uint8_t *values)
+    {
+        if (!read)
+        {
+            lines.push_back(Line{Source::FAILED, 0});
+        }
+        else
+        {
+            typename Cache::Key key{};
+            Canonicalizer::Transform transform{};
+            bool hit = false;
+            if (cache || store)
+            {
+                auto start = clock::now();
+                hits.emplace_back();
+                Hit &found = hits.back();
+
+                // Found solutions are on the canonical side, with canonical keys, and need mapping back
+                Solution canonical_solution;
+                uint8_t *found_solution = found.solution.data();
+                if (!canonical_keys)
+                {
+                    key = Cache::makeKey(values);
+                }
+                else if constexpr (BoxSize == 3)
+                {
+                    key = Cache::makeCanonicalKey(values, &canonicalizer, &transform);
+                    found_solution = canonical_solution.data();
+                }
+
+                auto repeated = pending.find(key);
+                if (repeated != pending.end())
+                {
+                    repeats.push_back(Repeat{hits.size() - 1, repeated->second, transform});
+                    ++repeat_count;
+                    hit = true;
+                }
+                else
+                {
+                    hit = cache && cache->find(key, found_solution, &found.result.solved);
+                }
+                if (!hit && store)
+                {
+                    packed::Result stored{};
+                    hit = store->find(key, found_solution, &stored);
+                    found.result.solved = stored.solved;
+                    if (hit && cache)
+                    {
+                        cache->insert(key, found_solution, stored.solved);
+                    }
+                }
+                if constexpr (BoxSize == 3)
+                {
+                    if (hit && found.result.solved && canonical_keys)
+                    {
+                        transform.invert(canonical_solution.data(), found.solution.data());
+                    }
+                }
+                auto stop = clock::now();
+                std::chrono::nanoseconds elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start);
+
+                if (hit)
+                {
+                    hits.back().result.time_ns = static_cast<uint64_t>(elapsed.count());
+                    lines.push_back(Line{Source::CACHED, hits.size() - 1});
+                }
+                else
+                {
+                    hits.pop_back();
+                }
+            }
+
+            if (!hit)
+            {
+                puzzles.emplace_back();
+                if (puzzles.back().addClueValues(values))
+                {
+                    lines.push_back(Line{Source::SOLVED, puzzles.size() - 1});
+                    if (cache || store)
+                    {
+                        keys.push_back(key);
+                        transforms.push_back(transform);
+                        pending.emplace(key, puzzles.size() - 1);
+                    }
+                }
+                else
+                {
+                    puzzles.pop_back();
+                    lines.push_back(Line{Source::FAILED, 0});
+                    if (cache)
+                    {
+                        cache->insert(key, nullptr, false);
+                    }
+                }
+            }
+        }
+
+        if (lines.size() == BATCH_CHUNK_SIZE)
+        {
+            solveChunk();
+        }
+    };
+
+    Solution values;
+    if (input_path.empty())
+    {
+        std::ios::sync_with_stdio(false);
+        std::string line;
+        while (std::getline(std::cin, line))
+        {
+            addValues(parser::readValues<BoxSize>(line, values.data()), values.data());
+        }
+    }
+    else
+    {
+        Dataset dataset(input_path);
+        dataset.requireSide<BoxSize>();
+        for (size_t i = 0; i < dataset.size(); ++i)
+        {
+            addValues(dataset.readValues<BoxSize>(i, values.data()), values.data());
+        }
+    }
+    solveChunk();
+
+    if (writer)
+    {
+        writer->finish();
+    }
+    else
+    {
+        std::fwrite(output.data(), 1, output.size(), stdout);
+        std::fflush(stdout);
+    }
+
+    if (cache)
+    {
+        CacheStats stats = cache->stats();
+        std::cerr << "Result cache: " << stats.hits + repeat_count << " hits, " << stats.misses << " misses, " << stats.evictions
+                  << " evictions" << std::endl;
+    }
+    if (store)
+    {
+        StoreStats stats = store->stats();
+        std::cerr << "Solution store: " << stats.hits + (cache ? 0 : repeat_count) << " hits, " << stats.misses << " misses, " << stats.inserts
+                  << " added, " << store->size() << " in all" << std::endl;
+    }
+
+    return 0;
+}
+
 #if defined(BUILT_WITH_QT5)
 
-int runGuiSolve(int maxGuesses, int argc, char *argv[])
+int runGuiSolve(uint32_t maxGuesses, int argc, char *argv[])
 {
     QApplication app(argc, argv);
     MainWindow window(nullptr, maxGuesses);
@@ -3,16 +3,257 @@
 #define SUDOFUN_SOLVER_CLASS_HEADER
 
 #include "puzzle.hpp"
+#include "stats.hpp"
 
-class Solver
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#if defined(SUDOFUN_SOLVER_STATS)
+#include <chrono>
+#endif
+
+/**
+ * @brief A sequence of solving techniques, given as Solver::Technique values, which the reduce loop applies in
+ * order on every pass. Each pipeline is a distinct type, so the loop for each compiles to a straight line of
+ * technique calls.
+ */
+template <uint32_t... Steps>
+struct TechniquePipeline
+{
+};
+
+/**
+ * @brief The parts of the solver shared by every puzzle size: the techniques, the pipelines built from them, and
+ * their names.
+ */
+struct SolverBase
+{
+    static constexpr uint32_t UNLIMITED_GUESSES = UINT32_MAX;
+
+    // The solving techniques, in the order the solve stack applies them (guessing being the last resort)
+    enum Technique : uint32_t
+    {
+        STRIKE = 1 << 0,
+        UNIQUE = 1 << 1,
+        SQUEEZE = 1 << 2,
+        PIPE = 1 << 3,
+        SUBSET = 1 << 4,
+        FISH = 1 << 5,
+        GUESS = 1 << 6,
+    };
+
+    // The standard pipeline is the stack of singles and block/line techniques, with a strike after each to follow
+    // up on whatever it solved. The throughput pipeline keeps only the singles, which is all that easy puzzles need
+    // and leaves anything harder to the search. The deep pipeline adds the subset and fish techniques, which cost
+    // more per pass but save guesses on hard puzzles.
+    using StandardPipeline = TechniquePipeline<STRIKE, UNIQUE, STRIKE, SQUEEZE, STRIKE, PIPE>;
+    using ThroughputPipeline = TechniquePipeline<STRIKE, UNIQUE>;
+    using DeepPipeline = TechniquePipeline<STRIKE, UNIQUE, STRIKE, SQUEEZE, STRIKE, PIPE, STRIKE, SUBSET, FISH>;
+
+    // The prebuilt pipelines, for choosing one at runtime
+    enum class Pipeline : uint32_t
+    {
+        STANDARD,
+        THROUGHPUT,
+        DEEP,
+    };
+
+    static constexpr std::array<const char *, 3> PIPELINE_NAMES = {"standard", "throughput", "deep"};
+
+    // The largest naked or hidden subset looked for. Any larger naked subset among n unsolved members of a group
+    // is the complement of a hidden subset of at most this size, and vice versa, so nothing is missed. The same
+    // goes for fish (jellyfish being the largest) between rows and columns.
+    static constexpr uint32_t MAX_SUBSET_SIZE = 4;
+
+    /**
+     * @brief Looks up a prebuilt pipeline by name.
+     *
+     * @param name
+     * @return Pipeline
+     */
+    static Pipeline parsePipeline(const std::string &name)
+    {
+        for (uint32_t n = 0; n < PIPELINE_NAMES.size(); ++n)
+        {
+            if (name == PIPELINE_NAMES[n])
+            {
+                return static_cast<Pipeline>(n);
+            }
+        }
+        throw std::invalid_argument("Unknown pipeline: " + name);
+    }
+};
+
+/**
+ * @brief Solves a puzzle made of BoxSize x BoxSize blocks, with the same techniques and pipelines for every size.
+ *
+ * @tparam BoxSize
+ */
+template <uint32_t BoxSize>
+class BasicSolver : public SolverBase
 {
+public:
+    using Puzzle = BasicPuzzle<BoxSize>;
+    using Topo = typename Puzzle::Topo;
+    using Word = typename Puzzle::Word;
+
+    static constexpr uint32_t SIDE = Topo::SIDE;
+
 private:
+    // A node of the depth-first search: the checkpoint opened for the alternative currently being tried, the
+    // alternatives themselves, and which of them is current
+    struct SearchNode
+    {
+        typename Puzzle::Checkpoint checkpoint;
+        typename Puzzle::Branch branch;
+        uint32_t next;
+    };
+
     Puzzle *puzzle;
     uint32_t total_loops;
     uint32_t guesses;
 
+    // Which techniques have solved at least one element, as a mask of Technique values
+    uint32_t techniques_used;
+
+    // The units (as laid out in Topo::FLAT_TO_UNITS) which each group technique has yet to look at since they last
+    // changed. Looking at an unchanged unit again can't rule anything more out.
+    typename Topo::UnitSet squeeze_units;
+    typename Topo::UnitSet pipe_units;
+    typename Topo::UnitSet subset_units;
+
+    // Undo trail used to back out of guesses without copying the puzzle
+    typename Puzzle::Journal journal;
+
+    // Every search node fixes at least one more element, so the search can never go deeper than the puzzle. Past
+    // 9x9 that runs to megabytes of checkpoints, too much to build solvers on the stack with, so it goes on the heap.
+    static constexpr bool HEAP_SEARCH_STACK = (BoxSize > 3);
+    std::conditional_t<HEAP_SEARCH_STACK, std::unique_ptr<SearchNode[]>, std::array<SearchNode, Topo::CELLS>>
+        search_stack;
+
+#if defined(SUDOFUN_SOLVER_STATS)
+    SolverStats *stats;
+
+    // Charges everything a technique does between construction and destruction to its counters
+    class TechniqueScope
+    {
+    private:
+        TechniqueStats *counters;
+        Puzzle *puzzle;
+        uint32_t initial_unsolved;
+        uint32_t initial_candidates;
+        std::chrono::steady_clock::time_point start;
+
+    public:
+        TechniqueScope(SolverStats *stats, uint32_t technique, Puzzle *puzzle)
+            : counters((stats != nullptr) ? &stats->techniques[utils::lowestBitIndex(technique)] : nullptr),
+              puzzle(puzzle)
+        {
+            if (this->counters != nullptr)
+            {
+                this->initial_unsolved = puzzle->numUnsolved();
+                this->initial_candidates = puzzle->numCandidates();
+                this->start = std::chrono::steady_clock::now();
+            }
+        }
+
+        ~TechniqueScope()
+        {
+            if (this->counters != nullptr)
+            {
+                auto end = std::chrono::steady_clock::now();
+                ++this->counters->calls;
+                this->counters->elapsed_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(end - this->start).count();
+                this->counters->cells_solved += this->initial_unsolved - this->puzzle->numUnsolved();
+                this->counters->candidates_eliminated += this->initial_candidates - this->puzzle->numCandidates();
+            }
+        }
+    };
+#else
+    // Without stats compiled in there is nothing to charge, and the scope compiles away
+    class TechniqueScope
+    {
+    public:
+        TechniqueScope(const void *, uint32_t, Puzzle *) {}
+    };
+
+    static constexpr const void *stats = nullptr;
+#endif
+
+    void allocateSearchStack()
+    {
+        if constexpr (HEAP_SEARCH_STACK)
+        {
+            // Default initialized rather than zeroed, as the search fills in each node when it gets there
+            this->search_stack.reset(new SearchNode[Topo::CELLS]);
+        }
+    }
+
 public:
-    Solver(Puzzle *puzzle) : puzzle(puzzle), total_loops(0), guesses(0) {}
+#if defined(SUDOFUN_SOLVER_STATS)
+    BasicSolver(Puzzle *puzzle)
+        : puzzle(puzzle), total_loops(0), guesses(0), techniques_used(0), squeeze_units(Topo::ALL_UNITS),
+          pipe_units(Topo::ALL_UNITS), subset_units(Topo::ALL_UNITS), stats(nullptr)
+    {
+        this->allocateSearchStack();
+    }
+#else
+    BasicSolver(Puzzle *puzzle)
+        : puzzle(puzzle), total_loops(0), guesses(0), techniques_used(0), squeeze_units(Topo::ALL_UNITS),
+          pipe_units(Topo::ALL_UNITS), subset_units(Topo::ALL_UNITS)
+    {
+        this->allocateSearchStack();
+    }
+#endif
+
+    /**
+     * @brief Attaches counters for the solver to add to as it works. Does nothing unless SUDOFUN_SOLVER_STATS is
+     * defined.
+     *
+     * @param stats The counters, or nullptr to stop counting
+     */
+    void setStats(SolverStats *stats)
+    {
+#if defined(SUDOFUN_SOLVER_STATS)
+        this->stats = stats;
+#else
+        (void)stats;
+#endif
+    }
+
+    /**
+     * @brief The number of passes the reduce loop has made through the solve stack so far.
+     *
+     * @return uint32_t
+     */
+    uint32_t numLoops() const
+    {
+        return this->total_loops;
+    }
+
+    /**
+     * @brief The techniques which have solved at least one element so far, as a mask of Technique values.
+     *
+     * @return uint32_t
+     */
+    uint32_t techniquesUsed() const
+    {
+        return this->techniques_used;
+    }
+
+    /**
+     * @brief The number of guesses the search has made so far.
+     *
+     * @return uint32_t
+     */
+    uint32_t numGuesses() const
+    {
+        return this->guesses;
+    }
 
     //--------------------------------------------------------------------------------------------//
     //--- Solver methods -------------------------------------------------------------------------//
@@ -27,6 +268,7 @@ public:
      */
     void strike(Puzzle *puzzle, bool *updated)
     {
+        TechniqueScope scope(this->stats, STRIKE, puzzle);
         bool is_done = false;
 
         while (!is_done)
@@ -44,6 +286,10 @@ public:
 
             // Track if we've made any update
             *updated |= !is_done;
+            if (!is_done)
+            {
+                this->techniques_used |= STRIKE;
+            }
         }
     }
 
@@ -56,11 +302,16 @@ public:
      */
     void unique(Puzzle *puzzle, bool *updated)
     {
+        TechniqueScope scope(this->stats, UNIQUE, puzzle);
         uint32_t initial_unsolved = puzzle->numUnsolved();
 
-        for (const uint32_t &unsolved_idx : puzzle->unsolved_indices)
+        // Bits seen once/twice in every unit, computed for all units at once
+        typename Puzzle::UnitMasks masks;
+        puzzle->unitMasks(&masks);
+
+        for (const uint32_t unsolved_idx : puzzle->unsolved_indices)
         {
-            uint16_t unique_bits = puzzle->uniqueUGroupBits(unsolved_idx);
+            Word unique_bits = puzzle->uniqueUGroupBits(unsolved_idx, masks);
             if (unique_bits != 0)
             {
                 puzzle->setValue(unsolved_idx, unique_bits);
@@ -97,166 +348,528 @@ public:
         postStepUpdate(puzzle);
 
         // Track if we've made any update
-        *updated |= initial_unsolved != puzzle->numUnsolved();
+        bool progressed = initial_unsolved != puzzle->numUnsolved();
+        *updated |= progressed;
+        if (progressed)
+        {
+            this->techniques_used |= UNIQUE;
+        }
     }
 
     /**
-     * @brief A reduction method based on the pigeonhole principle. Currently not implemented
-     * because it appears to be redundant.
+     * @brief In every row and column, divide the row/column into parts according to block membership.
+     * If any of the parts has a unique bit, remove that bit from the remaining members of that part's block.
      *
      * @param puzzle
-     * @param updated
+     * @param updated A flag to track whether the solve stack has resulted in any updates to the puzzle
      */
-    void
-    pigeon(Puzzle *puzzle, bool *updated)
+    void squeeze(Puzzle *puzzle, bool *updated)
     {
-        for (uint32_t i = 0; i < 9; ++i)
+        TechniqueScope scope(this->stats, SQUEEZE, puzzle);
+        uint32_t initial_unsolved = puzzle->numUnsolved();
+
+        // Squeezing only removes options, so the elements still in their unsolved groups stay the same throughout
+        typename Topo::CellSet u_cells = puzzle->uCells();
+
+        // Loop over the rows and then the cols
+        for (uint32_t line = 0; line < 2 * SIDE; ++line)
         {
+            // Only the rows and cols which have changed since we last looked
+            if (!this->takeDirtyUnit(puzzle, &this->squeeze_units, line))
+            {
+                continue;
+            }
+
+            // The digits each section of the row/col may take
+            std::array<Word, BoxSize> section_bits{};
+            for (uint32_t n = 0; n < BoxSize; ++n)
+            {
+                for (const uint32_t flat_index : Topo::INTERSECTIONS[BoxSize * line + n].cells)
+                {
+                    section_bits[n] |= puzzle->getValue(flat_index);
+                }
+            }
+
+            // A digit confined to one section of the row/col can't go anywhere else in that section's block
+            Word in_several = severalOf(section_bits);
+            for (uint32_t n = 0; n < BoxSize; ++n)
+            {
+                const typename Topo::Intersection &x = Topo::INTERSECTIONS[BoxSize * line + n];
+                puzzle->removeDigitsFrom(section_bits[n] & ~in_several, x.blk_rest & u_cells);
+            }
         }
 
-        for (uint32_t j = 0; j < 9; ++j)
+        // Update the unsolved and recently solved
+        this->postStepUpdate(puzzle);
+
+        // Track if we've made any update
+        bool progressed = initial_unsolved != puzzle->numUnsolved();
+        *updated |= progressed;
+        if (progressed)
         {
+            this->techniques_used |= SQUEEZE;
         }
+    }
+
+    /**
+     * @brief In every block select the unsolved elements and check if any bit is unique to a row or column within
+     * the block. For each unique bit eliminate them from row/column members outside if the block.
+     *
+     * @param puzzle
+     * @param updated A flag to track whether the solve stack has resulted in any updates to the puzzle
+     */
+    void pipe(Puzzle *puzzle, bool *updated)
+    {
+        TechniqueScope scope(this->stats, PIPE, puzzle);
+        uint32_t initial_unsolved = puzzle->numUnsolved();
 
-        for (uint32_t g = 0; g < 9; ++g)
+        // As with squeezing, the elements still in their unsolved groups stay the same throughout
+        typename Topo::CellSet u_cells = puzzle->uCells();
+
+        // Loop over the blocks
+        for (uint32_t g = 0; g < SIDE; ++g)
         {
+            // Only the blocks which have changed since we last looked
+            if (!this->takeDirtyUnit(puzzle, &this->pipe_units, 2 * SIDE + g))
+            {
+                continue;
+            }
+
+            // The digits the unsolved members of each row and col of the block may take
+            std::array<Word, BoxSize> row_bits{};
+            std::array<Word, BoxSize> col_bits{};
+            for (const uint32_t flat_index : puzzle->blkUGroup(g))
+            {
+                uint32_t pos = Topo::flatToBlkPos(flat_index);
+                row_bits[pos / BoxSize] |= puzzle->getValue(flat_index);
+                col_bits[pos % BoxSize] |= puzzle->getValue(flat_index);
+            }
+
+            // A digit whose unsolved places in the block all lie in one of its rows/cols can't go anywhere else in
+            // that row/col. A single place lies in both.
+            Word rows_several = severalOf(row_bits);
+            Word cols_several = severalOf(col_bits);
+            for (uint32_t n = 0; n < BoxSize; ++n)
+            {
+                const typename Topo::Intersection &row_x = Topo::INTERSECTIONS[Topo::BLK_INTERSECTIONS[g][n]];
+                puzzle->removeDigitsFrom(row_bits[n] & ~rows_several, row_x.line_rest & u_cells);
+            }
+            for (uint32_t n = 0; n < BoxSize; ++n)
+            {
+                const typename Topo::Intersection &col_x = Topo::INTERSECTIONS[Topo::BLK_INTERSECTIONS[g][BoxSize + n]];
+                puzzle->removeDigitsFrom(col_bits[n] & ~cols_several, col_x.line_rest & u_cells);
+            }
         }
 
+        // Update the unsolved and recently solved
         this->postStepUpdate(puzzle);
+
+        // Track if we've made any update
+        bool progressed = initial_unsolved != puzzle->numUnsolved();
+        *updated |= progressed;
+        if (progressed)
+        {
+            this->techniques_used |= PIPE;
+        }
     }
 
     /**
-     * @brief In every row and column, divide the row/column into three parts according to block membership.
-     * If any of the three parts has a unique bit, remove that bit from the remaining members of that part's block.
+     * @brief Naked and hidden subsets of two to four members in every row, column, and block. A naked subset is
+     * k unsolved members whose options together number only k bits, so no other member of the group can take those
+     * bits. A hidden subset is k bits which together fit in only k unsolved members, so those members can take no
+     * other bits.
      *
      * @param puzzle
-     * @param updated A flag to track whether the solve stack has resulted in any updates to the puzzle
+     * @param updated A flag to track whether the solve stack has resulted in any updates to the puzzle. Unlike the
+     * other techniques, removing options without solving anything counts, since that is most of what subsets do.
      */
-    void squeeze(Puzzle *puzzle, bool *updated)
+    void subsets(Puzzle *puzzle, bool *updated)
     {
+        TechniqueScope scope(this->stats, SUBSET, puzzle);
         uint32_t initial_unsolved = puzzle->numUnsolved();
+        bool eliminated = false;
+
+        // Only the units which have changed since we last looked
+        for (uint32_t i = 0; i < SIDE; ++i)
+        {
+            if (this->takeDirtyUnit(puzzle, &this->subset_units, i))
+            {
+                eliminated |= this->unitSubsets(puzzle, Topo::ROW_TO_FLAT[i]);
+            }
+            if (this->takeDirtyUnit(puzzle, &this->subset_units, SIDE + i))
+            {
+                eliminated |= this->unitSubsets(puzzle, Topo::COL_TO_FLAT[i]);
+            }
+            if (this->takeDirtyUnit(puzzle, &this->subset_units, 2 * SIDE + i))
+            {
+                eliminated |= this->unitSubsets(puzzle, Topo::BLK_TO_FLAT[i]);
+            }
+        }
 
-        // Values to track unique bits
-        std::array<uint16_t, 3> unique_bits;
-        uint16_t unique;
+        // Update the unsolved and recently solved
+        this->postStepUpdate(puzzle);
 
-        // Loop over the rows
-        for (uint32_t i = 0; i < 9; ++i)
+        // Track if we've made any update
+        bool progressed = eliminated || (initial_unsolved != puzzle->numUnsolved());
+        *updated |= progressed;
+        if (progressed)
         {
-            // Identify bits unique to each section, if any
-            unique_bits = puzzle->uniqueBitsBySections(i, true);
+            this->techniques_used |= SUBSET;
+        }
+    }
 
-            // Loop over each of the three sections of the row
-            for (uint32_t n = 0; n < 3; ++n)
+    /**
+     * @brief Finds the naked and hidden subsets of one group and removes the options they rule out.
+     *
+     * @param puzzle
+     * @param flat The flat indices of the members of the group
+     * @return true if any options were removed
+     */
+    bool unitSubsets(Puzzle *puzzle, const std::array<uint32_t, SIDE> &flat)
+    {
+        // The options of each member, and for each bit the members that may take it, both as SIDE bit masks
+        std::array<Word, SIDE> options;
+        std::array<Word, SIDE> places{};
+        Word unsolved = 0;
+        Word solved_bits = 0;
+        for (uint32_t n = 0; n < SIDE; ++n)
+        {
+            options[n] = puzzle->getValue(flat[n]);
+            if (Topo::countBits(options[n]) > 1)
             {
-                unique = unique_bits[n];
-
-                // If there are unique bits in a section, remove them from the unsolved non-row members of the blk
-                if (unique != 0)
+                unsolved |= Puzzle::digitBit(n);
+                for (Word bits = options[n]; bits != 0; bits &= bits - 1)
                 {
-                    for (uint16_t *gval : puzzle->uBlkValuesNotInRow(3 * (i / 3) + n, i))
-                    {
-                        *gval -= *gval & unique;
-                    }
+                    places[utils::lowestBitIndex(bits)] |= Puzzle::digitBit(n);
                 }
             }
+            else
+            {
+                solved_bits |= options[n];
+            }
         }
 
-        // Loop over the cols
-        for (uint32_t j = 0; j < 9; ++j)
+        // A subset needs at least one other unsolved member to rule anything out
+        uint32_t num_unsolved = Topo::countBits(unsolved);
+        if (num_unsolved <= 2)
         {
-            // Identify bits unique to each section, if any
-            unique_bits = puzzle->uniqueBitsBySections(j, false);
+            return false;
+        }
 
-            // Loop over each of the three sections of the col
-            for (uint32_t n = 0; n < 3; ++n)
+        bool eliminated = false;
+        auto removeFrom = [&](uint32_t n, Word bits)
+        {
+            if ((puzzle->getValue(flat[n]) & bits) != 0)
             {
-                unique = unique_bits[n];
-
-                // If there are unique bits in a section, remove them from the non-col members of the blk
-                if (unique != 0)
-                {
-                    for (uint16_t *gval : puzzle->uBlkValuesNotInCol(j / 3 + 3 * n, j))
-                    {
-                        *gval -= *gval & unique;
-                    }
-                }
+                puzzle->removeBits(flat[n], bits);
+                eliminated = true;
             }
+        };
+
+        // Naked subsets: members whose options are few enough to be part of one
+        Word naked_candidates = 0;
+        for (uint32_t n = 0; n < SIDE; ++n)
+        {
+            uint32_t num_options = Topo::countBits(options[n]);
+            naked_candidates |= ((num_options > 1) && (num_options < num_unsolved) && (num_options <= MAX_SUBSET_SIZE))
+                                    ? Puzzle::digitBit(n)
+                                    : 0;
         }
+        findSubsets(options, naked_candidates, std::min(MAX_SUBSET_SIZE, num_unsolved - 1), [&](Word members, Word bits)
+                    {
+                        for (Word others = unsolved & ~members; others != 0; others &= others - 1)
+                        {
+                            removeFrom(utils::lowestBitIndex(others), bits);
+                        } });
 
-        // Update the unsolved and recently solved
-        this->postStepUpdate(puzzle);
+        // Hidden subsets: unsolved bits with few enough places to be part of one. A hidden subset of k bits is the
+        // complement of a naked subset of the other n - k unsolved members, so only those too large to have been
+        // found as naked subsets need looking for.
+        if (num_unsolved <= MAX_SUBSET_SIZE + 2)
+        {
+            return eliminated;
+        }
+        uint32_t max_hidden_size = std::min(MAX_SUBSET_SIZE, num_unsolved - MAX_SUBSET_SIZE - 1);
+        Word hidden_candidates = 0;
+        for (uint32_t b = 0; b < SIDE; ++b)
+        {
+            uint32_t num_places = Topo::countBits(places[b]);
+            hidden_candidates |= ((num_places > 1) && (num_places <= max_hidden_size)) ? Puzzle::digitBit(b) : 0;
+        }
+        hidden_candidates &= ~solved_bits;
+        findSubsets(places, hidden_candidates, max_hidden_size, [&](Word bits, Word members)
+                    {
+                        for (Word subset_members = members; subset_members != 0; subset_members &= subset_members - 1)
+                        {
+                            removeFrom(utils::lowestBitIndex(subset_members), Topo::ALL_BITS & ~bits);
+                        } });
 
-        // Track if we've made any update
-        *updated |= initial_unsolved != puzzle->numUnsolved();
+        return eliminated;
     }
 
     /**
-     * @brief In every block select the unsolved elements and check if any bit is unique to a row or column within
-     * the block. For each unique bit eliminate them from row/column members outside if the block.
+     * @brief Basic fish of size two to four (X-Wing, Swordfish, Jellyfish) for every bit. If the places a bit may
+     * take in k rows all fall within the same k columns, then those rows take the bit in those columns, and no
+     * other row may take it there. The same holds with rows and columns swapped.
      *
      * @param puzzle
-     * @param updated A flag to track whether the solve stack has resulted in any updates to the puzzle
+     * @param updated A flag to track whether the solve stack has resulted in any updates to the puzzle. As with
+     * subsets, removing options without solving anything counts.
      */
-    void pipe(Puzzle *puzzle, bool *updated)
+    void fish(Puzzle *puzzle, bool *updated)
     {
+        TechniqueScope scope(this->stats, FISH, puzzle);
         uint32_t initial_unsolved = puzzle->numUnsolved();
+        bool eliminated = false;
 
-        // Loop over the blocks
-        for (uint32_t g = 0; g < 9; ++g)
+        // For every bit, the columns it may take in each row and the rows it may take in each column, as SIDE bit
+        // masks, along with the rows (and columns) in which it is already solved
+        std::array<std::array<Word, SIDE>, SIDE> row_places{};
+        std::array<std::array<Word, SIDE>, SIDE> col_places{};
+        std::array<Word, SIDE> solved_rows{};
+        std::array<Word, SIDE> solved_cols{};
+        for (uint32_t flat_index = 0; flat_index < Topo::CELLS; ++flat_index)
         {
-            // The first row and column index within the block (they each increment by 1, obviously,
-            // because they are consecutive)
-            uint32_t r = 3 * (g / 3);
-            uint32_t c = 3 * (g % 3);
+            Word value = puzzle->getValue(flat_index);
+            uint32_t r = Topo::flatToRow(flat_index);
+            uint32_t c = Topo::flatToCol(flat_index);
+            if (Topo::countBits(value) == 1)
+            {
+                solved_rows[utils::lowestBitIndex(value)] |= Puzzle::digitBit(r);
+                solved_cols[utils::lowestBitIndex(value)] |= Puzzle::digitBit(c);
+                continue;
+            }
+            for (Word bits = value; bits != 0; bits &= bits - 1)
+            {
+                uint32_t b = utils::lowestBitIndex(bits);
+                row_places[b][r] |= Puzzle::digitBit(c);
+                col_places[b][c] |= Puzzle::digitBit(r);
+            }
+        }
 
-            // Loop over the rows/cols of the block
-            for (uint32_t _n = 0; _n < 3; ++_n, ++r, ++c)
+        for (uint32_t b = 0; b < SIDE; ++b)
+        {
+            Word bit = Puzzle::digitBit(b);
+
+            // The rows still waiting on the bit; there are as many columns waiting on it
+            Word open_rows = 0;
+            for (uint32_t r = 0; r < SIDE; ++r)
+            {
+                open_rows |= ((row_places[b][r] != 0) && !((solved_rows[b] >> r) & 1)) ? Puzzle::digitBit(r) : 0;
+            }
+            uint32_t num_open = Topo::countBits(open_rows);
+            if (num_open <= 2)
             {
-                // Grab the unsolved elements of the block, split into which are part of the row/col, and which are not
-                auto [blk_in_row, blk_not_in_row] = puzzle->uBlkValuesSiftRow(g, r);
-                auto [blk_in_col, blk_not_in_col] = puzzle->uBlkValuesSiftCol(g, c);
+                continue;
+            }
 
-                // Determine if there are any unique bits of those block members in the row/col
-                uint16_t unique_row_bits = utils::bitsInSrcNotInRef(blk_in_row, blk_not_in_row);
-                uint16_t unique_col_bits = utils::bitsInSrcNotInRef(blk_in_col, blk_not_in_col);
+            // Rows as the base and columns as the cover, up to jellyfish
+            uint32_t max_row_size = std::min(MAX_SUBSET_SIZE, num_open - 1);
+            Word base_rows = 0;
+            for (uint32_t r = 0; r < SIDE; ++r)
+            {
+                uint32_t num_places = Topo::countBits(row_places[b][r]);
+                bool eligible = ((open_rows >> r) & 1) && (num_places > 1) && (num_places <= max_row_size);
+                base_rows |= eligible ? Puzzle::digitBit(r) : 0;
+            }
+            findSubsets(row_places[b], base_rows, max_row_size, [&](Word rows, Word cols)
+                        {
+                            for (Word cover = cols; cover != 0; cover &= cover - 1)
+                            {
+                                uint32_t c = utils::lowestBitIndex(cover);
+                                for (Word others = col_places[b][c] & ~rows; others != 0; others &= others - 1)
+                                {
+                                    uint32_t flat_index = Topo::ROW_TO_FLAT[utils::lowestBitIndex(others)][c];
+                                    if ((puzzle->getValue(flat_index) & bit) != 0)
+                                    {
+                                        puzzle->removeBits(flat_index, bit);
+                                        eliminated = true;
+                                    }
+                                }
+                            } });
 
-                // Remove those bits from non-block row/col members
-                if (unique_row_bits != 0)
-                {
-                    for (uint16_t *gval : puzzle->uRowValuesNotInBlk(r, g))
-                    {
-                        *gval -= *gval & unique_row_bits;
-                    }
-                }
-                if (unique_col_bits != 0)
-                {
-                    for (uint16_t *gval : puzzle->uColValuesNotInBlk(c, g))
-                    {
-                        *gval -= *gval & unique_col_bits;
-                    }
-                }
+            // Columns as the base only for the sizes whose row-based complement was too large to be found above
+            if (num_open <= MAX_SUBSET_SIZE + 2)
+            {
+                continue;
+            }
+            uint32_t max_col_size = std::min(MAX_SUBSET_SIZE, num_open - MAX_SUBSET_SIZE - 1);
+            Word base_cols = 0;
+            for (uint32_t c = 0; c < SIDE; ++c)
+            {
+                uint32_t num_places = Topo::countBits(col_places[b][c]);
+                bool eligible = !((solved_cols[b] >> c) & 1) && (num_places > 1) && (num_places <= max_col_size);
+                base_cols |= eligible ? Puzzle::digitBit(c) : 0;
             }
+            findSubsets(col_places[b], base_cols, max_col_size, [&](Word cols, Word rows)
+                        {
+                            for (Word cover = rows; cover != 0; cover &= cover - 1)
+                            {
+                                uint32_t r = utils::lowestBitIndex(cover);
+                                for (Word others = row_places[b][r] & ~cols; others != 0; others &= others - 1)
+                                {
+                                    uint32_t flat_index = Topo::ROW_TO_FLAT[r][utils::lowestBitIndex(others)];
+                                    if ((puzzle->getValue(flat_index) & bit) != 0)
+                                    {
+                                        puzzle->removeBits(flat_index, bit);
+                                        eliminated = true;
+                                    }
+                                }
+                            } });
         }
 
         // Update the unsolved and recently solved
         this->postStepUpdate(puzzle);
 
         // Track if we've made any update
-        *updated |= initial_unsolved != puzzle->numUnsolved();
+        bool progressed = eliminated || (initial_unsolved != puzzle->numUnsolved());
+        *updated |= progressed;
+        if (progressed)
+        {
+            this->techniques_used |= FISH;
+        }
+    }
+
+    /**
+     * @brief Searches for sets of k masks, for k from two up to a maximum size, whose union has exactly k bits.
+     * The same search finds naked subsets (over the options of each member) and hidden subsets (over the places
+     * of each bit).
+     *
+     * @param masks
+     * @param candidates Which of the masks may take part
+     * @param max_size The largest subset to look for
+     * @param on_subset Called as on_subset(chosen, union) with both as SIDE bit masks
+     * @param chosen The masks chosen so far
+     * @param combined The union of the masks chosen so far
+     */
+    template <typename Fn>
+    static void findSubsets(const std::array<Word, SIDE> &masks, Word candidates, uint32_t max_size,
+                            const Fn &on_subset, Word chosen = 0, Word combined = 0)
+    {
+        uint32_t size = Topo::countBits(chosen) + 1;
+        for (Word rest = candidates; rest != 0; rest &= rest - 1)
+        {
+            uint32_t n = utils::lowestBitIndex(rest);
+            Word next_combined = combined | masks[n];
+            uint32_t num_bits = Topo::countBits(next_combined);
+            if (num_bits > max_size)
+            {
+                continue;
+            }
+
+            Word next_chosen = chosen | Puzzle::digitBit(n);
+            if ((num_bits == size) && (size >= 2))
+            {
+                on_subset(next_chosen, next_combined);
+            }
+            else if (size < max_size)
+            {
+                // Only later candidates, so each subset is visited once
+                findSubsets(masks, rest & (rest - 1), max_size, on_subset, next_chosen, next_combined);
+            }
+        }
+    }
+
+    /**
+     * @brief The bits set in more than one of a number of words.
+     *
+     * @param words
+     * @return Word
+     */
+    static Word severalOf(const std::array<Word, BoxSize> &words)
+    {
+        Word once = 0;
+        Word several = 0;
+        for (const Word word : words)
+        {
+            several |= once & word;
+            once |= word;
+        }
+        return several;
     }
 
     //--------------------------------------------------------------------------------------------//
     //--- Flow control ---------------------------------------------------------------------------//
     //--------------------------------------------------------------------------------------------//
-    void solveStack(Puzzle *puzzle, bool *updated)
-    {
-        strike(puzzle, updated);
-        unique(puzzle, updated);
-        strike(puzzle, updated);
-        squeeze(puzzle, updated);
-        strike(puzzle, updated);
-        pipe(puzzle, updated);
+    template <uint32_t Step>
+    void runTechnique(Puzzle *puzzle, bool *updated)
+    {
+        if constexpr (Step == STRIKE)
+        {
+            strike(puzzle, updated);
+        }
+        else if constexpr (Step == UNIQUE)
+        {
+            unique(puzzle, updated);
+        }
+        else if constexpr (Step == SQUEEZE)
+        {
+            squeeze(puzzle, updated);
+        }
+        else if constexpr (Step == PIPE)
+        {
+            pipe(puzzle, updated);
+        }
+        else if constexpr (Step == SUBSET)
+        {
+            // Subsets cost far more than the rest, so only fall back on them once the pass has otherwise stalled
+            if (!*updated)
+            {
+                subsets(puzzle, updated);
+            }
+        }
+        else
+        {
+            static_assert(Step == FISH, "Pipelines may not contain guesses");
+
+            // Likewise for fish
+            if (!*updated)
+            {
+                fish(puzzle, updated);
+            }
+        }
+    }
+
+    /**
+     * @brief Runs each technique of a pipeline once, in order.
+     *
+     * @param puzzle
+     * @param updated A flag to track whether the solve stack has resulted in any updates to the puzzle
+     */
+    template <uint32_t... Steps>
+    void solveStack(TechniquePipeline<Steps...>, Puzzle *puzzle, bool *updated)
+    {
+        (this->runTechnique<Steps>(puzzle, updated), ...);
+    }
+
+    /**
+     * @brief Hands the units written since the last call on to every group technique's list of units to revisit.
+     *
+     * @param puzzle
+     */
+    void collectDirtyUnits(Puzzle *puzzle)
+    {
+        typename Topo::UnitSet dirty = puzzle->takeDirtyUnits();
+        this->squeeze_units |= dirty;
+        this->pipe_units |= dirty;
+        this->subset_units |= dirty;
+    }
+
+    /**
+     * @brief Checks whether a unit has changed since a technique last looked at it, and if so marks it as looked
+     * at. Writes are collected first, so a unit changed earlier in the same technique call is seen as changed.
+     *
+     * @param puzzle
+     * @param pending The technique's units to revisit
+     * @param unit The unit, as laid out in Topo::FLAT_TO_UNITS
+     * @return true if the technique should look at the unit
+     */
+    bool takeDirtyUnit(Puzzle *puzzle, typename Topo::UnitSet *pending, uint32_t unit)
+    {
+        this->collectDirtyUnits(puzzle);
+        bool dirty = pending->contains(unit);
+        pending->erase(unit);
+        return dirty;
     }
 
     void postStepUpdate(Puzzle *puzzle)
@@ -270,6 +883,7 @@ public:
     }
 
     // An iterative deterministic solver loop
+    template <typename Stack = StandardPipeline>
     void reduceLoop(Puzzle *puzzle)
     {
         bool keep_going = true;
@@ -277,7 +891,7 @@ public:
         {
             // Run the solver stack and keep going if any of the methods yield a change
             keep_going = false;
-            solveStack(puzzle, &keep_going);
+            solveStack(Stack{}, puzzle, &keep_going);
 
             // Track the number of loop attempts we've made
             ++this->total_loops;
@@ -287,6 +901,7 @@ public:
         strike(puzzle, &keep_going);
     }
 
+    template <typename Stack = StandardPipeline>
     void reduceLoop(Puzzle *puzzle, bool *goodness)
     {
         bool keep_going = true;
@@ -294,7 +909,7 @@ public:
         {
             // Run the solver stack and keep going if any of the methods yield a change
             keep_going = false;
-            solveStack(puzzle, &keep_going);
+            solveStack(Stack{}, puzzle, &keep_going);
 
             // Track the number of loop attempts we've made
             ++this->total_loops;
@@ -308,49 +923,132 @@ public:
         strike(puzzle, &keep_going);
     }
 
-    // Guesser solver
-    void guessAndCheck()
+    /**
+     * @brief Depth-first search over the puzzle, for when the deterministic loop stalls. Each node branches on
+     * the unsolved element (or the digit within a row, column, or block) with the fewest remaining options, and
+     * every alternative is followed by a reduce loop. Nodes live in a preallocated stack and are backed out of
+     * through the journal, so the search never copies the puzzle.
+     *
+     * Assumes the puzzle has just been through a reduce loop, is valid, and is not yet solved.
+     *
+     * @param max_guesses The number of alternatives we may try before giving up
+     * @param max_solutions The number of solutions after which to stop looking
+     * @return uint32_t The number of solutions found. If there were any the puzzle is left holding the first,
+     * otherwise it is left as it was on entry.
+     */
+    template <typename Stack = StandardPipeline>
+    uint32_t search(uint32_t max_guesses, uint32_t max_solutions = 1)
     {
-        auto [bits, locs] = this->puzzle->leastPopularBit();
+        TechniqueScope scope(this->stats, GUESS, this->puzzle);
+        uint32_t found = 0;
+        Puzzle first_solution;
+
+        uint32_t depth = 0;
+        this->puzzle->fewestOptionsBranch(&this->search_stack[0].branch);
+        this->search_stack[0].next = 0;
 
-        // Loop over any bit not fully solved
-        for (int i = 0; i < bits.size(); ++i)
+        while (true)
         {
-            uint16_t test_bit = bits[i];
+            SearchNode *node = &this->search_stack[depth];
+
+            // Every alternative at this node has been tried, so back out to the parent and move on to its next
+            // alternative
+            if (node->next == node->branch.count)
+            {
+                if (depth == 0)
+                {
+                    break;
+                }
+
+                node = &this->search_stack[--depth];
+                this->puzzle->rewind(node->checkpoint);
+                ++node->next;
+                continue;
+            }
 
-            // Loop over every location where that bit is still possible
-            for (const uint32_t &test_idx : locs[i])
+            // Out of guesses: restore the puzzle to its state on entry
+            if (this->guesses >= max_guesses)
             {
-                // Make a copy of our puzzle and choose a value for one of the unsolved elements
-                Puzzle test_puzzle = *this->puzzle;
-                test_puzzle.setValue(test_idx, test_bit);
-                test_puzzle.latest_solved_indices.push_back(test_idx);
+                if (depth > 0)
+                {
+                    this->puzzle->rewind(this->search_stack[0].checkpoint);
+                }
+                break;
+            }
+
+            // Choose a value for one of the unsolved elements and run through a reduce loop
+            uint32_t test_idx = node->branch.cells[node->next];
+            node->checkpoint = this->puzzle->checkpoint(&this->journal);
+            this->puzzle->setValue(test_idx, node->branch.bits[node->next]);
+            this->puzzle->latest_solved_indices.push_back(test_idx);
+            ++this->guesses;
+            this->techniques_used |= GUESS;
 
-                // Run through a reduce loop
-                bool goodness = true;
-                this->reduceLoop(&test_puzzle, &goodness);
+            bool goodness = true;
+            this->reduceLoop<Stack>(this->puzzle, &goodness);
 
-                // If the loop yields an invalid puzzle, then we know our test index cannot be test bit
-                if (!goodness)
+            if (goodness && this->puzzle->validPuzzle())
+            {
+                if (this->puzzle->numUnsolved() == 0)
                 {
-                    // Remove test bit from the possible values at test index
-                    *this->puzzle->ptrValue(test_idx) -= *this->puzzle->ptrValue(test_idx) & test_bit;
+                    ++found;
+
+                    // The first solution is the one we keep, so if it's all we're after keep it and discard the trail
+                    if ((found == 1) && (max_solutions == 1))
+                    {
+                        this->puzzle->release(this->search_stack[0].checkpoint);
+                        return found;
+                    }
+
+                    // Otherwise hang on to it while we look for more
+                    if (found == 1)
+                    {
+                        first_solution = this->puzzle->detachedCopy();
+                    }
+
+                    if (found == max_solutions)
+                    {
+                        this->puzzle->rewind(this->search_stack[0].checkpoint);
+                        break;
+                    }
 
-                    // Run another reduce loop on our true puzzle to squeeze out any benefits of this elimination
-                    this->reduceLoop(this->puzzle);
+                    this->puzzle->rewind(node->checkpoint);
+                    ++node->next;
+                    continue;
                 }
 
-                // Increment the number of guesses we've made
-                this->guesses++;
+                // Still consistent but unsolved, so descend
+                node = &this->search_stack[++depth];
+                this->puzzle->fewestOptionsBranch(&node->branch);
+                node->next = 0;
+            }
+            else
+            {
+                // Contradiction, so try the next alternative
+                this->puzzle->rewind(node->checkpoint);
+                ++node->next;
             }
         }
+
+        if (found > 0)
+        {
+            *this->puzzle = first_solution;
+        }
+
+        return found;
     }
 
-    //
-    void solve(uint32_t max_guesses = 100)
+    /**
+     * @brief Solves the puzzle with a given pipeline, running the deterministic loop and then searching if that
+     * alone is not enough.
+     *
+     * @param max_guesses The maximum number of guesses the search may make; zero disables guessing
+     */
+    template <typename Stack>
+    void solveWith(uint32_t max_guesses)
     {
         // Run the deterministic solve loop
-        this->reduceLoop(this->puzzle);
+        this->reduceLoop<Stack>(this->puzzle);
 
         // If we're invalid, then no sense guessing
         if (!this->puzzle->validPuzzle())
@@ -358,13 +1056,121 @@ public:
             return;
         }
 
-        bool solvedFlag = this->puzzle->numUnsolved() == 0;
-        while ((!solvedFlag) && (this->guesses < max_guesses))
+        if ((this->puzzle->numUnsolved() != 0) && (max_guesses > 0))
         {
-            this->guessAndCheck();
-            solvedFlag |= this->puzzle->numUnsolved() == 0;
+            this->search<Stack>(max_guesses);
+        }
+    }
+
+    /**
+     * @brief Solves the puzzle, running the deterministic loop and then searching if that alone is not enough.
+     *
+     * @param max_guesses The maximum number of guesses the search may make; zero disables guessing
+     * @param pipeline Which prebuilt pipeline the deterministic loop runs
+     */
+    void solve(uint32_t max_guesses = UNLIMITED_GUESSES, Pipeline pipeline = Pipeline::STANDARD)
+    {
+        switch (pipeline)
+        {
+        case Pipeline::THROUGHPUT:
+            this->solveWith<ThroughputPipeline>(max_guesses);
+            break;
+        case Pipeline::DEEP:
+            this->solveWith<DeepPipeline>(max_guesses);
+            break;
+        default:
+            this->solveWith<StandardPipeline>(max_guesses);
+            break;
+        }
+    }
+
+    /**
+     * @brief Counts the solutions of the puzzle with a given pipeline and a complete search, stopping as soon as a
+     * given number have been found.
+     *
+     * @param limit The number of solutions after which to stop counting
+     * @return uint32_t The number of solutions, up to the limit
+     */
+    template <typename Stack>
+    uint32_t countSolutionsWith(uint32_t limit)
+    {
+        if (limit == 0)
+        {
+            return 0;
+        }
+
+        // Run the deterministic solve loop
+        this->reduceLoop<Stack>(this->puzzle);
+
+        if (!this->puzzle->validPuzzle())
+        {
+            return 0;
+        }
+
+        uint32_t found = 1;
+        if (this->puzzle->numUnsolved() != 0)
+        {
+            found = this->search<Stack>(UNLIMITED_GUESSES, limit);
+        }
+
+        // Every solution shares the clues, so if the clues repeat a value none of them are real solutions
+        if ((found > 0) && !this->puzzle->validSolution())
+        {
+            return 0;
+        }
+
+        return found;
+    }
+
+    /**
+     * @brief Counts the solutions of the puzzle with a complete search, stopping as soon as a given number have
+     * been found. A limit of two is a uniqueness test. If there is any solution the puzzle is left holding one. The
+     * techniques used along the way (see techniquesUsed()) are those of the pipeline chosen, so rating a puzzle by
+     * them needs a pipeline that runs every technique of interest.
+     *
+     * @param limit The number of solutions after which to stop counting
+     * @param pipeline Which prebuilt pipeline the deterministic loop runs
+     * @return uint32_t The number of solutions, up to the limit
+     */
+    uint32_t countSolutions(uint32_t limit = 2, Pipeline pipeline = Pipeline::STANDARD)
+    {
+        switch (pipeline)
+        {
+        case Pipeline::THROUGHPUT:
+            return this->countSolutionsWith<ThroughputPipeline>(limit);
+        case Pipeline::DEEP:
+            return this->countSolutionsWith<DeepPipeline>(limit);
+        default:
+            return this->countSolutionsWith<StandardPipeline>(limit);
         }
     }
 };
+// The solver of the standard 9x9 puzzle
+using Solver = BasicSolver<3>;
+
+/**
+ * @brief Calls a function templated on the box size for a puzzle side chosen at runtime, passing it the box size as
+ * a std::integral_constant. Sides of 4, 9, 16, and 25 are supported.
+ *
+ * @param side
+ * @param fn
+ * @return Whatever fn returns
+ */
+template <typename Fn>
+auto withBoxSizeOf(uint32_t side, const Fn &fn)
+{
+    switch (side)
+    {
+    case 4:
+        return fn(std::integral_constant<uint32_t, 2>{});
+    case 9:
+        return fn(std::integral_constant<uint32_t, 3>{});
+    case 16:
+        return fn(std::integral_constant<uint32_t, 4>{});
+    case 25:
+        return fn(std::integral_constant<uint32_t, 5>{});
+    }
+    throw std::invalid_argument("Unsupported puzzle side: " + std::to_string(side));
+}
 
-#endif
\ No newline at end of file
+#endif
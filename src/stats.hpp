@@ -0,0 +1,59 @@
+#ifndef SUDOFUN_STATS_HEADER
+#define SUDOFUN_STATS_HEADER
+
+#include <array>
+#include <stdint.h>
+
+/**
+ * @brief What one solving technique has done: how often it ran, how many candidate bits it removed and elements
+ * it solved, and how long it took.
+ */
+struct TechniqueStats
+{
+    uint64_t calls{0};
+    uint64_t candidates_eliminated{0};
+    uint64_t cells_solved{0};
+    uint64_t elapsed_ns{0};
+
+    void merge(const TechniqueStats &other)
+    {
+        calls += other.calls;
+        candidates_eliminated += other.candidates_eliminated;
+        cells_solved += other.cells_solved;
+        elapsed_ns += other.elapsed_ns;
+    }
+};
+
+/**
+ * @brief Per-technique counters which a Solver fills in when one is attached. Collecting them costs a clock read
+ * and a count of the puzzle's candidates on every technique call, so it is only compiled in when
+ * SUDOFUN_SOLVER_STATS is defined; otherwise the solver has nothing to attach them to and the counters stay zero.
+ *
+ * The guess counters cover whole searches, so they include the time and eliminations of the techniques run inside
+ * the search, which are also counted under those techniques.
+ */
+struct SolverStats
+{
+#if defined(SUDOFUN_SOLVER_STATS)
+    static constexpr bool ENABLED = true;
+#else
+    static constexpr bool ENABLED = false;
+#endif
+
+    // Indexed by the bit position of the Solver::Technique
+    static constexpr uint32_t TECHNIQUE_COUNT = 7;
+    static constexpr std::array<const char *, TECHNIQUE_COUNT> TECHNIQUE_NAMES = {"strike", "unique", "squeeze",
+                                                                                   "pipe", "subset", "fish", "guess"};
+
+    std::array<TechniqueStats, TECHNIQUE_COUNT> techniques;
+
+    void merge(const SolverStats &other)
+    {
+        for (uint32_t n = 0; n < TECHNIQUE_COUNT; ++n)
+        {
+            techniques[n].merge(other.techniques[n]);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,526 @@
+#ifndef SUDOFUN_STORE_HEADER
+#define SUDOFUN_STORE_HEADER
+
+#include "cache.hpp"
+#include "dataset.hpp"
+#include "packed.hpp"
+#include "solver.hpp"
+#include <cstdio>
+#include <cstring>
+#include <shared_mutex>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+
+#if defined(SUDOFUN_HAVE_MMAP)
+#include <sys/file.h>
+#endif
+
+/**
+ * @brief Counters of what a solution store has done.
+ */
+struct StoreStats
+{
+    uint64_t hits{0};
+    uint64_t misses{0};
+    uint64_t inserts{0};
+};
+
+/**
+ * @brief Solver results kept on disk across runs, for banks of puzzles that are solved again and again. A store is
+ * two memory mapped files: the data file at the path given, holding every result ever added one after another, and
+ * an index beside it (the path with .index added), an open addressed hash table from the key of each puzzle to its
+ * record in the data file. Keys are those of the result cache, and 9x9 puzzles are keyed by their canonical form so
+ * that every symmetry of a puzzle shares one record; their solutions are kept on the canonical side.
+ *
+ * The data file is a 64 byte header followed by fixed width records:
+ *
+ *     bytes  0-3   magic: SFST
+ *     bytes  4-5   format version
+ *     bytes  6-7   side of the puzzles
+ *     bytes  8-11  bytes per record
+ *     bytes 12-15  pipeline the results were found with
+ *     bytes 16-19  guess limit the results were found with
+ *     bytes 24-31  number of records
+ *
+ * with each record the packed key (as a packed puzzle record) followed by a packed result record (see packed.hpp).
+ * The file is grown ahead of the records in large steps, so only the count in the header says how many there are.
+ * The index is a 32 byte header (magic SFSX, version, number of slots, and how many records it covers) followed by
+ * 8 byte slots, each 0 for empty or the record number plus one in its low 40 bits under the top 24 bits of the hash.
+ *
+ * One process at a time may open a store for writing, which it holds a lock on the data file for. Any number of
+ * other processes may read it at the same time without locks. The writer adds a record, then the count, then the
+ * slot, each visible to readers only after the one before, so a reader only ever finds whole records. A reader sees
+ * the records that fit in the files as they were when it opened them: when the index fills up, the writer builds a
+ * larger one and renames it into place, and readers go on using the old one. The index can always be rebuilt from
+ * the data file, and is, when it is missing or lags behind the data file after a crash.
+ *
+ * Within a process, the store may be shared by any number of threads.
+ *
+ * @tparam BoxSize
+ */
+template <uint32_t BoxSize>
+class SolutionStore
+{
+public:
+    using Layout = packed::Layout<BoxSize>;
+    using Key = typename ResultCache<BoxSize>::Key;
+
+    static constexpr size_t DATA_HEADER_SIZE = 64;
+    static constexpr size_t INDEX_HEADER_SIZE = 32;
+    static constexpr uint16_t VERSION = 1;
+    static constexpr char DATA_MAGIC[4] = {'S', 'F', 'S', 'T'};
+    static constexpr char INDEX_MAGIC[4] = {'S', 'F', 'S', 'X'};
+    static constexpr uint32_t RECORD_SIZE = Layout::PUZZLE_RECORD_SIZE + Layout::RESULT_RECORD_SIZE;
+
+private:
+    // The data file grows by at least this many records at a time, and the index starts with this many slots and
+    // doubles whenever it is half full
+    static constexpr uint64_t MIN_RECORD_CAPACITY = 1 << 16;
+    static constexpr uint64_t MIN_INDEX_CAPACITY = 1 << 17;
+
+    static constexpr uint32_t RECORD_BITS = 40;
+    static constexpr uint64_t RECORD_MASK = (1ull << RECORD_BITS) - 1;
+
+    // Offsets of the counts in the headers, which are read and written atomically
+    static constexpr size_t DATA_COUNT_OFFSET = 24;
+    static constexpr size_t INDEX_CAPACITY_OFFSET = 8;
+    static constexpr size_t INDEX_COUNT_OFFSET = 16;
+
+    std::string data_path;
+    std::string index_path;
+    bool writable;
+    int data_fd;
+    uint8_t *data;
+    size_t data_size;
+    uint8_t *index;
+    size_t index_size;
+    uint64_t index_capacity;
+    uint64_t index_load;
+
+    mutable std::shared_mutex mutex;
+    mutable StoreStats counters;
+
+    static uint64_t *word(uint8_t *bytes, size_t offset)
+    {
+        return reinterpret_cast<uint64_t *>(bytes + offset);
+    }
+
+    uint64_t recordCount() const
+    {
+        return __atomic_load_n(word(this->data, DATA_COUNT_OFFSET), __ATOMIC_ACQUIRE);
+    }
+
+    uint64_t recordCapacity() const
+    {
+        return (this->data_size - DATA_HEADER_SIZE) / RECORD_SIZE;
+    }
+
+    const uint8_t *record(uint64_t record_index) const
+    {
+        return this->data + DATA_HEADER_SIZE + record_index * RECORD_SIZE;
+    }
+
+    uint64_t *slots() const
+    {
+        return word(this->index, INDEX_HEADER_SIZE);
+    }
+
+    /**
+     * @brief Finds the record of a key through the index.
+     *
+     * @param key
+     * @param record_index Set to the record found
+     * @return false if the key is not in the index
+     */
+    bool lookUp(const Key &key, uint64_t *record_index) const
+    {
+        uint64_t tag = key.hash >> RECORD_BITS;
+        uint64_t mask = this->index_capacity - 1;
+        uint64_t records = this->recordCapacity();
+        for (uint64_t pos = key.hash & mask;; pos = (pos + 1) & mask)
+        {
+            uint64_t slot = __atomic_load_n(&this->slots()[pos], __ATOMIC_ACQUIRE);
+            if (slot == 0)
+            {
+                return false;
+            }
+            uint64_t candidate = (slot & RECORD_MASK) - 1;
+            if (((slot >> RECORD_BITS) == tag) && (candidate < records) &&
+                (std::memcmp(this->record(candidate), key.clues.data(), Layout::PUZZLE_RECORD_SIZE) == 0))
+            {
+                *record_index = candidate;
+                return true;
+            }
+        }
+    }
+
+    static uint64_t hashOf(const uint8_t *record)
+    {
+        std::array<uint8_t, Layout::CELLS> values;
+        Layout::unpackValues(record, values.data());
+        return ResultCache<BoxSize>::makeKey(values.data()).hash;
+    }
+
+    void addSlot(uint64_t *slots, uint64_t capacity, uint64_t hash, uint64_t record_index)
+    {
+        uint64_t mask = capacity - 1;
+        uint64_t pos = hash & mask;
+        while (slots[pos] != 0)
+        {
+            pos = (pos + 1) & mask;
+        }
+        __atomic_store_n(&slots[pos], ((hash >> RECORD_BITS) << RECORD_BITS) | (record_index + 1), __ATOMIC_RELEASE);
+    }
+
+#if defined(SUDOFUN_HAVE_MMAP)
+    static uint8_t *mapFile(int fd, size_t size, bool writable)
+    {
+        void *mapping = ::mmap(nullptr, size, writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+        if (mapping == MAP_FAILED)
+        {
+            throw std::runtime_error("Could not map solution store");
+        }
+        return static_cast<uint8_t *>(mapping);
+    }
+
+    static size_t fileSize(int fd)
+    {
+        struct stat file_stat;
+        if (::fstat(fd, &file_stat) != 0)
+        {
+            throw std::runtime_error("Could not stat solution store");
+        }
+        return static_cast<size_t>(file_stat.st_size);
+    }
+
+    /**
+     * @brief Builds an index of the given capacity over every record in a new file, renames it into place over the
+     * old one, and maps it.
+     *
+     * @param capacity A power of two
+     */
+    void rebuildIndex(uint64_t capacity)
+    {
+        std::string temp_path = this->index_path + ".tmp";
+        int fd = ::open(temp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+        {
+            throw std::runtime_error("Could not create solution store index");
+        }
+        size_t size = INDEX_HEADER_SIZE + capacity * sizeof(uint64_t);
+        if (::ftruncate(fd, static_cast<off_t>(size)) != 0)
+        {
+            ::close(fd);
+            throw std::runtime_error("Could not size solution store index");
+        }
+        uint8_t *mapping = mapFile(fd, size, true);
+        ::close(fd);
+
+        uint64_t count = this->recordCount();
+        uint64_t *new_slots = word(mapping, INDEX_HEADER_SIZE);
+        for (uint64_t r = 0; r < count; ++r)
+        {
+            this->addSlot(new_slots, capacity, hashOf(this->record(r)), r);
+        }
+        std::memcpy(mapping, INDEX_MAGIC, 4);
+        packed::storeLittle<uint16_t>(VERSION, mapping + 4);
+        *word(mapping, INDEX_CAPACITY_OFFSET) = capacity;
+        *word(mapping, INDEX_COUNT_OFFSET) = count;
+
+        if (::rename(temp_path.c_str(), this->index_path.c_str()) != 0)
+        {
+            ::munmap(mapping, size);
+            throw std::runtime_error("Could not replace solution store index");
+        }
+        if (this->index != nullptr)
+        {
+            ::munmap(this->index, this->index_size);
+        }
+        this->index = mapping;
+        this->index_size = size;
+        this->index_capacity = capacity;
+        this->index_load = count;
+    }
+
+    /**
+     * @brief Maps the index, checking that it is an index and covers every record. A reader may find the index one
+     * record behind, if the writer is in the middle of adding one.
+     *
+     * @return false if there is no usable index
+     */
+    bool openIndex()
+    {
+        int fd = ::open(this->index_path.c_str(), this->writable ? O_RDWR : O_RDONLY);
+        if (fd < 0)
+        {
+            return false;
+        }
+        size_t size = fileSize(fd);
+        if (size < INDEX_HEADER_SIZE)
+        {
+            ::close(fd);
+            return false;
+        }
+        uint8_t *mapping = mapFile(fd, size, this->writable);
+        ::close(fd);
+
+        uint64_t capacity = *word(mapping, INDEX_CAPACITY_OFFSET);
+        if ((std::memcmp(mapping, INDEX_MAGIC, 4) != 0) || (packed::loadLittle<uint16_t>(mapping + 4) != VERSION) ||
+            (capacity == 0) || ((capacity & (capacity - 1)) != 0) ||
+            (size != INDEX_HEADER_SIZE + capacity * sizeof(uint64_t)) ||
+            (this->writable ? (*word(mapping, INDEX_COUNT_OFFSET) != this->recordCount())
+                            : (*word(mapping, INDEX_COUNT_OFFSET) > this->recordCount())))
+        {
+            ::munmap(mapping, size);
+            return false;
+        }
+        this->index = mapping;
+        this->index_size = size;
+        this->index_capacity = capacity;
+        this->index_load = *word(mapping, INDEX_COUNT_OFFSET);
+        return true;
+    }
+#endif
+
+public:
+    /**
+     * @brief Opens a store, creating it if there is none. The store is opened for writing unless another process
+     * already has it open for writing, in which case it is only read from.
+     *
+     * @param path The data file; the index is beside it
+     * @param max_guesses The guess limit the results are found with, which has to match the store's
+     * @param pipeline The pipeline the results are found with, which has to match the store's
+     */
+    SolutionStore(const std::string &path, uint32_t max_guesses, Solver::Pipeline pipeline)
+        : data_path(path), index_path(path + ".index"), writable(false), data_fd(-1), data(nullptr), data_size(0),
+          index(nullptr), index_size(0), index_capacity(0), index_load(0)
+    {
+#if !defined(SUDOFUN_HAVE_MMAP)
+        throw std::runtime_error("Solution stores need mmap");
+#else
+        this->data_fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (this->data_fd >= 0)
+        {
+            this->writable = (::flock(this->data_fd, LOCK_EX | LOCK_NB) == 0);
+        }
+        else
+        {
+            this->data_fd = ::open(path.c_str(), O_RDONLY);
+            if (this->data_fd < 0)
+            {
+                throw std::runtime_error("Could not open solution store");
+            }
+        }
+
+        size_t size = fileSize(this->data_fd);
+        if (size == 0)
+        {
+            if (!this->writable)
+            {
+                ::close(this->data_fd);
+                throw std::runtime_error("Solution store is still being created by another process");
+            }
+            size = DATA_HEADER_SIZE + MIN_RECORD_CAPACITY * RECORD_SIZE;
+            if (::ftruncate(this->data_fd, static_cast<off_t>(size)) != 0)
+            {
+                ::close(this->data_fd);
+                throw std::runtime_error("Could not size solution store");
+            }
+            this->data = mapFile(this->data_fd, size, true);
+            std::memcpy(this->data, DATA_MAGIC, 4);
+            packed::storeLittle<uint16_t>(VERSION, this->data + 4);
+            packed::storeLittle<uint16_t>(static_cast<uint16_t>(Layout::SIDE), this->data + 6);
+            packed::storeLittle<uint32_t>(RECORD_SIZE, this->data + 8);
+            packed::storeLittle<uint32_t>(static_cast<uint32_t>(pipeline), this->data + 12);
+            packed::storeLittle<uint32_t>(max_guesses, this->data + 16);
+        }
+        else
+        {
+            this->data = mapFile(this->data_fd, size, this->writable);
+        }
+        this->data_size = size;
+
+        const char *problem = nullptr;
+        if ((size < DATA_HEADER_SIZE) || (std::memcmp(this->data, DATA_MAGIC, 4) != 0))
+        {
+            problem = "File is not a solution store";
+        }
+        else if (packed::loadLittle<uint16_t>(this->data + 4) != VERSION)
+        {
+            problem = "Solution store is of an unsupported version";
+        }
+        else if ((packed::loadLittle<uint16_t>(this->data + 6) != Layout::SIDE) ||
+                 (packed::loadLittle<uint32_t>(this->data + 8) != RECORD_SIZE))
+        {
+            problem = "Solution store holds puzzles of another size";
+        }
+        else if ((packed::loadLittle<uint32_t>(this->data + 12) != static_cast<uint32_t>(pipeline)) ||
+                 (packed::loadLittle<uint32_t>(this->data + 16) != max_guesses))
+        {
+            problem = "Solution store was filled with another pipeline or guess limit";
+        }
+        else if (this->recordCount() > this->recordCapacity())
+        {
+            problem = "Solution store is truncated";
+        }
+        if (problem != nullptr)
+        {
+            ::munmap(this->data, this->data_size);
+            ::close(this->data_fd);
+            throw std::runtime_error(problem);
+        }
+
+        if (!this->openIndex())
+        {
+            if (!this->writable)
+            {
+                ::munmap(this->data, this->data_size);
+                ::close(this->data_fd);
+                throw std::runtime_error("Solution store index is missing or out of date");
+            }
+            uint64_t capacity = MIN_INDEX_CAPACITY;
+            while (capacity < 2 * this->recordCount())
+            {
+                capacity *= 2;
+            }
+            this->rebuildIndex(capacity);
+        }
+#endif
+    }
+
+    ~SolutionStore()
+    {
+#if defined(SUDOFUN_HAVE_MMAP)
+        if (this->writable)
+        {
+            ::msync(this->data, this->data_size, MS_SYNC);
+            ::msync(this->index, this->index_size, MS_SYNC);
+        }
+        ::munmap(this->index, this->index_size);
+        ::munmap(this->data, this->data_size);
+        ::close(this->data_fd);
+#endif
+    }
+
+    SolutionStore(const SolutionStore &) = delete;
+    SolutionStore &operator=(const SolutionStore &) = delete;
+
+    /**
+     * @brief Whether this process can add to the store, rather than only read it.
+     *
+     * @return bool
+     */
+    bool isWritable() const
+    {
+        return this->writable;
+    }
+
+    /**
+     * @brief Looks a puzzle up.
+     *
+     * @param key
+     * @param solution Where to write the CELLS values of the solution, if it was solved; may be nullptr
+     * @param result Set to the result as it was when the puzzle was solved
+     * @return true on a hit
+     */
+    bool find(const Key &key, uint8_t *solution, packed::Result *result) const
+    {
+        std::shared_lock<std::shared_mutex> lock(this->mutex);
+
+        uint64_t record_index;
+        if (!this->lookUp(key, &record_index))
+        {
+            __atomic_fetch_add(&this->counters.misses, 1, __ATOMIC_RELAXED);
+            return false;
+        }
+        __atomic_fetch_add(&this->counters.hits, 1, __ATOMIC_RELAXED);
+
+        std::array<uint8_t, Layout::CELLS> stored;
+        *result = Layout::unpackResult(this->record(record_index) + Layout::PUZZLE_RECORD_SIZE, stored.data());
+        if (result->solved && (solution != nullptr))
+        {
+            std::memcpy(solution, stored.data(), Layout::CELLS);
+        }
+        return true;
+    }
+
+    /**
+     * @brief Adds the result of a puzzle, unless the puzzle is there already or the store is only being read.
+     *
+     * @param key
+     * @param solution The CELLS values of the solution, or of whatever was left when it could not be solved
+     * @param result
+     */
+    void insert(const Key &key, const uint8_t *solution, const packed::Result &result)
+    {
+        if (!this->writable)
+        {
+            return;
+        }
+        std::unique_lock<std::shared_mutex> lock(this->mutex);
+
+        uint64_t record_index;
+        if (this->lookUp(key, &record_index))
+        {
+            return;
+        }
+
+#if defined(SUDOFUN_HAVE_MMAP)
+        record_index = this->recordCount();
+        if (record_index == this->recordCapacity())
+        {
+            // Grow the file ahead of the records. Readers keep their mappings of the smaller file.
+            size_t size = DATA_HEADER_SIZE + 2 * std::max(record_index, MIN_RECORD_CAPACITY) * RECORD_SIZE;
+            if (::ftruncate(this->data_fd, static_cast<off_t>(size)) != 0)
+            {
+                throw std::runtime_error("Could not grow solution store");
+            }
+            ::munmap(this->data, this->data_size);
+            this->data = mapFile(this->data_fd, size, true);
+            this->data_size = size;
+        }
+
+        uint8_t *added = this->data + DATA_HEADER_SIZE + record_index * RECORD_SIZE;
+        std::memcpy(added, key.clues.data(), Layout::PUZZLE_RECORD_SIZE);
+        Layout::packResult(solution, result, added + Layout::PUZZLE_RECORD_SIZE);
+        __atomic_store_n(word(this->data, DATA_COUNT_OFFSET), record_index + 1, __ATOMIC_RELEASE);
+
+        if (2 * (this->index_load + 1) > this->index_capacity)
+        {
+            this->rebuildIndex(2 * this->index_capacity);
+        }
+        else
+        {
+            this->addSlot(this->slots(), this->index_capacity, key.hash, record_index);
+            ++this->index_load;
+            __atomic_store_n(word(this->index, INDEX_COUNT_OFFSET), this->index_load, __ATOMIC_RELEASE);
+        }
+        ++this->counters.inserts;
+#endif
+    }
+
+    /**
+     * @brief The counters of this process's use of the store.
+     *
+     * @return StoreStats
+     */
+    StoreStats stats() const
+    {
+        std::unique_lock<std::shared_mutex> lock(this->mutex);
+        return this->counters;
+    }
+
+    /**
+     * @brief The number of records in the store.
+     *
+     * @return uint64_t
+     */
+    uint64_t size() const
+    {
+        std::shared_lock<std::shared_mutex> lock(this->mutex);
+        return this->recordCount();
+    }
+};
+
+#endif
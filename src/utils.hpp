@@ -25,6 +25,46 @@ namespace utils
         return num;
     }
 
+    /**
+     * @brief Counts the number of active bits in a 64 bit word.
+     *
+     * @param n
+     * @return uint32_t
+     */
+    inline uint32_t countBits64(uint64_t n)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return static_cast<uint32_t>(__builtin_popcountll(n));
+#else
+        uint32_t count = 0;
+        for (; n != 0; n &= n - 1)
+        {
+            ++count;
+        }
+        return count;
+#endif
+    }
+
+    /**
+     * @brief Returns the position of the lowest active bit of a nonzero word.
+     *
+     * @param n A nonzero value
+     * @return uint32_t
+     */
+    inline uint32_t lowestBitIndex(uint64_t n)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return static_cast<uint32_t>(__builtin_ctzll(n));
+#else
+        uint32_t idx = 0;
+        for (; (n & 1) == 0; n >>= 1)
+        {
+            ++idx;
+        }
+        return idx;
+#endif
+    }
+
     /**
      * @brief Converts a sudoku cell value to its associated 9 bit value, given by 2**(val - 1)
      *
@@ -33,15 +73,12 @@ namespace utils
      */
     inline uint16_t valueToNineBit(uint32_t val)
     {
-        if ((val < 1) && (val > 9))
+        if ((val < 1) || (val > 9))
         {
             throw std::invalid_argument("Input must be in the range 1-9");
         }
 
-        std::string binary_string = "000000000";
-        binary_string.replace(9 - val, 1, "1");
-
-        return static_cast<uint16_t>(std::stoi(binary_string, nullptr, 2));
+        return static_cast<uint16_t>(1 << (val - 1));
     }
 
     /**
@@ -77,6 +114,46 @@ namespace utils
         return 0;
     }
 
+    /**
+     * @brief Converts a character of a puzzle string to a cell value: 1-9 stand for themselves, and the letters from A
+     * (or a) stand for 10 onwards, as the digits of puzzles larger than 9x9. Anything else, including the . and 0
+     * of an empty cell, is 0.
+     *
+     * @param c
+     * @return uint32_t
+     */
+    inline uint32_t charToValue(char c)
+    {
+        if ((c >= '1') && (c <= '9'))
+        {
+            return static_cast<uint32_t>(c - '0');
+        }
+        if ((c >= 'A') && (c <= 'Z'))
+        {
+            return static_cast<uint32_t>(c - 'A') + 10;
+        }
+        if ((c >= 'a') && (c <= 'z'))
+        {
+            return static_cast<uint32_t>(c - 'a') + 10;
+        }
+        return 0;
+    }
+
+    /**
+     * @brief The inverse of charToValue(), writing letters in upper case and . for 0.
+     *
+     * @param value
+     * @return char
+     */
+    inline char valueToChar(uint32_t value)
+    {
+        if (value == 0)
+        {
+            return '.';
+        }
+        return (value <= 9) ? static_cast<char>('0' + value) : static_cast<char>('A' + (value - 10));
+    }
+
     /**
      * @brief
      *
@@ -14,7 +14,7 @@
 #include "window.hpp"
 #include "solver.hpp"
 
-MainWindow::MainWindow(QWidget *parent, int maxGuesses) : QWidget(parent), maxGuesses(maxGuesses)
+MainWindow::MainWindow(QWidget *parent, uint32_t maxGuesses) : QWidget(parent), maxGuesses(maxGuesses)
 {
     setupUI();
     connectSignals();
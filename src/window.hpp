@@ -6,10 +6,13 @@
 
 #include <QWidget>
 #include <QLineEdit>
-#include <QPushButton>
+#include <QPushButton>
+#include <stdint.h>
 
 class WindowClue;
-class Puzzle;
+template <uint32_t BoxSize>
+class BasicPuzzle;
+using Puzzle = BasicPuzzle<3>;
 
 class MainWindow : public QWidget
 {
@@ -31,10 +34,10 @@ class MainWindow : public QWidget
   static constexpr int clearOffsetY = 100;
   static constexpr int clearWidth = 100;
   static constexpr int clearHeight = 100;
-  int maxGuesses;
+  uint32_t maxGuesses;
 
 public:
-  MainWindow(QWidget *parent = nullptr, int maxGuesses = 1);
+  MainWindow(QWidget *parent = nullptr, uint32_t maxGuesses = UINT32_MAX);
 
 private slots:
 #ifdef DEBUG_BUILD
@@ -0,0 +1,125 @@
+#ifndef SUDOFUN_WORKERS_HEADER
+#define SUDOFUN_WORKERS_HEADER
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Hands out chunks of a batch of work items to a fixed set of workers. The chunks are dealt out evenly
+ * as one contiguous range per worker up front; each worker takes chunks from the front of its own range, and
+ * once that runs dry it steals chunks from the back of the other workers' ranges. Workers that land on cheap
+ * items therefore keep busy until the whole batch is done, rather than idling once their share is finished.
+ */
+class WorkStealingRanges
+{
+private:
+    // The remaining chunks of one worker's range: the head in the low 32 bits, the tail in the high 32 bits.
+    // Each range gets its own cache line so that workers don't contend on their neighbours' ranges.
+    struct alignas(64) Range
+    {
+        std::atomic<uint64_t> bounds;
+    };
+
+    std::unique_ptr<Range[]> ranges;
+    uint32_t num_workers;
+    size_t num_items;
+    size_t chunk_size;
+
+    static uint64_t pack(uint64_t head, uint64_t tail)
+    {
+        return head | (tail << 32);
+    }
+
+    void chunkToItems(uint64_t chunk, size_t *begin, size_t *end) const
+    {
+        *begin = chunk * this->chunk_size;
+        *end = std::min(*begin + this->chunk_size, this->num_items);
+    }
+
+public:
+    WorkStealingRanges(size_t num_items, uint32_t num_workers, size_t chunk_size)
+        : ranges(new Range[num_workers]), num_workers(num_workers), num_items(num_items), chunk_size(chunk_size)
+    {
+        uint64_t num_chunks = (num_items + chunk_size - 1) / chunk_size;
+        for (uint32_t w = 0; w < num_workers; ++w)
+        {
+            this->ranges[w].bounds.store(pack(num_chunks * w / num_workers, num_chunks * (w + 1) / num_workers));
+        }
+    }
+
+    /**
+     * @brief Claims the next chunk of items for a worker.
+     *
+     * @param worker The index of the calling worker
+     * @param begin Set to the first item of the chunk
+     * @param end Set to one past the last item of the chunk
+     * @return false once every chunk has been claimed
+     */
+    bool next(uint32_t worker, size_t *begin, size_t *end)
+    {
+        // Take from the front of our own range
+        std::atomic<uint64_t> &own = this->ranges[worker].bounds;
+        uint64_t bounds = own.load(std::memory_order_relaxed);
+        while ((bounds & 0xFFFFFFFF) < (bounds >> 32))
+        {
+            uint64_t head = bounds & 0xFFFFFFFF;
+            if (own.compare_exchange_weak(bounds, pack(head + 1, bounds >> 32), std::memory_order_relaxed))
+            {
+                this->chunkToItems(head, begin, end);
+                return true;
+            }
+        }
+
+        // Steal from the back of someone else's
+        for (uint32_t n = 1; n < this->num_workers; ++n)
+        {
+            std::atomic<uint64_t> &victim = this->ranges[(worker + n) % this->num_workers].bounds;
+            bounds = victim.load(std::memory_order_relaxed);
+            while ((bounds & 0xFFFFFFFF) < (bounds >> 32))
+            {
+                uint64_t tail = (bounds >> 32) - 1;
+                if (victim.compare_exchange_weak(bounds, pack(bounds & 0xFFFFFFFF, tail), std::memory_order_relaxed))
+                {
+                    this->chunkToItems(tail, begin, end);
+                    return true;
+                }
+            }
+        }
+
+        return false;
+    }
+};
+
+/**
+ * @brief Runs a function once on each of a number of threads, passing each its worker index, and waits for all
+ * of them to finish. A single worker runs on the calling thread.
+ *
+ * @param num_workers
+ * @param fn Called as fn(worker_index)
+ */
+template <typename Fn>
+void runWorkers(uint32_t num_workers, Fn fn)
+{
+    if (num_workers <= 1)
+    {
+        fn(0);
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    threads.reserve(num_workers);
+    for (uint32_t w = 0; w < num_workers; ++w)
+    {
+        threads.emplace_back(fn, w);
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+}
+
+#endif